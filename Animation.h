@@ -0,0 +1,295 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "Png.h"
+
+// Animated previews: one palette for the whole animation and per frame only the rectangle
+// that changed since the frame before. A generator's own frames are gray ramps (the same value
+// in color and alpha), for which the palette is exact: the 256 grays, the index is the value.
+// Anything else is median cut to 256 colors over a 4-bit-per-channel histogram.
+namespace Anim {
+
+    inline int Bin(const uint8_t* p) { return ((p[0] >> 4) << 12) | ((p[1] >> 4) << 8) | ((p[2] >> 4) << 4) | (p[3] >> 4); }
+
+    struct Histogram {
+        bool Gray = true;
+        std::vector<uint64_t> Levels = std::vector<uint64_t>(256);     // while gray
+        std::vector<uint64_t> Bins;                                     // 16^4, once not
+
+        void Add(const uint8_t* pixels, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                const uint8_t* p = pixels + i * 4;
+                if (Gray && p[0] == p[1] && p[0] == p[2] && p[0] == p[3]) { Levels[p[0]]++; continue; }
+                if (Gray) ToColor();
+                Bins[Bin(p)]++;
+            }
+        }
+        void Merge(Histogram& other) {
+            if (Gray && !other.Gray) ToColor();
+            if (!Gray && other.Gray) other.ToColor();
+            if (Gray) { for (int v = 0; v < 256; v++) Levels[v] += other.Levels[v]; }
+            else { for (size_t b = 0; b < Bins.size(); b++) Bins[b] += other.Bins[b]; }
+        }
+
+    private:
+        void ToColor() {
+            Gray = false;
+            Bins.assign(1 << 16, 0);
+            for (int v = 0; v < 256; v++) {
+                uint8_t p[4] = { (uint8_t)v, (uint8_t)v, (uint8_t)v, (uint8_t)v };
+                Bins[Bin(p)] += Levels[v];
+            }
+        }
+    };
+
+    struct Palette {
+        bool Gray = true;
+        std::vector<uint8_t> Colors;    // RGBA per entry
+        std::vector<uint8_t> Lut;       // histogram bin -> entry, color palettes only
+
+        int Count() const { return (int)Colors.size() / 4; }
+        void Map(const uint8_t* pixels, size_t count, uint8_t* indices) const {
+            if (Gray) { for (size_t i = 0; i < count; i++) indices[i] = pixels[i * 4]; }
+            else { for (size_t i = 0; i < count; i++) indices[i] = Lut[Bin(pixels + i * 4)]; }
+        }
+    };
+
+    // Median cut: the box with the most pixels is split at the weighted median of its widest
+    // channel, until there are 256 boxes or none can be split. Boxes keep covering the whole
+    // bin space, so every bin maps somewhere.
+    inline Palette BuildPalette(const Histogram& histogram) {
+        Palette palette;
+        palette.Gray = histogram.Gray;
+        if (histogram.Gray) {
+            for (int v = 0; v < 256; v++) palette.Colors.insert(palette.Colors.end(), { (uint8_t)v, (uint8_t)v, (uint8_t)v, (uint8_t)v });
+            return palette;
+        }
+
+        struct Box { int Lo[4], Hi[4]; uint64_t Count; bool Splittable = true; };
+        auto forEach = [](const Box& box, auto&& body) {
+            for (int r = box.Lo[0]; r <= box.Hi[0]; r++)
+                for (int g = box.Lo[1]; g <= box.Hi[1]; g++)
+                    for (int b = box.Lo[2]; b <= box.Hi[2]; b++)
+                        for (int a = box.Lo[3]; a <= box.Hi[3]; a++) body((r << 12) | (g << 8) | (b << 4) | a, r, g, b, a);
+        };
+        const std::vector<uint64_t>& bins = histogram.Bins;
+        uint64_t total = 0;
+        for (uint64_t count : bins) total += count;
+        std::vector<Box> boxes = { { { 0, 0, 0, 0 }, { 15, 15, 15, 15 }, total } };
+
+        while (boxes.size() < 256) {
+            int pick = -1;
+            for (int i = 0; i < (int)boxes.size(); i++) {
+                if (boxes[i].Splittable && (pick < 0 || boxes[i].Count > boxes[pick].Count)) pick = i;
+            }
+            if (pick < 0) break;
+
+            // per channel counts inside the box
+            uint64_t marginal[4][16] = {};
+            forEach(boxes[pick], [&](int bin, int r, int g, int b, int a) {
+                uint64_t count = bins[bin];
+                marginal[0][r] += count; marginal[1][g] += count; marginal[2][b] += count; marginal[3][a] += count;
+            });
+            int channel = -1, first = 0, last = 0;
+            for (int c = 0; c < 4; c++) {
+                int lo = 0, hi = 15;
+                while (lo < 15 && !marginal[c][lo]) lo++;
+                while (hi > 0 && !marginal[c][hi]) hi--;
+                if (hi > lo && (channel < 0 || hi - lo > last - first)) { channel = c; first = lo; last = hi; }
+            }
+            if (channel < 0) { boxes[pick].Splittable = false; continue; }
+
+            uint64_t below = 0;
+            int split = first;
+            for (; split < last - 1; split++) {
+                below += marginal[channel][split];
+                if (2 * below >= boxes[pick].Count) break;
+            }
+            below = 0;
+            for (int v = first; v <= split; v++) below += marginal[channel][v];
+
+            Box upper = boxes[pick];
+            upper.Lo[channel] = split + 1;
+            upper.Count = boxes[pick].Count - below;
+            boxes[pick].Hi[channel] = split;
+            boxes[pick].Count = below;
+            boxes.push_back(upper);
+        }
+
+        // entry colors: count weighted means of the bin centers
+        palette.Lut.resize(1 << 16);
+        for (int i = 0; i < (int)boxes.size(); i++) {
+            uint64_t sum[4] = {}, count = 0;
+            forEach(boxes[i], [&](int bin, int r, int g, int b, int a) {
+                palette.Lut[bin] = (uint8_t)i;
+                uint64_t n = bins[bin];
+                sum[0] += n * r; sum[1] += n * g; sum[2] += n * b; sum[3] += n * a;
+                count += n;
+            });
+            for (int c = 0; c < 4; c++) palette.Colors.push_back((uint8_t)(count ? (sum[c] * 17 + count / 2) / count : 0));
+        }
+        return palette;
+    }
+
+    struct Rect { int X = 0, Y = 0, Width = 0, Height = 0; };
+
+    // bounds of the indices that differ, never empty: an unchanged frame keeps one pixel
+    inline Rect ChangedRect(const uint8_t* prev, const uint8_t* cur, int width, int height) {
+        int x0 = width, y0 = height, x1 = -1, y1 = -1;
+        for (int y = 0; y < height; y++) {
+            const uint8_t* a = prev + (size_t)y * width;
+            const uint8_t* b = cur + (size_t)y * width;
+            if (!std::memcmp(a, b, width)) continue;
+            int l = 0, r = width - 1;
+            while (a[l] == b[l]) l++;
+            while (a[r] == b[r]) r--;
+            x0 = std::min(x0, l); x1 = std::max(x1, r);
+            y0 = std::min(y0, y); y1 = y;
+        }
+        if (x1 < 0) return { 0, 0, 1, 1 };
+        return { x0, y0, x1 - x0 + 1, y1 - y0 + 1 };
+    }
+
+    inline std::vector<uint8_t> Crop(const uint8_t* indices, int width, const Rect& rect) {
+        std::vector<uint8_t> out((size_t)rect.Width * rect.Height);
+        for (int y = 0; y < rect.Height; y++) {
+            std::memcpy(out.data() + (size_t)y * rect.Width, indices + (size_t)(rect.Y + y) * width + rect.X, rect.Width);
+        }
+        return out;
+    }
+
+    inline void PutLittleEndian16(std::vector<uint8_t>& out, int v) {
+        out.push_back((uint8_t)v);
+        out.push_back((uint8_t)(v >> 8));
+    }
+
+    // Indexed PNG with acTL/fcTL/fdAT. Frame 0 is the default image (IDAT); a frame's chunks
+    // carry fixed sequence numbers, so frames encode independently and concatenate in order.
+    namespace Apng {
+
+        // loops 0: forever
+        inline std::vector<uint8_t> Header(int width, int height, int frames, int loops, const Palette& palette) {
+            std::vector<uint8_t> out = Png::FileHeader(width, height, 3);
+            std::vector<uint8_t> actl, plte, trns;
+            Png::PutBigEndian(actl, (uint32_t)frames);
+            Png::PutBigEndian(actl, (uint32_t)loops);
+            Png::WriteChunk(out, "acTL", actl.data(), actl.size());
+            for (int i = 0; i < palette.Count(); i++) {
+                plte.insert(plte.end(), &palette.Colors[i * 4], &palette.Colors[i * 4] + 3);
+                trns.push_back(palette.Colors[i * 4 + 3]);
+            }
+            Png::WriteChunk(out, "PLTE", plte.data(), plte.size());
+            Png::WriteChunk(out, "tRNS", trns.data(), trns.size());
+            return out;
+        }
+
+        // delay in seconds as delayNum / delayDen; each frame replaces its rectangle
+        inline void Frame(std::vector<uint8_t>& out, int frame, const Rect& rect, const uint8_t* indices, int delayNum, int delayDen) {
+            uint32_t sequence = frame == 0 ? 0 : 2 * frame - 1;
+            std::vector<uint8_t> fctl;
+            Png::PutBigEndian(fctl, sequence);
+            Png::PutBigEndian(fctl, (uint32_t)rect.Width);
+            Png::PutBigEndian(fctl, (uint32_t)rect.Height);
+            Png::PutBigEndian(fctl, (uint32_t)rect.X);
+            Png::PutBigEndian(fctl, (uint32_t)rect.Y);
+            fctl.insert(fctl.end(), { (uint8_t)(delayNum >> 8), (uint8_t)delayNum, (uint8_t)(delayDen >> 8), (uint8_t)delayDen, 0, 0 });
+            Png::WriteChunk(out, "fcTL", fctl.data(), fctl.size());
+
+            std::vector<uint8_t> data;
+            if (frame > 0) Png::PutBigEndian(data, sequence + 1);
+            std::vector<uint8_t> zlib = Png::CompressImage({ const_cast<uint8_t*>(indices), rect.Width, rect.Height, 1 });
+            data.insert(data.end(), zlib.begin(), zlib.end());
+            Png::WriteChunk(out, frame == 0 ? "IDAT" : "fdAT", data.data(), data.size());
+        }
+
+        inline void Trailer(std::vector<uint8_t>& out) { Png::WriteEnd(out); }
+    }
+
+    // GIF89a with one global color table. GIF has no partial alpha: the premultiplied frames
+    // are shown over black, which is their color channels as they are.
+    namespace Gif {
+
+        // loops 0: forever, -1: play once
+        inline std::vector<uint8_t> Header(int width, int height, int loops, const Palette& palette) {
+            std::vector<uint8_t> out = { 'G', 'I', 'F', '8', '9', 'a' };
+            PutLittleEndian16(out, width);
+            PutLittleEndian16(out, height);
+            out.insert(out.end(), { 0xF7, 0, 0 });     // 256 entry global table
+            for (int i = 0; i < 256; i++) {
+                const uint8_t* c = i < palette.Count() ? &palette.Colors[i * 4] : nullptr;
+                out.insert(out.end(), { c ? c[0] : (uint8_t)0, c ? c[1] : (uint8_t)0, c ? c[2] : (uint8_t)0 });
+            }
+            if (loops >= 0) {
+                static constexpr char netscape[] = "NETSCAPE2.0";
+                out.insert(out.end(), { 0x21, 0xFF, 11 });
+                out.insert(out.end(), netscape, netscape + 11);
+                out.insert(out.end(), { 3, 1 });
+                PutLittleEndian16(out, loops);
+                out.push_back(0);
+            }
+            return out;
+        }
+
+        // Variable width LZW (8-bit roots, up to 12-bit codes, cleared when full) in
+        // 255-byte sub-blocks. The string table is a hash of (prefix, byte) -> code.
+        inline void Lzw(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+            const int Clear = 256, End = 257, HashSize = 8192;
+            std::vector<int32_t> keys(HashSize), codes(HashSize);
+            std::vector<uint8_t> bytes;
+            Png::BitWriter bits(bytes);
+
+            int width = 9, next = 258;
+            auto reset = [&]() { std::fill(keys.begin(), keys.end(), -1); width = 9; next = 258; };
+            reset();
+            bits.Put(Clear, width);
+            int current = size ? data[0] : 0;
+            for (size_t i = 1; i < size; i++) {
+                int key = (current << 8) | data[i];
+                int slot = (key * 2654435761u) >> 19;
+                while (keys[slot] >= 0 && keys[slot] != key) slot = (slot + 1) & (HashSize - 1);
+                if (keys[slot] == key) { current = codes[slot]; continue; }
+
+                bits.Put(current, width);
+                if (next < 4096) {
+                    keys[slot] = key;
+                    codes[slot] = next++;
+                    if (next > (1 << width)) width++;
+                }
+                else {
+                    bits.Put(Clear, width);
+                    reset();
+                }
+                current = data[i];
+            }
+            bits.Put(current, width);
+            bits.Put(End, width);
+            bits.Align();
+
+            out.push_back(8);   // root code size
+            for (size_t i = 0; i < bytes.size(); i += 255) {
+                size_t n = std::min<size_t>(255, bytes.size() - i);
+                out.push_back((uint8_t)n);
+                out.insert(out.end(), bytes.begin() + i, bytes.begin() + i + n);
+            }
+            out.push_back(0);
+        }
+
+        // delay in hundredths; the frame stays when the next one is drawn over it
+        inline void Frame(std::vector<uint8_t>& out, const Rect& rect, const uint8_t* indices, int delay) {
+            out.insert(out.end(), { 0x21, 0xF9, 4, 0x04 });
+            PutLittleEndian16(out, delay);
+            out.insert(out.end(), { 0, 0 });
+            out.push_back(0x2C);
+            PutLittleEndian16(out, rect.X);
+            PutLittleEndian16(out, rect.Y);
+            PutLittleEndian16(out, rect.Width);
+            PutLittleEndian16(out, rect.Height);
+            out.push_back(0);
+            Lzw(indices, (size_t)rect.Width * rect.Height, out);
+        }
+
+        inline void Trailer(std::vector<uint8_t>& out) { out.push_back(0x3B); }
+    }
+}
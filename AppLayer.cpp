@@ -5,6 +5,8 @@
 
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 bool AppLayer::HandleInput(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    // any message may change what the UI shows, rebuild for a couple of frames so ImGui settles
+    UiDirtyFrames = 3;
     return ImGui_ImplWin32_WndProcHandler(hwnd, msg, wParam, lParam);
 }
 void AppLayer::OnAttach() {
@@ -24,17 +26,70 @@ void AppLayer::OnAttach() {
 
 
 	RegisterGenerators();
+	CreateCheckerSampler();
+	MeasureCheckerboardCost();
 
+	{
+		std::lock_guard<std::mutex> lock(TuningLock);
+		if (Tuning.Load() && Tuning.MatchesThisMachine()) { DXE_INFO("Loaded autotune profile: ", TuningProfile::DefaultPath().string()); }
+		else { Tuning = {}; }
+	}
+	if (Tuning.Entries.empty()) { StartAutotune(); }
 
+	OpenLastFrameCache();
+	if (std::strstr(GetCommandLineA(), "--serve")) { StartService(); }
 
 }
-void AppLayer::OnDetach() { DXE_INFO("Dettached AppLayer Layer: ", name); }
+void AppLayer::OnDetach() {
+	DXE_INFO("Dettached AppLayer Layer: ", name);
+	if (TuneThread.joinable()) TuneThread.join();
+	// export workers may be blocked on the pipeline, release them before the pool shuts down
+	Service.reset();
+	Canvas.reset();
+	Cache.Flush();
+	PendingLoad.reset();
+	StaleLoads.clear();
+	CancelExport();
+	Scheduler.Shutdown();
+	ExportJob.reset();
+	Exporter.reset();
+	PlaneExporters.clear();
+	PreviewJob.reset();
+	CompareJob.reset();
+	for (auto* tex : TextureFrames) { delete tex; }
+	for (auto* tex : Thumbnails) { delete tex; }
+	for (auto* tex : CompareFrames) { delete tex; }
+	TextureFrames.clear();
+	Thumbnails.clear();
+	CompareFrames.clear();
+	delete CheckerPattern;
+	CheckerPattern = nullptr;
+	delete StoreFrame;
+	StoreFrame = nullptr;
+	Store.reset();
+	if (CheckerSampler) { CheckerSampler->Release(); CheckerSampler = nullptr; }
+}
 
 void AppLayer::Update(float dt) {
-
+	CollectFinishedJobs();
 
 }
 void AppLayer::Render(float dt) {
+	ImGuiIO& io = ImGui::GetIO();
+
+	bool busy = Playing || PreviewJob || PendingLoad || CompareJob || IsTuning || IsExporting() || (Canvas && !Canvas->IsDone());
+	// windows dragged out into viewports of their own need UpdatePlatformWindows every frame,
+	// which needs a NewFrame; only the main viewport can be resubmitted as it is
+	bool detached = (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) && ImGui::GetPlatformIO().Viewports.Size > 1;
+	bool idle = IdleMode && !busy && !detached && UiDirtyFrames == 0 && ImGui::GetDrawData();
+	if (UiDirtyFrames > 0) UiDirtyFrames--;
+
+	// nothing changed: the back buffer was cleared, so resubmit last frame's draw lists as they are
+	if (idle) {
+		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+		IdleFrames++;
+		return;
+	}
 
 	ImGui_ImplDX11_NewFrame();
 	ImGui_ImplWin32_NewFrame();
@@ -46,8 +101,6 @@ void AppLayer::Render(float dt) {
 	ImGui::SetNextWindowSize(main_viewport->WorkSize);
 	ImGui::SetNextWindowViewport(main_viewport->ID);
 
-	ImGuiIO& io = ImGui::GetIO();
-
 	// Create a dockspace for the main window
 	ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoTitleBar |
 		ImGuiWindowFlags_NoCollapse |
@@ -69,33 +122,54 @@ void AppLayer::Render(float dt) {
 		ResizeFrames(Size);
 	}
 
-	if (ImGui::InputInt("Frame Count", &FrameCount)) {}
+	if (ImGui::InputInt("Frame Count", &FrameCount)) { FrameCount = std::max(FrameCount, 1); }
+
+	int output = (int)Output;
+	if (ImGui::Combo("Output", &output, "Bitmap\0Distance Field\0Masks\0")) { Output = (OutputMode)output; }
+	if (Output == OutputMode::DistanceField) {
+		if (ImGui::InputInt("SDF Size", &SdfSize)) { SdfSize = std::clamp(SdfSize, std::min(8, Size), Size); }
+		ImGui::SliderFloat("SDF Range", &SdfRange, 0.01f, 1.f);
+	}
+	int storage = (int)Storage;
+	if (ImGui::Combo("Frame Storage", &storage, "Textures\0Compressed\0Mapped File\0")) { Storage = (FrameStorage)storage; }
 
 
 	auto play_button_text = Playing ? "Pause" : "Play";
 	if (ImGui::Button(play_button_text)) { Playing = !Playing; }
 
-	ImGui::Text("Frames: %d", TextureFrames.size());
+	int frameCount = DisplayFrameCount();
+	ImGui::Text("Frames: %d", frameCount);
+	DrawUiStats();
 
 	DrawGeneratorUI();
+	DrawExportUI();
+	DrawCanvasUI();
+	DrawServiceUI();
+	DrawRenderCacheUI();
 
-	DrawFrameTimeline(TextureFrames, SelectedFrame);
+	DrawFrameTimeline(frameCount, SelectedFrame);
 
 
 	// inside your ImGui frame loop:
 	static float elapsedTime = 0.f;
 	float frameDuration = 1.f / FrameCount;
-	if (Playing && TextureFrames.size()) {
+	if (Playing && frameCount) {
 		elapsedTime += dt;
 		if (elapsedTime >= frameDuration) {
 			elapsedTime -= frameDuration;
-			SelectedFrame = (SelectedFrame + 1) % TextureFrames.size();
+			SelectedFrame = (SelectedFrame + 1) % frameCount;
 		}
 		if (elapsedTime > 1.f) { elapsedTime = 0.f; }
 	}
 	else { elapsedTime = 0.f; }
 
-	DrawMainFramePreview(TextureFrames, SelectedFrame);
+	// the frame on screen and its neighbours render first, re-evaluated every UI tick
+	if (PreviewJob) { PreviewJob->SetFocus(SelectedFrame, TimelineFirstVisible, TimelineLastVisible); }
+
+	ShowStoredFrame(SelectedFrame);
+	DrawMainFramePreview(SelectedFrame);
+	DockProfilerBesidePreview();
+	Profiler::DrawWindow();
 
 
 
@@ -115,6 +189,8 @@ void AppLayer::Render(float dt) {
 	ImGui::End();
     ImGui::Render();
     ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	UiVertexCount = ImGui::GetDrawData()->TotalVtxCount;
+	UiIndexCount = ImGui::GetDrawData()->TotalIdxCount;
 
 	if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
 		ImGui::UpdatePlatformWindows();
@@ -125,53 +201,696 @@ void AppLayer::Render(float dt) {
 
 
 
-void AppLayer::GenerateFramesMultiThreaded() {
-	if (IsGenerating.load()) {
-		DXE_LOG("Already generating, skipping...");
-		return;
+// splits the preview's dock node once so the profiler sits to its right
+void AppLayer::DockProfilerBesidePreview() {
+	static bool docked = false;
+	if (docked) return;
+
+	ImGuiWindow* preview = ImGui::FindWindowByName("Frame Preview");
+	if (!preview || !preview->DockId) return;
+	docked = true;
+
+	// respect a layout the user already saved
+	if (ImGui::FindWindowSettingsByID(ImHashStr("Profiler"))) return;
+
+	ImGuiID previewNode = preview->DockId;
+	ImGuiID profilerNode = ImGui::DockBuilderSplitNode(previewNode, ImGuiDir_Right, 0.35f, nullptr, nullptr);
+	ImGui::DockBuilderDockWindow("Profiler", profilerNode);
+	ImGui::DockBuilderFinish(previewNode);
+}
+
+// Snapshots the active generator and its parameters into a job, so later UI edits
+// can't reach the workers. Returns immediately, results are picked up in Update().
+std::shared_ptr<RenderJob> AppLayer::SubmitJob(JobPriority priority, std::shared_ptr<FrameSink> sink) {
+	std::shared_ptr<RenderJob> job = MakeJob(priority, std::move(sink));
+	if (job) Scheduler.Submit(job);
+	return job;
+}
+
+// the job SubmitJob submits, for callers that may not need it after all
+std::shared_ptr<RenderJob> AppLayer::MakeJob(JobPriority priority, std::shared_ptr<FrameSink> sink) {
+	if (!ActiveGenerator) {
+		DXE_LOG("No active generator selected!");
+		return nullptr;
+	}
+
+	RenderSettings settings = SettingsFor(ActiveGenerator->GetName());
+	std::vector<double> times = Render::FrameTimes(FrameCount, ActiveGenerator->IsLooping());
+	bool thumbnails = (priority == JobPriority::Preview);
+	std::unique_ptr<IFrameGenerator> generator = JobGenerator(settings);
+	int size = OutputSize();
+
+	if (!sink) { sink = std::make_shared<TextureSink>(size, FrameCount, thumbnails); }
+	auto job = std::make_shared<RenderJob>(*generator, size, std::move(times), settings, priority, std::move(sink));
+
+	DXE_LOG("Job ", job->Name, ": threads ", settings.ResolveThreads(), " tile rows ", settings.TileRows, " variant ", KernelVariantName(settings.Variant));
+	return job;
+}
+
+// The active generator wrapped the way the current settings ask for. Distance field jobs
+// render small frames; mask-only generators still render their mask at Size, tiled on the
+// pool, and split each frame's EDT across the job's threads. Masks go innermost, a sweep cell is then
+// all the masks of one variant.
+std::unique_ptr<IFrameGenerator> AppLayer::JobGenerator(const RenderSettings& settings) const {
+	std::unique_ptr<IFrameGenerator> generator = ActiveGenerator->Clone();
+	if (Output == OutputMode::Masks && MaskGenerator::CanWrap(*generator) && !MaskOutputs.empty()) {
+		generator = std::make_unique<MaskGenerator>(std::move(generator), JobMasks());
+	}
+	if (SweepEnabled && SweepX.Active()) {
+		generator = std::make_unique<SweepGenerator>(std::move(generator), SweepX, SweepY);
+	}
+	if (Output == OutputMode::DistanceField) {
+		generator = std::make_unique<DistanceFieldGenerator>(std::move(generator), Size, SdfRange, settings.ResolveThreads());
 	}
-	
+	return generator;
+}
+
+// exported as planes each mask gets a channel of its own, whatever it packs into otherwise
+std::vector<MaskOutput> AppLayer::JobMasks() const {
+	std::vector<MaskOutput> masks = MaskOutputs;
+	if (masks.size() > MaskGenerator::MaxOutputs) masks.resize(MaskGenerator::MaxOutputs);
+	if (MaskPlanes) {
+		for (int i = 0; i < (int)masks.size(); i++) masks[i].Channel = i;
+	}
+	return masks;
+}
+
+void AppLayer::GenerateFramesMultiThreaded() {
 	if (!ActiveGenerator) {
 		DXE_LOG("No active generator selected!");
 		return;
 	}
 
+	if (IsTuning.load()) {
+		DXE_LOG("Autotune running, skipping...");
+		return;
+	}
+
+	// newest parameters win, a preview still in flight is dropped
+	if (PreviewJob) { PreviewJob->Cancel(); }
+
+	PROFILE_BEGIN_CAPTURE(ActiveGenerator->GetName());
+	PROFILE_THREAD_NAME("Main");
+	RenderSettings settings = SettingsFor(ActiveGenerator->GetName());
+	std::shared_ptr<FrameStore> store;
+	if (Storage == FrameStorage::Compressed) { store = std::make_shared<CompressedFrameStore>(OutputSize(), FrameCount); }
+	if (Storage == FrameStorage::MappedFile) {
+		// a fresh file per render, the one being replaced may still be mapped by a cancelled job
+		auto stamp = std::chrono::system_clock::now().time_since_epoch().count();
+		auto path = MappedFrameStore::DefaultDirectory() / ("frames-" + std::to_string(stamp) + ".sgf");
+		StateKey state;
+		uint64_t stateHash = RenderCache::Key(*JobGenerator(settings), OutputSize(), FrameCount, settings.Variant, state) ? state.Hash() : 0;
+		store = MappedFrameStore::Create(path, OutputSize(), FrameCount, *ActiveGenerator, stateHash);
+		if (!store) { DXE_LOG("Frame cache unavailable, keeping frames in textures"); }
+	}
+
+	std::shared_ptr<RenderJob> job = MakeJob(JobPriority::Preview, store);
+	if (!job) return;
+
+	// A preset rendered before, in this session or another or on a machine sharing the cache,
+	// loads instead of rendering. The job and the key are taken from the same state, the job
+	// waits for the answer unsubmitted and the cache fills its sink on a hit.
+	PendingCacheKey.reset();
+	if (PendingLoad) StaleLoads.push_back(std::move(PendingLoad));
+	StateKey key;
+	if (UseRenderCache && RenderCache::Key(*JobGenerator(settings), OutputSize(), FrameCount, settings.Variant, key)) {
+		PendingCacheKey = key;
+		auto load = std::make_shared<CacheLoad>();
+		load->Job = job;
+		load->Store = store;
+		std::shared_ptr<FrameSink> sink = store;
+		if (!sink) sink = std::shared_ptr<FrameSink>(job, job->SinkAs<FrameSink>());
+		// the load is kept here until it answers, its job and sink are only ever released on this thread
+		Cache.LoadAsync(std::move(key), OutputSize(), FrameCount, sink, [answer = load.get()](bool hit) { answer->Result = hit ? 1 : 0; });
+		PendingLoad = std::move(load);
+		return;
+	}
+	StartPreview(job, store);
+}
+
+void AppLayer::StartPreview(std::shared_ptr<RenderJob> job, std::shared_ptr<FrameStore> store) {
+	Scheduler.Submit(job);
+	PreviewJob = std::move(job);
 	IsGenerating = true;
-	bool was_playing = Playing;
-	Playing = false;
+	UseStore(store);
+	PreviewSink = PreviewJob->SinkAs<TextureSink>();
+	PreviewReady.assign(PreviewJob->FrameCount(), 0);
+	SelectedFrame = std::clamp(SelectedFrame, 0, std::max(PreviewJob->FrameCount() - 1, 0));
+	PreviewJob->SetFocus(SelectedFrame, TimelineFirstVisible, TimelineLastVisible);
+}
+
+// the new preview's store replaces the old one and the per-frame textures right away,
+// frames show up as the store reports them ready
+void AppLayer::UseStore(std::shared_ptr<FrameStore> store) {
+	// only the cache on screen at exit is kept for the next session
+	if (auto* mapped = dynamic_cast<MappedFrameStore*>(Store.get())) { mapped->Discard(); }
+	Store = std::move(store);
+	StoreFrameIndex = -1;
+	if (!Store) return;
 
 	for (auto* tex : TextureFrames) { delete tex; }
 	TextureFrames.clear();
+	for (auto* tex : Thumbnails) { delete tex; }
+	Thumbnails.clear();
+	for (int i = 0; i < Store->FrameCount(); i++) {
+		Thumbnails.push_back(new DXE::Texture(FrameStore::ThumbnailSize, FrameStore::ThumbnailSize, 4));
+	}
+	StoreReady.assign(Store->FrameCount(), 0);
+}
 
-	for (int i = 0; i < FrameCount; i++) {
-		TextureFrames.push_back(new DXE::Texture(Size, Size, 4));
+// reads the selected frame back from the store when it changes, stepping forward through
+// a delta chain where the store allows it
+void AppLayer::ShowStoredFrame(int frame) {
+	if (!Store || frame == StoreFrameIndex || !Store->IsReady(frame)) return;
+
+	int size = Store->Size();
+	if (!StoreFrame || StoreFrame->Width() != size) {
+		if (StoreFrame) { StoreFrame->Resize(size, size, 4); }
+		else { StoreFrame = new DXE::Texture(size, size, 4); }
+		StoreFrameIndex = -1;
 	}
+	Store->Read(frame, Draw::ImageView::Of(StoreFrame), StoreFrameIndex);
+	StoreFrame->UpdateTexture();
+	StoreFrameIndex = frame;
+}
 
-	int total = FrameCount;
-	int num_threads = std::thread::hardware_concurrency();
-	if (num_threads == 0) num_threads = 4;
-	DXE_LOG("Async threads: ", num_threads);
+void AppLayer::UploadReadyFrames() {
+	if (Store) {
+		for (int i : Store->TakeReady()) {
+			Draw::ImageView thumbnail = Store->Thumbnail(i);
+			std::memcpy(Thumbnails[i]->Pixels().data(), thumbnail.Pixels, thumbnail.ByteSize());
+			Thumbnails[i]->UpdateTexture();
+			StoreReady[i] = 1;
+		}
+	}
+	if (!PreviewJob || !PreviewSink) return;
+	for (int i : PreviewSink->TakeReady()) {
+		PROFILE_SCOPE_FRAME("UpdateTexture", i);
+		PreviewSink->Texture(i)->UpdateTexture();
+		PreviewSink->Thumbnail(i)->UpdateTexture();
+		PreviewReady[i] = 1;
+	}
+}
 
-	std::thread mainThread([this, total, num_threads]() {
-		std::vector<std::thread> workers;
+// swaps finished frames in on the UI thread, the only place that uploads textures
+void AppLayer::CollectFinishedJobs() {
+	FinishCacheLoad();
+	UploadReadyFrames();
+
+	for (auto& job : Scheduler.Collect()) {
+		UiDirtyFrames = std::max(UiDirtyFrames, 2);
+		bool isPreview = (job == PreviewJob);
+		bool isCompare = (job == CompareJob);
+		if (isPreview && !job->IsCancelled()) { UploadReadyFrames(); }
+		if (isPreview) { PreviewJob.reset(); PreviewSink = nullptr; PreviewReady.clear(); IsGenerating = false; }
+		if (isCompare) { CompareJob.reset(); }
+		if (job == ExportJob) { ExportJob.reset(); }
+		if (job->IsCancelled() || !(isPreview || isCompare)) continue;
+
+		TextureSink* sink = job->SinkAs<TextureSink>();
+		if (!sink) {
+			if (isPreview) StoreCachedFrames();
+			continue;
+		}
 
-		for (int t = 0; t < num_threads; ++t) {
-			workers.emplace_back([this, t, num_threads, total]() {
-				for (int i = t; i < total; i += num_threads) {
+		std::vector<DXE::Texture*>& frames = isPreview ? TextureFrames : CompareFrames;
+		for (auto* tex : frames) { delete tex; }
+		frames = sink->Take();
 
-					int loop = (int)!ActiveGenerator->IsLooping();
-					double time = (double)i / (FrameCount - loop);
-					ActiveGenerator->Generate(TextureFrames[i], time);
-				}
-				});
+		if (isPreview) {
+			for (auto* tex : Thumbnails) { delete tex; }
+			Thumbnails = sink->TakeThumbnails();
 		}
-		for (auto& t : workers) t.join();
-		});
-	mainThread.join();
-	for (auto* tex : TextureFrames) { tex->UpdateTexture(); }
-	Playing = was_playing;
+
+		// preview frames were uploaded as they finished
+		if (isCompare) {
+			for (int i = 0; i < (int)frames.size(); i++) {
+				PROFILE_SCOPE_FRAME("UpdateTexture", i);
+				frames[i]->UpdateTexture();
+			}
+		}
+		if (isPreview && SelectedFrame >= (int)frames.size()) { SelectedFrame = (int)frames.size() - 1; }
+		if (isPreview) StoreCachedFrames();
+	}
+}
+
+// Once the cache has answered: a miss submits the waiting job, a hit shows the frames the
+// cache put in its store or textures. The preview being replaced was cancelled already and
+// is dropped here.
+void AppLayer::FinishCacheLoad() {
+	std::erase_if(StaleLoads, [](auto& load) { return load->Result.load() >= 0; });
+	if (!PendingLoad || PendingLoad->Result.load() < 0) return;
+	std::shared_ptr<CacheLoad> load = std::move(PendingLoad);
+	PendingLoad.reset();
+	UiDirtyFrames = std::max(UiDirtyFrames, 2);
+	if (load->Result.load() == 0) {
+		StartPreview(load->Job, load->Store);
+		return;
+	}
+	DXE_LOG("Loaded ", load->Job->Name, " from the render cache");
+
+	PendingCacheKey.reset();
+	PreviewJob.reset();
+	PreviewSink = nullptr;
+	PreviewReady.clear();
 	IsGenerating = false;
+	UseStore(load->Store);
+	if (TextureSink* sink = load->Store ? nullptr : load->Job->SinkAs<TextureSink>()) {
+		for (auto* tex : TextureFrames) { delete tex; }
+		for (auto* tex : Thumbnails) { delete tex; }
+		TextureFrames = sink->Take();
+		Thumbnails = sink->TakeThumbnails();
+		for (auto* tex : TextureFrames) { tex->UpdateTexture(); }
+		for (auto* tex : Thumbnails) { tex->UpdateTexture(); }
+	}
+	UploadReadyFrames();
+	SelectedFrame = std::clamp(SelectedFrame, 0, std::max(load->Job->FrameCount() - 1, 0));
+}
+
+// The finished preview goes into the cache under the key it was submitted with. Encoding
+// and writing happen on the cache's thread: a store is read back there, it stays alive with
+// the task; textures go with the next preview, so their pixels are copied here.
+void AppLayer::StoreCachedFrames() {
+	if (!PendingCacheKey) return;
+	StateKey key = std::move(*PendingCacheKey);
+	PendingCacheKey.reset();
+
+	if (Store) {
+		// stores that don't keep plain pixels are read back for the encoder
+		std::shared_ptr<FrameStore> store = Store;
+		Cache.StoreAsync(std::move(key), store->FrameCount(), [store](int frame, std::vector<uint8_t>& pixels) {
+			Draw::ImageView view;
+			if (store->View(frame, view)) return view;
+			pixels.resize((size_t)store->Size() * store->Size() * 4);
+			view = { pixels.data(), store->Size(), store->Size(), 4 };
+			store->Read(frame, view);
+			return view;
+		});
+		return;
+	}
 
+	auto copies = std::make_shared<std::vector<std::vector<uint8_t>>>();
+	for (auto* tex : TextureFrames) {
+		Draw::ImageView frame = Draw::ImageView::Of(tex);
+		copies->emplace_back(frame.Pixels, frame.Pixels + frame.ByteSize());
+	}
+	int size = TextureFrames.empty() ? 0 : TextureFrames[0]->Width();
+	Cache.StoreAsync(std::move(key), (int)copies->size(), [copies, size](int frame, std::vector<uint8_t>&) {
+		return Draw::ImageView{ (*copies)[frame].data(), size, size, 4 };
+	});
+}
+
+RenderSettings AppLayer::SettingsFor(const std::string& generatorName) {
+	std::lock_guard<std::mutex> lock(TuningLock);
+	RenderSettings settings;
+	Tuning.Find(generatorName, settings);
+	return settings;
+}
+
+// benchmarks on a background thread and swaps the new profile in when done
+void AppLayer::StartAutotune() {
+	if (IsTuning.exchange(true)) return;
+	if (TuneThread.joinable()) TuneThread.join();
+
+	DXE_INFO("Autotuning render settings...");
+	TuneThread = std::thread([this, generators = Generators]() {
+		TuningProfile profile = Autotuner(Scheduler).Run(generators);
+		if (!profile.Save()) { DXE_LOG("Failed to save autotune profile: ", TuningProfile::DefaultPath().string()); }
+		{
+			std::lock_guard<std::mutex> lock(TuningLock);
+			Tuning = std::move(profile);
+		}
+		IsTuning = false;
+	});
 }
 
+void AppLayer::CreateCheckerSampler() {
+	D3D11_SAMPLER_DESC desc = {};
+	desc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+	desc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	desc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	desc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	desc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+	desc.MaxLOD = D3D11_FLOAT32_MAX;
+	if (FAILED(DXE::Renderer::Device()->CreateSamplerState(&desc, &CheckerSampler))) {
+		DXE_LOG("Checker sampler unavailable, falling back to per-tile checkerboard");
+		CheckerSampler = nullptr;
+	}
+}
+
+bool AppLayer::UpdateCheckerPattern(ImU32 col1, ImU32 col2) {
+	if (CheckerPattern && CheckerColors[0] == col1 && CheckerColors[1] == col2) return true;
+
+	if (!CheckerPattern) CheckerPattern = new DXE::Texture(2, 2, 4);
+	CheckerColors[0] = col1;
+	CheckerColors[1] = col2;
+
+	// IM_COL32 is RGBA in memory order
+	auto& pixels = CheckerPattern->Pixels();
+	const ImU32 texels[4] = { col1, col2, col2, col1 };
+	std::memcpy(pixels.data(), texels, sizeof(texels));
+	CheckerPattern->UpdateTexture();
+	return true;
+}
+
+void AppLayer::BindCheckerSampler(const ImDrawList* list, const ImDrawCmd* cmd) {
+	ID3D11SamplerState* sampler = (ID3D11SamplerState*)cmd->UserCallbackData;
+	DXE::Renderer::Context()->PSSetSamplers(0, 1, &sampler);
+}
+
+// builds both checkerboard paths once in a headless ImGui context at a 4K preview size
+void AppLayer::MeasureCheckerboardCost() {
+	const ImVec2 display = { 3840.f, 2160.f };
+	const float tile = 16.f;
+	const ImU32 col1 = IM_COL32(3, 3, 3, 255);
+	const ImU32 col2 = IM_COL32(1, 1, 1, 255);
+
+	CheckerCostTiles = Widgets::MeasureDrawCost(display, [&](ImDrawList* draw_list, ImVec2 pos, ImVec2 size) {
+		Widgets::CheckerboardTiles(draw_list, pos, size, tile, col1, col2);
+	});
+	CheckerCostQuad = Widgets::MeasureDrawCost(display, [&](ImDrawList* draw_list, ImVec2 pos, ImVec2 size) {
+		Widgets::CheckerboardQuad(draw_list, (ImTextureID)1, pos, size, tile);
+	});
+	DXE_INFO("Checkerboard at 4K: ", CheckerCostTiles.Vertices, " vertices per-tile, ", CheckerCostQuad.Vertices, " vertices batched");
+}
+
+void AppLayer::DrawUiStats() {
+	ImGui::Checkbox("Idle Mode", &IdleMode);
+	ImGui::SameLine();
+	ImGui::TextDisabled("idle frames %d", IdleFrames);
+	ImGui::Text("UI vertices: %d, indices: %d (preview %d)", UiVertexCount, UiIndexCount, PreviewVertexCount);
+	ImGui::TextDisabled("4K checkerboard: %d vertices per-tile, %d batched", CheckerCostTiles.Vertices, CheckerCostQuad.Vertices);
+	if (Store) {
+		ImGui::Text("Frame store: %.1f MB for %.1f MB of frames", Store->StoredBytes() / 1e6, Store->RawBytes() / 1e6);
+	}
+}
+
+// Picks up the sequence the last session left in the frame cache, stale files are removed.
+// The generator comes back with the parameters it rendered with; when that state doesn't give
+// the key the frames were stored under (a setting the file can't restore, an uncacheable
+// chain) the frames are dropped rather than shown against the wrong parameters.
+void AppLayer::OpenLastFrameCache() {
+	std::error_code ec;
+	std::filesystem::path dir = MappedFrameStore::DefaultDirectory();
+	std::vector<std::filesystem::path> files;
+	for (auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+		if (entry.path().extension() == ".sgf") files.push_back(entry.path());
+	}
+	if (files.empty()) return;
+
+	std::sort(files.begin(), files.end(), [](auto& a, auto& b) {
+		std::error_code e;
+		return std::filesystem::last_write_time(a, e) > std::filesystem::last_write_time(b, e);
+	});
+	for (size_t i = 1; i < files.size(); i++) { std::filesystem::remove(files[i], ec); }
+
+	auto store = MappedFrameStore::Open(files[0]);
+	if (!store) {
+		std::filesystem::remove(files[0], ec);
+		return;
+	}
+
+	auto it = Generators.find(store->Generator());
+	if (it == Generators.end() || store->StateHash() == 0) {
+		DXE_LOG("Frame cache can't be restored: ", files[0].string());
+		store->Discard();
+		return;
+	}
+	std::unique_ptr<IFrameGenerator> previous = std::exchange(ActiveGenerator, it->second());
+	int previousSize = Size;
+	int previousCount = FrameCount;
+	store->RestoreFields(*ActiveGenerator);
+	Size = store->Size();
+	FrameCount = store->FrameCount();
+
+	RenderSettings settings = SettingsFor(it->first);
+	StateKey key;
+	if (!RenderCache::Key(*JobGenerator(settings), OutputSize(), FrameCount, settings.Variant, key) || key.Hash() != store->StateHash()) {
+		DXE_LOG("Frame cache doesn't match its restored settings: ", files[0].string());
+		ActiveGenerator = std::move(previous);
+		Size = previousSize;
+		FrameCount = previousCount;
+		store->Discard();
+		return;
+	}
+	DXE_INFO("Reopened frame cache: ", files[0].string());
+
+	SelectedGeneratorName = it->first;
+	Storage = FrameStorage::MappedFile;
+	SelectedFrame = 0;
+	UseStore(store);
+	UploadReadyFrames();
+}
+
+// renders the current generator and settings into the export pipeline, the preview keeps going
+void AppLayer::StartExport() {
+	if (!ActiveGenerator) return;
+	CancelExport();
+
+	ExportSettings settings = Export;
+	settings.Folder = ExportFolder;
+	settings.Name = ActiveGenerator->GetName();
+	settings.Loop = ActiveGenerator->IsLooping();
+	std::replace(settings.Name.begin(), settings.Name.end(), ' ', '_');
+
+	PlaneExporters.clear();
+	if (Output == OutputMode::Masks && MaskPlanes && MaskGenerator::CanWrap(*ActiveGenerator) && !MaskOutputs.empty()) {
+		// one render, each mask split off into an export of its own, <name>_<mask>
+		std::vector<MaskPlaneSink::Plane> planes;
+		for (const MaskOutput& mask : JobMasks()) {
+			ExportSettings plane = settings;
+			plane.Name += "_" + mask.Name;
+			std::replace(plane.Name.begin(), plane.Name.end(), ' ', '_');
+			PlaneExporters.push_back(std::make_shared<ExportPipeline>(OutputSize(), FrameCount, plane));
+			planes.push_back({ mask.Channel, PlaneExporters.back() });
+		}
+		Exporter = PlaneExporters.front();
+		ExportJob = SubmitJob(JobPriority::Export, std::make_shared<MaskPlaneSink>(OutputSize(), std::move(planes)));
+	}
+	else {
+		Exporter = std::make_shared<ExportPipeline>(OutputSize(), FrameCount, settings);
+		ExportJob = SubmitJob(JobPriority::Export, Exporter);
+	}
+	if (!ExportJob) { Exporter.reset(); PlaneExporters.clear(); return; }
+	DXE_INFO("Exporting ", ExportFormatName(settings.Format), " to ", settings.Folder.string());
+}
 
+void AppLayer::CancelExport() {
+	if (Exporter) Exporter->Cancel();
+	for (auto& plane : PlaneExporters) plane->Cancel();
+	if (ExportJob) ExportJob->Cancel();
+}
+
+bool AppLayer::IsExporting() const {
+	if (Exporter && !Exporter->IsDone()) return true;
+	return std::any_of(PlaneExporters.begin(), PlaneExporters.end(), [](auto& plane) { return !plane->IsDone(); });
+}
+
+void AppLayer::DrawExportUI() {
+	ImGui::SeparatorText("Export");
+	int format = (int)Export.Format;
+	if (ImGui::Combo("Format", &format, "PNG Sequence\0PNG Strip\0DDS Sequence\0KTX2 Sequence\0APNG\0GIF\0Atlas\0")) { Export.Format = (ExportFormat)format; }
+	if (Export.Format == ExportFormat::Atlas) {
+		int page = Export.AtlasPage <= 1024 ? 0 : Export.AtlasPage <= 2048 ? 1 : 2;
+		if (ImGui::Combo("Max Page", &page, "1024\0" "2048\0" "4096\0")) { Export.AtlasPage = 1024 << page; }
+		ImGui::SliderInt("Padding", &Export.AtlasPadding, 0, 4);
+	}
+	if (Export.IsBlockCompressed()) {
+		// BC4 keeps the mask channel only, BC1 drops alpha
+		int block = (int)Export.Block;
+		if (ImGui::Combo("Block", &block, "BC1 (color)\0BC3 (color + alpha)\0BC4 (mask)\0")) { Export.Block = (Bc::Format)block; }
+		int quality = (int)Export.Quality;
+		if (ImGui::Combo("Quality", &quality, "Fast\0High\0")) { Export.Quality = (Bc::Quality)quality; }
+		ImGui::Checkbox("Mipmaps", &Export.Mips);
+	}
+	ImGui::InputText("Folder", ExportFolder, sizeof(ExportFolder));
+	ImGui::SliderInt("Encoders", &Export.EncodeThreads, 0, (int)std::thread::hardware_concurrency());
+
+	bool running = IsExporting();
+	if (running) {
+		if (ImGui::Button("Cancel Export")) { CancelExport(); }
+		ImGui::SameLine();
+		ImGui::ProgressBar(Exporter->Progress(), ImVec2(-1, 0), "Exporting");
+	}
+	else if (ImGui::Button("Export") && ActiveGenerator) {
+		StartExport();
+	}
+	if (!Exporter) return;
+
+	// busy time per stage, the largest one is what limits the export
+	ExportPipeline::Stats stats = Exporter->GetStats();
+	ImGui::Text("%s: %d/%d written, %.1f MB in %.2f s", Exporter->Failed() ? "Failed" : Exporter->IsCancelled() ? "Cancelled" : "Export",
+		stats.Written, stats.Total, stats.BytesWritten / 1e6, stats.ElapsedSeconds);
+	ImGui::TextDisabled("generated %d, aliased %d, encoded %d, peak in flight %d, encode %.2f s over %d threads, write %.2f s",
+		stats.Generated, stats.Aliased, stats.Encoded, stats.PeakInFlight, stats.EncodeSeconds, Exporter->GetSettings().ResolveEncodeThreads(), stats.WriteSeconds);
+	if (PlaneExporters.size() > 1) ImGui::TextDisabled("first of %d mask planes", (int)PlaneExporters.size());
+}
+
+// the active generator at one time point, in the export folder; the preview keeps going
+void AppLayer::StartCanvas() {
+	if (!ActiveGenerator || !CanvasRender::CanRender(*ActiveGenerator)) return;
+	Canvas.reset();
+
+	CanvasSettings settings = CanvasOptions;
+	settings.Render = SettingsFor(ActiveGenerator->GetName());
+	std::string name = ActiveGenerator->GetName();
+	std::replace(name.begin(), name.end(), ' ', '_');
+	std::filesystem::path path = std::filesystem::path(ExportFolder) / (name + "_canvas.png");
+	Canvas = std::make_unique<CanvasRender>(*ActiveGenerator, settings, path);
+	DXE_INFO("Rendering ", settings.Width, "x", settings.Height, " canvas to ", path.string());
+}
+
+void AppLayer::DrawCanvasUI() {
+	ImGui::SeparatorText("Canvas");
+	ImGui::InputInt("Canvas Width", &CanvasOptions.Width, 1024);
+	ImGui::InputInt("Canvas Height", &CanvasOptions.Height, 1024);
+	// PNG dimensions are 31 bits
+	CanvasOptions.Width = std::clamp(CanvasOptions.Width, 1, INT32_MAX / 4);
+	CanvasOptions.Height = std::clamp(CanvasOptions.Height, 1, INT32_MAX / 4);
+	ImGui::SliderInt("Band Rows", &CanvasOptions.BandRows, 1, 256);
+	float time = (float)CanvasOptions.Time;
+	if (ImGui::SliderFloat("Canvas Time", &time, 0.f, 1.f)) { CanvasOptions.Time = time; }
+	double bandMb = (double)(CanvasOptions.BandRows + 1) * CanvasOptions.Width * 4 / 1e6;
+	ImGui::TextDisabled("%.1f MB per band, %.1f MB for the whole image", bandMb, (double)CanvasOptions.Width * CanvasOptions.Height * 4 / 1e6);
+
+	if (ActiveGenerator && !CanvasRender::CanRender(*ActiveGenerator)) {
+		ImGui::TextDisabled("%s has a whole-frame pass and can't be rendered in bands", ActiveGenerator->GetName());
+	}
+	else if (Canvas && !Canvas->IsDone()) {
+		if (ImGui::Button("Cancel Canvas")) { Canvas->Cancel(); }
+		ImGui::SameLine();
+		ImGui::ProgressBar(Canvas->Progress(), ImVec2(-1, 0), "Rendering");
+	}
+	else if (ImGui::Button("Render Canvas")) {
+		StartCanvas();
+	}
+	if (!Canvas) return;
+
+	CanvasRender::Stats stats = Canvas->GetStats();
+	ImGui::Text("%s: %d/%d bands, %.1f MB in %.2f s", Canvas->Failed() ? "Failed" : Canvas->IsDone() && stats.Written < stats.Bands ? "Cancelled" : "Canvas",
+		stats.Written, stats.Bands, stats.BytesWritten / 1e6, stats.ElapsedSeconds);
+	ImGui::TextDisabled("%s, peak %.1f MB held", Canvas->FilePath().string().c_str(), stats.PeakBytes / 1e6);
+}
+
+void AppLayer::StartService() {
+	std::filesystem::path temp = std::filesystem::temp_directory_path();
+	// service renders get the settings tuned for their generator, like the app's own
+	Service = std::make_unique<RenderService>(Scheduler, Generators, [this](const std::string& name) { return SettingsFor(name); },
+		temp / "SpriteGen.sock", temp / "SpriteGenService");
+	if (!Service->Start()) { Service.reset(); }
+}
+
+void AppLayer::DrawServiceUI() {
+	ImGui::SeparatorText("Render Service");
+	bool serving = Service != nullptr;
+	if (ImGui::Checkbox("Serve Requests", &serving)) {
+		if (serving) StartService();
+		else Service.reset();
+	}
+	if (!Service) return;
+
+	RenderService::Stats stats = Service->GetStats();
+	ImGui::TextDisabled("%s", Service->SocketPath().string().c_str());
+	ImGui::TextDisabled("%d requests from %d clients: %d cached, %d joined in flight, %d rendered, %d failed",
+		stats.Requests, stats.Clients, stats.CacheHits, stats.Coalesced, stats.Rendered, stats.Failed);
+}
+
+void AppLayer::DrawRenderCacheUI() {
+	ImGui::SeparatorText("Render Cache");
+	ImGui::Checkbox("Use Render Cache", &UseRenderCache);
+	int maxMb = (int)(Cache.MaxSize() >> 20);
+	if (ImGui::InputInt("Max Size (MB)", &maxMb, 256)) { Cache.SetMaxSize((uint64_t)std::max(maxMb, 64) << 20); }
+
+	RenderCache::Stats stats = Cache.GetStats();
+	ImGui::TextDisabled("%s", Cache.Directory().string().c_str());
+	ImGui::TextDisabled("%d hits, %d misses, %d stored; %d entries, %.1f MB", stats.Hits, stats.Misses, stats.Stored, stats.Entries, stats.Bytes / 1e6);
+}
+
+// one or two parameters to vary across a grid, each axis from Min to Max in Steps
+bool AppLayer::DrawSweepUI() {
+	std::vector<const char*> fields = ActiveGenerator->SweepFields();
+	if (fields.empty()) return false;
+
+	ImGui::SeparatorText("Sweep");
+	bool changing = ImGui::Checkbox("Sweep Parameters", &SweepEnabled);
+	if (!SweepEnabled) return changing;
+
+	// the field list changes with the generator
+	if (SweepX.Field < 0 || SweepX.Field >= (int)fields.size()) SweepX.Field = 0;
+	if (SweepY.Field >= (int)fields.size()) SweepY.Field = -1;
+
+	auto axis = [&](const char* label, SweepAxis& a, bool optional) {
+		bool changed = false;
+		ImGui::PushID(label);
+		const char* current = a.Field >= 0 ? fields[a.Field] : "None";
+		if (ImGui::BeginCombo(label, current)) {
+			if (optional && ImGui::Selectable("None", a.Field < 0)) { a.Field = -1; changed = true; }
+			for (int i = 0; i < (int)fields.size(); i++) {
+				if (!ImGui::Selectable(fields[i], i == a.Field)) continue;
+				// start around the current value
+				float value = ActiveGenerator->GetSweepField(i);
+				a.Field = i;
+				a.Min = value != 0.f ? 0.5f * value : 0.f;
+				a.Max = value != 0.f ? 1.5f * value : 1.f;
+				changed = true;
+			}
+			ImGui::EndCombo();
+		}
+		if (a.Field >= 0) {
+			changed |= ImGui::InputFloat("Min", &a.Min);
+			changed |= ImGui::InputFloat("Max", &a.Max);
+			changed |= ImGui::SliderInt("Steps", &a.Steps, 1, 8);
+		}
+		ImGui::PopID();
+		return changed;
+	};
+	changing |= axis("Across", SweepX, false);
+	changing |= axis("Down", SweepY, true);
+	ImGui::TextDisabled("%d variants per frame", SweepX.Count() * SweepY.Count());
+	return changing;
+}
+
+// Masks shaped from the generator's field, each with its own bias, brightness and curve. New
+// ones start as the generator's own mask.
+bool AppLayer::DrawMaskUI() {
+	if (Output != OutputMode::Masks) return false;
+	ImGui::SeparatorText("Masks");
+	if (!MaskGenerator::CanWrap(*ActiveGenerator)) {
+		ImGui::TextDisabled("%s has no field kernel, it renders its own mask", ActiveGenerator->GetName());
+		return false;
+	}
+
+	bool changing = ImGui::Checkbox("Separate Planes", &MaskPlanes);
+	static const char* Channels[] = { "R", "G", "B", "A" };
+	int remove = -1;
+	for (int i = 0; i < (int)MaskOutputs.size(); i++) {
+		MaskOutput& mask = MaskOutputs[i];
+		ImGui::PushID(i);
+		char name[64];
+		std::snprintf(name, sizeof(name), "%s", mask.Name.c_str());
+		if (ImGui::InputText("Name", name, sizeof(name))) mask.Name = name;
+		if (!MaskPlanes) changing |= ImGui::Combo("Channel", &mask.Channel, Channels, 4);
+		changing |= ImGui::SliderFloat("Bias", &mask.Bias, -1.f, 1.f);
+		changing |= ImGui::SliderFloat("Brightness", &mask.Brightness, 0.f, 16.f);
+		mask.Brightness = std::max(mask.Brightness, 0.f);
+		int curve = (int)mask.Curve;
+		if (ImGui::Combo("Curve", &curve, "Linear\0Smooth\0Power\0")) { mask.Curve = (MaskCurve)curve; changing = true; }
+		if (mask.Curve == MaskCurve::Power) changing |= ImGui::SliderFloat("Exponent", &mask.Exponent, 0.1f, 8.f);
+		if (ImGui::Button("Remove")) remove = i;
+		ImGui::Separator();
+		ImGui::PopID();
+	}
+	if (remove >= 0) {
+		MaskOutputs.erase(MaskOutputs.begin() + remove);
+		changing = true;
+	}
+	if (MaskOutputs.empty()) ImGui::TextDisabled("no masks, frames are the generator's own mask");
+	if ((int)MaskOutputs.size() < MaskGenerator::MaxOutputs && ImGui::Button("Add Mask")) {
+		MaskOutput mask = ActiveGenerator->FieldMask();
+		mask.Name = "mask" + std::to_string(MaskOutputs.size());
+		mask.Channel = (int)MaskOutputs.size();
+		MaskOutputs.push_back(mask);
+		changing = true;
+	}
+	return changing;
+}
\ No newline at end of file
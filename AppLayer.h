@@ -10,6 +10,20 @@
 #include "Maths/Maths.h"
 
 #include "DrawFunctions.h"
+#include "Profiler.h"
+#include "FrameRenderer.h"
+#include "RenderJob.h"
+#include "Autotune.h"
+#include "DistanceField.h"
+#include "FrameStore.h"
+#include "Export.h"
+#include "Sweep.h"
+#include "Composite.h"
+#include "RenderService.h"
+#include "RenderCache.h"
+#include "Canvas.h"
+#include "Masks.h"
+#include <optional>
 
 
 
@@ -32,23 +46,160 @@ public:
     std::string SelectedGeneratorName;
 
     std::vector<DXE::Texture*> TextureFrames;
+    std::vector<DXE::Texture*> Thumbnails;      // 32px copies of TextureFrames for the timeline
+    std::vector<DXE::Texture*> CompareFrames;
     int SelectedFrame = -1;
     int Size = 256;
     int FrameCount = 30;
+    OutputMode Output = OutputMode::Bitmap;
+    // sweep mode: every frame is a grid of parameter variants (SweepGenerator)
+    bool SweepEnabled = false;
+    SweepAxis SweepX = { 0 };
+    SweepAxis SweepY;
+    int SdfSize = 64;           // output size in DistanceField mode, Size is the mask resolution
+    float SdfRange = 0.25f;     // distance in -1..1 frame units that maps to 0 and 1
+    // masks mode: the outputs shaped from the generator's field, packed into the channels or,
+    // with MaskPlanes, exported as a sequence each
+    std::vector<MaskOutput> MaskOutputs;
+    bool MaskPlanes = false;
     bool Playing = false;
+    bool ShowCompare = false;
     std::atomic<bool> IsGenerating = false;
 
+    RenderScheduler Scheduler;
+    std::shared_ptr<RenderJob> PreviewJob;
+    std::shared_ptr<RenderJob> CompareJob;
+    TextureSink* PreviewSink = nullptr;   // owned by PreviewJob
+    std::vector<char> PreviewReady;       // frames of PreviewJob already uploaded
+
+    // with a FrameStore the sequence stays in the store and only the frame on screen is
+    // read back into StoreFrame; Thumbnails are filled from the store's copies
+    FrameStorage Storage = FrameStorage::Textures;
+    std::shared_ptr<FrameStore> Store;
+    std::vector<char> StoreReady;
+    DXE::Texture* StoreFrame = nullptr;
+    int StoreFrameIndex = -1;
+    int TimelineFirstVisible = 0;
+    int TimelineLastVisible = -1;
+
+    // preview background: 2x2 pattern drawn through a wrapping point sampler
+    DXE::Texture* CheckerPattern = nullptr;
+    ImU32 CheckerColors[2] = { 0, 0 };
+    ID3D11SamplerState* CheckerSampler = nullptr;
+
+    // idle mode: with no input, playback or rendering the last draw data is resubmitted
+    // instead of rebuilding the UI
+    bool IdleMode = true;
+    int UiDirtyFrames = 2;
+    int IdleFrames = 0;
+    int UiVertexCount = 0;
+    int UiIndexCount = 0;
+    int PreviewVertexCount = 0;
+    Widgets::DrawCost CheckerCostTiles;
+    Widgets::DrawCost CheckerCostQuad;
+
+    // export renders at JobPriority::Export beside the preview, ExportPipeline encodes and writes
+    ExportSettings Export;
+    char ExportFolder[260] = "Export";
+    std::shared_ptr<ExportPipeline> Exporter;
+    std::shared_ptr<RenderJob> ExportJob;
+    std::vector<std::shared_ptr<ExportPipeline>> PlaneExporters;   // one per mask, Exporter is the first
+
+    // one still larger than any frame, rendered in bands straight into a PNG
+    CanvasSettings CanvasOptions;
+    std::unique_ptr<CanvasRender> Canvas;
+
+    // renders for other processes on the same scheduler; started with --serve or from the UI
+    std::unique_ptr<RenderService> Service;
+
+    // finished previews on disk by the key of what decides their pixels; a preview whose key is
+    // there loads instead of rendering, one that renders goes in when it finishes. Loads run on
+    // the cache's thread with the preview job built but not submitted, a miss submits it.
+    struct CacheLoad {
+        std::shared_ptr<RenderJob> Job;
+        std::shared_ptr<FrameStore> Store;
+        std::atomic<int> Result = -1;   // 1 hit, 0 miss, set by the cache thread
+    };
+    RenderCache Cache;
+    bool UseRenderCache = true;
+    std::optional<StateKey> PendingCacheKey;
+    std::shared_ptr<CacheLoad> PendingLoad;
+    std::vector<std::shared_ptr<CacheLoad>> StaleLoads;    // superseded, held until answered
+
+    TuningProfile Tuning;
+    std::mutex TuningLock;
+    std::thread TuneThread;
+    std::atomic<bool> IsTuning = false;
+
     void RegisterGenerators() {
         Generators = {
             { "Slash Trail",    []() { return std::make_unique<SlashTrailGenerator>();}},
             { "Lightning Beam", []() { return std::make_unique<LightningBeamGenerator>();}}
         };
+        // a stack's layers can be any of the generators above, it starts as a slash over a beam
+        auto layers = std::make_shared<LayerStackGenerator::Factories>(Generators.begin(), Generators.end());
+        Generators["Layer Stack"] = [layers]() {
+            auto stack = std::make_unique<LayerStackGenerator>(layers);
+            stack->AddLayer("Lightning Beam");
+            stack->AddLayer("Slash Trail", BlendMode::Screen);
+            return stack;
+        };
     }
 
 
 
 
     void GenerateFramesMultiThreaded();
+    std::shared_ptr<RenderJob> MakeJob(JobPriority priority, std::shared_ptr<FrameSink> sink = nullptr);
+    std::shared_ptr<RenderJob> SubmitJob(JobPriority priority, std::shared_ptr<FrameSink> sink = nullptr);
+    std::unique_ptr<IFrameGenerator> JobGenerator(const RenderSettings& settings) const;
+    std::vector<MaskOutput> JobMasks() const;
+    void StartPreview(std::shared_ptr<RenderJob> job, std::shared_ptr<FrameStore> store);
+    void FinishCacheLoad();
+    void StoreCachedFrames();
+    int OutputSize() const { return Output == OutputMode::DistanceField ? SdfSize : Size; }
+    void UseStore(std::shared_ptr<FrameStore> store);
+    void OpenLastFrameCache();
+    void ShowStoredFrame(int frame);
+    void CollectFinishedJobs();
+    void UploadReadyFrames();
+
+    // while a preview renders, finished frames replace the old ones one by one
+    int DisplayFrameCount() const {
+        if (PreviewJob) return PreviewJob->FrameCount();
+        return Store ? Store->FrameCount() : (int)TextureFrames.size();
+    }
+    DXE::Texture* DisplayedFrame(int i) const {
+        if (Store) return (i == StoreFrameIndex) ? StoreFrame : nullptr;
+        if (PreviewJob && i >= 0 && i < (int)PreviewReady.size() && PreviewReady[i]) return PreviewSink->Texture(i);
+        if (i >= 0 && i < (int)TextureFrames.size()) return TextureFrames[i];
+        return nullptr;
+    }
+    DXE::Texture* DisplayedThumbnail(int i) const {
+        if (Store) return (i >= 0 && i < (int)StoreReady.size() && StoreReady[i]) ? Thumbnails[i] : nullptr;
+        if (PreviewJob && i >= 0 && i < (int)PreviewReady.size() && PreviewReady[i]) return PreviewSink->Thumbnail(i);
+        if (i >= 0 && i < (int)Thumbnails.size()) return Thumbnails[i];
+        return nullptr;
+    }
+    void DockProfilerBesidePreview();
+    void CreateCheckerSampler();
+    bool UpdateCheckerPattern(ImU32 col1, ImU32 col2);
+    static void BindCheckerSampler(const ImDrawList* list, const ImDrawCmd* cmd);
+    void MeasureCheckerboardCost();
+    void DrawUiStats();
+    void StartExport();
+    void CancelExport();
+    bool IsExporting() const;
+    void DrawExportUI();
+    void StartCanvas();
+    void DrawCanvasUI();
+    void StartService();
+    void DrawServiceUI();
+    void DrawRenderCacheUI();
+    bool DrawSweepUI();
+    bool DrawMaskUI();
+    void StartAutotune();
+    RenderSettings SettingsFor(const std::string& generatorName);
 
     void DeleteFrame(std::vector<DXE::Texture*>& textures, size_t index) {
         if (index >= textures.size() || index < 0) return;
@@ -59,14 +210,17 @@ public:
         TextureFrames.push_back(new DXE::Texture(size,size,4));
     }
 
-    void DrawFrameTimeline(std::vector<DXE::Texture*>& frames, int& selectedFrame)
+    // Only the cells inside the scrolled view are submitted, so the cost per UI tick
+    // doesn't grow with the frame count. A Dummy spans the full strip for the scrollbar.
+    void DrawFrameTimeline(int frameCount, int& selectedFrame)
     {
         ImGui::Begin("Timeline");
 
         const float frameSize = 32.0f;
         const float spacing = 4.0f;
+        const float cellWidth = frameSize + spacing;
 
-        float contentWidth = (frameSize + spacing) * frames.size();
+        float contentWidth = cellWidth * frameCount;
         ImVec2 regionAvail = ImGui::GetContentRegionAvail();
 
         // Calculate horizontal offset to center the timeline
@@ -86,28 +240,41 @@ public:
         ImVec2 origin = ImGui::GetCursorScreenPos();
         origin.x += offsetX;
 
-        for (size_t i = 0; i < frames.size(); ++i)
+        // cells inside the scrolled view, also handed to the scheduler as a render priority
+        float scrollX = ImGui::GetScrollX();
+        float viewWidth = ImGui::GetContentRegionAvail().x;
+        TimelineFirstVisible = std::max(0, (int)((scrollX - offsetX) / cellWidth));
+        TimelineLastVisible = std::min(frameCount - 1, (int)((scrollX + viewWidth - offsetX) / cellWidth));
+
+        for (int i = TimelineFirstVisible; i <= TimelineLastVisible; ++i)
         {
-            ImVec2 p_min = { origin.x + i * (frameSize + spacing), origin.y };
+            ImVec2 p_min = { origin.x + i * cellWidth, origin.y };
             ImVec2 p_max = { p_min.x + frameSize, p_min.y + frameSize };
 
             draw_list->AddRectFilled(p_min, p_max, IM_COL32(40, 40, 40, 255));
             draw_list->AddRect(p_min, p_max, IM_COL32(80, 80, 80, 255));
 
-            if (frames[i]) draw_list->AddImage((ImTextureID)frames[i]->GetShaderResourceView(), p_min, p_max);
+            DXE::Texture* thumbnail = DisplayedThumbnail(i);
+            if (thumbnail) draw_list->AddImage((ImTextureID)thumbnail->GetShaderResourceView(), p_min, p_max);
 
             ImGui::SetCursorScreenPos(p_min);
-            ImGui::InvisibleButton(("frame_" + std::to_string(i)).c_str(), ImVec2(frameSize, frameSize));
+            ImGui::PushID(i);
+            ImGui::InvisibleButton("frame", ImVec2(frameSize, frameSize));
+            ImGui::PopID();
 
             if (ImGui::IsItemClicked()) {
-                selectedFrame = (int)i;
+                selectedFrame = i;
                 Playing = false;
             }
 
-            if ((int)i == selectedFrame)
+            if (i == selectedFrame)
                 draw_list->AddRect(p_min, p_max, IM_COL32(255, 200, 0, 255), 0.0f, 0, 2.0f);
         }
 
+        // reserve the whole strip so the scroll range covers every frame
+        ImGui::SetCursorScreenPos(origin);
+        ImGui::Dummy(ImVec2(contentWidth, frameSize));
+
         ImGui::EndChild();
         ImGui::End();
     }
@@ -123,49 +290,65 @@ public:
         ImVec2 win_pos = ImGui::GetCursorScreenPos();
         ImVec2 win_size = ImGui::GetContentRegionAvail();
 
-        int tiles_x = (int)(win_size.x / tile_size) + 1;
-        int tiles_y = (int)(win_size.y / tile_size) + 1;
-
-        for (int y = 0; y < tiles_y; ++y) {
-            for (int x = 0; x < tiles_x; ++x) {
-                bool isEven = (x + y) % 2 == 0;
-                ImVec2 tile_min = ImVec2(win_pos.x + x * tile_size, win_pos.y + y * tile_size);
-                ImVec2 tile_max = ImVec2(tile_min.x + tile_size, tile_min.y + tile_size);
-                draw_list->AddRectFilled(tile_min, tile_max, isEven ? col1 : col2);
-            }
+        // single repeating quad when the wrap sampler is available, one rect per tile otherwise
+        if (CheckerSampler && UpdateCheckerPattern(col1, col2)) {
+            ImTextureID pattern = (ImTextureID)CheckerPattern->GetShaderResourceView();
+            Widgets::CheckerboardQuad(draw_list, pattern, win_pos, win_size, tile_size, BindCheckerSampler, CheckerSampler);
+        }
+        else {
+            Widgets::CheckerboardTiles(draw_list, win_pos, win_size, tile_size, col1, col2);
         }
     }
-    void DrawMainFramePreview(const std::vector<DXE::Texture*>& frames, int selectedFrame)
+
+    // fits the texture inside [cursor, cursor + avail) keeping its aspect ratio, centered
+    void DrawFittedImage(DXE::Texture* tex, ImVec2 cursor, ImVec2 avail)
+    {
+        // Get the texture to display
+        ImTextureID texID = (ImTextureID)tex->GetShaderResourceView();
+
+        // Compute aspect ratio
+        float texWidth = (float)tex->Width();
+        float texHeight = (float)tex->Height();
+        float aspect = texWidth / texHeight;
+
+        // Fit image inside available area
+        ImVec2 size;
+        if (avail.x / avail.y > aspect)
+            size = ImVec2(avail.y * aspect, avail.y);
+        else
+            size = ImVec2(avail.x, avail.x / aspect);
+
+        // Center it
+        ImVec2 centerOffset = ImVec2((avail.x - size.x) * 0.5f, (avail.y - size.y) * 0.5f);
+        ImVec2 pos = { cursor.x + centerOffset.x, cursor.y + centerOffset.y };
+        ImGui::SetCursorPos(pos);
+
+        // Draw texture
+        ImGui::Image(texID, size);
+    }
+
+    void DrawMainFramePreview(int selectedFrame)
     {
         ImGui::Begin("Frame Preview", nullptr, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
 
         DrawCheckerboard(16.f, IM_COL32(3, 3, 3, 255), IM_COL32(1, 1, 1, 255));
+        PreviewVertexCount = ImGui::GetWindowDrawList()->VtxBuffer.Size;
 
-        if (selectedFrame >= 0 && selectedFrame < (int)frames.size() && frames[selectedFrame])  {
-            // Get the texture to display
-            ImTextureID texID = (ImTextureID)frames[selectedFrame]->GetShaderResourceView();
-
-            // Compute available region and aspect ratio
+        DXE::Texture* frame = DisplayedFrame(selectedFrame);
+        if (frame)  {
             ImVec2 avail = ImGui::GetContentRegionAvail();
-            float texWidth = (float)frames[selectedFrame]->Width();
-            float texHeight = (float)frames[selectedFrame]->Height();
-            float aspect = texWidth / texHeight;
-
-            // Fit image inside available area
-            ImVec2 size;
-            if (avail.x / avail.y > aspect)
-                size = ImVec2(avail.y * aspect, avail.y);
-            else
-                size = ImVec2(avail.x, avail.x / aspect);
-
-            // Center it
             ImVec2 cursor = ImGui::GetCursorPos();
-            ImVec2 centerOffset = ImVec2((avail.x - size.x) * 0.5f, (avail.y - size.y) * 0.5f);
-            ImVec2 pos = { cursor.x + centerOffset.x, cursor.y + centerOffset.y };
-            ImGui::SetCursorPos(pos);
 
-            // Draw texture
-            ImGui::Image(texID, size);
+            // comparison variant on the right, same frame index where it exists
+            if (ShowCompare && !CompareFrames.empty()) {
+                avail.x *= 0.5f;
+                int compareFrame = std::min(selectedFrame, (int)CompareFrames.size() - 1);
+                DrawFittedImage(frame, cursor, avail);
+                DrawFittedImage(CompareFrames[compareFrame], { cursor.x + avail.x, cursor.y }, avail);
+            }
+            else {
+                DrawFittedImage(frame, cursor, avail);
+            }
         }
         else
         {
@@ -214,14 +397,38 @@ public:
             ImGui::EndCombo();
         }
 
+        if (ImGui::Button(IsTuning ? "Autotuning..." : "Autotune") && !IsTuning) { StartAutotune(); }
+        if (ActiveGenerator) {
+            RenderSettings settings = SettingsFor(ActiveGenerator->GetName());
+            ImGui::SameLine();
+            ImGui::TextDisabled("threads %d, tile rows %d, %s", settings.ResolveThreads(), settings.TileRows, KernelVariantName(settings.Variant));
+        }
+
         if (ActiveGenerator) {
             if (ImGui::Button("Generate Frames")) {
                 GenerateFramesMultiThreaded();
             }
+            ImGui::SameLine();
+            if (ImGui::Button("Render Comparison")) {
+                if (CompareJob) CompareJob->Cancel();
+                CompareJob = SubmitJob(JobPriority::Compare);
+                ShowCompare = true;
+            }
+            ImGui::SameLine();
+            ImGui::Checkbox("Show Comparison", &ShowCompare);
+
+            if (PreviewJob) {
+                ImGui::ProgressBar(PreviewJob->Progress(), ImVec2(-1, 0), "Generating");
+                if (PreviewJob->UniqueFrames() < PreviewJob->FrameCount()) {
+                    ImGui::TextDisabled("repeats every %d frames, %d of %d rendered", PreviewJob->UniqueFrames(), PreviewJob->UniqueFrames(), PreviewJob->FrameCount());
+                }
+            }
 
             ImGui::SeparatorText("Parameters");
             static bool changed = false;
             changed |= ActiveGenerator->DrawImGui();
+            changed |= DrawSweepUI();
+            changed |= DrawMaskUI();
 
             if (changed && ImGui::IsMouseReleased(0)) {
                 GenerateFramesMultiThreaded();
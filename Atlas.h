@@ -0,0 +1,204 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <numeric>
+#include "DrawFunctions.h"
+
+// Sprite atlas building: frames trimmed to their alpha bounds, packed with MaxRects into
+// power-of-two pages. Most of a frame is transparent (a = col, and everything off the ring in
+// circular mode), so the trimmed sprites are a fraction of a fixed grid of whole frames.
+namespace Atlas {
+
+    struct Rect {
+        int X = 0, Y = 0, Width = 0, Height = 0;
+
+        bool Empty() const { return Width <= 0 || Height <= 0; }
+        bool Contains(const Rect& r) const { return r.X >= X && r.Y >= Y && r.X + r.Width <= X + Width && r.Y + r.Height <= Y + Height; }
+        bool Overlaps(const Rect& r) const { return r.X < X + Width && X < r.X + r.Width && r.Y < Y + Height && Y < r.Y + r.Height; }
+    };
+
+    // OR of the alpha bytes of n pixels, two pixels per 64-bit word: no branches, so the
+    // compiler vectorizes it
+    inline uint64_t AlphaAny(const uint8_t* pixels, int n) {
+        const uint64_t Mask = 0xFF000000FF000000ull;
+        uint64_t any = 0;
+        int i = 0;
+        for (; i + 2 <= n; i += 2) {
+            uint64_t v;
+            std::memcpy(&v, pixels + (size_t)i * 4, 8);
+            any |= v & Mask;
+        }
+        if (i < n) any |= pixels[(size_t)i * 4 + 3];
+        return any;
+    }
+
+    // The smallest rectangle holding every pixel with alpha; empty for a clear frame. Rows
+    // come from whole-row scans, columns from scans inwards only as far as the bounds so far.
+    inline Rect AlphaBounds(const Draw::ImageView& image) {
+        int y0 = 0, y1 = image.Height;
+        while (y0 < y1 && !AlphaAny(image.Row(y0), image.Width)) y0++;
+        while (y1 > y0 && !AlphaAny(image.Row(y1 - 1), image.Width)) y1--;
+        if (y0 == y1) return {};
+
+        int x0 = image.Width, x1 = 0;
+        for (int y = y0; y < y1; y++) {
+            const uint8_t* row = image.Row(y);
+            if (x0 > 0 && AlphaAny(row, x0)) {
+                int x = 0;
+                while (!row[(size_t)x * 4 + 3]) x++;
+                x0 = x;
+            }
+            if (x1 < image.Width && AlphaAny(row + (size_t)x1 * 4, image.Width - x1)) {
+                int x = image.Width;
+                while (!row[(size_t)(x - 1) * 4 + 3]) x--;
+                x1 = x;
+            }
+        }
+        return { x0, y0, x1 - x0, y1 - y0 };
+    }
+
+    // MaxRects with the best short side fit: the free space is kept as every maximal free
+    // rectangle, overlapping, and a sprite goes where it leaves the smallest leftover side.
+    class MaxRectsBin {
+    public:
+        MaxRectsBin(int width, int height) : Free{ { 0, 0, width, height } } {}
+
+        bool Insert(int width, int height, int& x, int& y) {
+            int best = -1, bestShort = INT32_MAX, bestLong = INT32_MAX;
+            for (int i = 0; i < (int)Free.size(); i++) {
+                const Rect& f = Free[i];
+                if (f.Width < width || f.Height < height) continue;
+                int dw = f.Width - width, dh = f.Height - height;
+                int shortSide = std::min(dw, dh), longSide = std::max(dw, dh);
+                if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+                    best = i;
+                    bestShort = shortSide;
+                    bestLong = longSide;
+                }
+            }
+            if (best < 0) return false;
+
+            Rect placed = { Free[best].X, Free[best].Y, width, height };
+            std::vector<Rect> next;
+            for (const Rect& f : Free) {
+                if (!f.Overlaps(placed)) { next.push_back(f); continue; }
+                // the up to four maximal pieces of f around the placed rectangle
+                if (placed.X > f.X) next.push_back({ f.X, f.Y, placed.X - f.X, f.Height });
+                if (placed.X + placed.Width < f.X + f.Width) next.push_back({ placed.X + placed.Width, f.Y, f.X + f.Width - placed.X - placed.Width, f.Height });
+                if (placed.Y > f.Y) next.push_back({ f.X, f.Y, f.Width, placed.Y - f.Y });
+                if (placed.Y + placed.Height < f.Y + f.Height) next.push_back({ f.X, placed.Y + placed.Height, f.Width, f.Y + f.Height - placed.Y - placed.Height });
+            }
+            // drop the ones inside another
+            Free.clear();
+            for (size_t i = 0; i < next.size(); i++) {
+                bool inside = false;
+                for (size_t j = 0; j < next.size() && !inside; j++) {
+                    inside = i != j && next[j].Contains(next[i]) && (!next[i].Contains(next[j]) || j < i);
+                }
+                if (!inside) Free.push_back(next[i]);
+            }
+            x = placed.X;
+            y = placed.Y;
+            return true;
+        }
+
+    private:
+        std::vector<Rect> Free;
+    };
+
+    struct Page { int Width, Height; };
+    struct Placement { int Page = -1, X = 0, Y = 0; };
+
+    inline int NextPowerOfTwo(int v) {
+        int p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    // Packs sprites, largest side first, into as few pages as it can. Each page is the
+    // smallest power-of-two size, square or twice as wide, that takes everything left; when
+    // none up to maxPage does, a maxPage page takes what fits. padding separates sprites.
+    inline std::vector<Page> Pack(const std::vector<Rect>& sprites, int maxPage, int padding, std::vector<Placement>& placements) {
+        placements.assign(sprites.size(), {});
+        std::vector<int> remaining;
+        int largest = 1;
+        for (int i = 0; i < (int)sprites.size(); i++) {
+            if (sprites[i].Empty()) continue;
+            remaining.push_back(i);
+            largest = std::max({ largest, sprites[i].Width, sprites[i].Height });
+        }
+        maxPage = std::max(maxPage, NextPowerOfTwo(largest));
+        std::stable_sort(remaining.begin(), remaining.end(), [&](int a, int b) {
+            return std::max(sprites[a].Width, sprites[a].Height) > std::max(sprites[b].Width, sprites[b].Height);
+        });
+
+        // padding goes right and below each sprite, the page is as much larger so the last
+        // row and column need none
+        auto tryPage = [&](int width, int height, bool all, std::vector<int>& left) {
+            MaxRectsBin bin(width + padding, height + padding);
+            std::vector<Placement> trial(sprites.size());
+            left.clear();
+            for (int i : remaining) {
+                Placement& p = trial[i];
+                if (bin.Insert(sprites[i].Width + padding, sprites[i].Height + padding, p.X, p.Y)) continue;
+                if (all) return false;
+                left.push_back(i);
+            }
+            if (left.size() == remaining.size()) return false;
+            int page = 0;
+            for (const Placement& p : placements) page = std::max(page, p.Page + 1);
+            for (int i : remaining) {
+                if (std::find(left.begin(), left.end(), i) != left.end()) continue;
+                placements[i] = { page, trial[i].X, trial[i].Y };
+            }
+            return true;
+        };
+
+        std::vector<Page> pages;
+        std::vector<int> left;
+        while (!remaining.empty()) {
+            uint64_t area = 0;
+            for (int i : remaining) area += (uint64_t)(sprites[i].Width + padding) * (sprites[i].Height + padding);
+
+            bool done = false;
+            for (int height = 1; height <= maxPage && !done; height <<= 1) {
+                for (int width = height; width <= std::min(2 * height, maxPage) && !done; width <<= 1) {
+                    if ((uint64_t)(width + padding) * (height + padding) < area) continue;
+                    if (tryPage(width, height, true, left)) { pages.push_back({ width, height }); done = true; }
+                }
+            }
+            if (done) break;
+            if (!tryPage(maxPage, maxPage, false, left)) break;
+            pages.push_back({ maxPage, maxPage });
+            remaining = left;
+        }
+        return pages;
+    }
+
+    // One line per frame: the page and rectangle of its sprite, and where the sprite's top
+    // left sits in the untrimmed frame. Identical frames share a rectangle; clear frames have
+    // an empty one. Page names come from the export name and are escaped like trace names.
+    inline std::string Metadata(int frameSize, const std::vector<std::string>& pageFiles,
+        const std::vector<Placement>& placements, const std::vector<Rect>& sprites,
+        const std::vector<int>& frameSprites, const std::vector<Rect>& frameBounds)
+    {
+        std::string out = "{\n  \"frameSize\": [" + std::to_string(frameSize) + ", " + std::to_string(frameSize) + "],\n  \"pages\": [";
+        for (size_t p = 0; p < pageFiles.size(); p++) out += (p ? ", \"" : "\"") + Profiler::JsonEscape(pageFiles[p]) + "\"";
+        out += "],\n  \"frames\": [\n";
+        for (size_t f = 0; f < frameSprites.size(); f++) {
+            const Rect& sprite = sprites[frameSprites[f]];
+            const Placement& p = placements[frameSprites[f]];
+            char line[160];
+            std::snprintf(line, sizeof(line), "    { \"page\": %d, \"rect\": [%d, %d, %d, %d], \"offset\": [%d, %d] }%s\n",
+                sprite.Empty() ? -1 : p.Page, p.X, p.Y, sprite.Width, sprite.Height, frameBounds[f].X, frameBounds[f].Y,
+                f + 1 < frameSprites.size() ? "," : "");
+            out += line;
+        }
+        out += "  ]\n}\n";
+        return out;
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include "RenderJob.h"
+
+// Per-machine tuning profile: the fastest RenderSettings found for each generator.
+// Stored under %LOCALAPPDATA%\SpriteGen so every machine keeps its own winners.
+class TuningProfile {
+public:
+    std::string Machine;
+    int Cores = 0;
+    std::map<std::string, RenderSettings> Entries;
+
+    static std::string MachineName() {
+        const char* name = std::getenv("COMPUTERNAME");
+        return name ? name : "unknown";
+    }
+    static int MachineCores() { return (int)std::thread::hardware_concurrency(); }
+
+    static std::filesystem::path DefaultPath() {
+        const char* base = std::getenv("LOCALAPPDATA");
+        std::filesystem::path dir = base ? std::filesystem::path(base) / "SpriteGen" : std::filesystem::path(".");
+        return dir / "autotune.ini";
+    }
+
+    // a profile tuned on different hardware doesn't count
+    bool MatchesThisMachine() const { return Machine == MachineName() && Cores == MachineCores(); }
+
+    bool Find(const std::string& generator, RenderSettings& out) const {
+        auto it = Entries.find(generator);
+        if (it == Entries.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    bool Load(const std::filesystem::path& path = DefaultPath()) {
+        std::ifstream in(path);
+        if (!in) return false;
+
+        Entries.clear();
+        std::string line;
+        std::string section;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            if (line.front() == '[' && line.back() == ']') {
+                section = line.substr(1, line.size() - 2);
+                Entries[section];
+                continue;
+            }
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) continue;
+            std::string key = line.substr(0, eq);
+            std::string value = line.substr(eq + 1);
+
+            if (section.empty()) {
+                if (key == "machine") Machine = value;
+                else if (key == "cores") Cores = std::atoi(value.c_str());
+                continue;
+            }
+            RenderSettings& entry = Entries[section];
+            if (key == "threads") entry.Threads = std::atoi(value.c_str());
+            else if (key == "tile_rows") entry.TileRows = std::atoi(value.c_str());
+            else if (key == "variant") entry.Variant = (value == "simd") ? KernelVariant::Simd : KernelVariant::Scalar;
+        }
+        return true;
+    }
+
+    bool Save(const std::filesystem::path& path = DefaultPath()) const {
+        std::error_code ec;
+        if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) return false;
+
+        out << "# SpriteGen autotune profile\n";
+        out << "machine=" << Machine << "\n";
+        out << "cores=" << Cores << "\n";
+        for (auto& [name, entry] : Entries) {
+            out << "\n[" << name << "]\n";
+            out << "threads=" << entry.Threads << "\n";
+            out << "tile_rows=" << entry.TileRows << "\n";
+            out << "variant=" << KernelVariantName(entry.Variant) << "\n";
+        }
+        return true;
+    }
+};
+
+// Short benchmark over thread counts, tile sizes and kernel variants.
+// Searches one axis at a time (variant, then tiles, then threads) instead of the full
+// cross product so a run stays around a second even on many-core machines.
+class Autotuner {
+public:
+    using GeneratorFactory = std::function<std::unique_ptr<IFrameGenerator>()>;
+
+    explicit Autotuner(RenderScheduler& scheduler) : scheduler(scheduler) {}
+
+    int Size = 256;
+    int Frames = 16;
+    int Repeats = 2;
+
+    RenderSettings Tune(IFrameGenerator& generator) {
+        std::vector<uint8_t> storage((size_t)Size * Size * 4 * Frames);
+        std::vector<Draw::ImageView> targets;
+        for (int i = 0; i < Frames; i++) {
+            targets.push_back({ storage.data() + (size_t)i * Size * Size * 4, Size, Size, 4 });
+        }
+        std::vector<double> times = Render::FrameTimes(Frames, generator.IsLooping());
+
+        auto measure = [&](RenderSettings settings) {
+            // every frame rendered, a period of one frame would tell the settings nothing
+            settings.Periodic = false;
+            double best = 1e30;
+            for (int r = 0; r < Repeats; r++) {
+                auto start = std::chrono::steady_clock::now();
+                Render::RenderFrames(scheduler, generator, targets, times, settings);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                best = std::min(best, ms);
+            }
+            return best;
+        };
+
+        int hw = scheduler.ThreadCount();
+        RenderSettings best = { hw, 0, KernelVariant::Scalar };
+        double bestTime = measure(best);
+
+        auto tryCandidate = [&](RenderSettings candidate) {
+            double ms = measure(candidate);
+            if (ms < bestTime) { bestTime = ms; best = candidate; }
+        };
+
+        if (generator.HasSimdKernel()) { tryCandidate({ hw, 0, KernelVariant::Simd }); }
+
+        RenderSettings base = best;
+        for (int rows : { 128, 32, 8 }) {
+            if (rows >= Size) continue;
+            tryCandidate({ base.Threads, rows, base.Variant });
+        }
+
+        base = best;
+        for (int threads = 1; threads < hw; threads *= 2) {
+            tryCandidate({ threads, base.TileRows, base.Variant });
+        }
+
+        DXE_INFO("Autotune ", generator.GetName(), ": threads=", best.Threads, " tile_rows=", best.TileRows,
+            " variant=", KernelVariantName(best.Variant), " (", bestTime, " ms)");
+        return best;
+    }
+
+    TuningProfile Run(const std::unordered_map<std::string, GeneratorFactory>& generators) {
+        PROFILE_BEGIN_CAPTURE("Autotune");
+        TuningProfile profile;
+        profile.Machine = TuningProfile::MachineName();
+        profile.Cores = TuningProfile::MachineCores();
+        for (auto& [name, factory] : generators) {
+            std::unique_ptr<IFrameGenerator> generator = factory();
+            profile.Entries[name] = Tune(*generator);
+        }
+        return profile;
+    }
+
+private:
+    RenderScheduler& scheduler;
+};
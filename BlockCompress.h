@@ -0,0 +1,440 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "DrawFunctions.h"
+
+// GPU block compression for export. BC4 keeps the first channel, which is all a generator's
+// mask needs; BC1 keeps the color and drops alpha; BC3 is BC1 color plus a BC4 style alpha
+// block. Images are cut into 4x4 blocks, edge blocks repeat the last row and column.
+namespace Bc {
+
+    enum class Format { BC1, BC3, BC4 };
+    // Fast fits the endpoints to the block's range and places indices arithmetically. High
+    // searches endpoints, picks every index by error and refits the endpoints to the indices.
+    enum class Quality { Fast, High };
+
+    inline const char* FormatName(Format format) {
+        switch (format) {
+        case Format::BC1: return "BC1";
+        case Format::BC3: return "BC3";
+        default: return "BC4";
+        }
+    }
+    inline int BlockBytes(Format format) { return format == Format::BC3 ? 16 : 8; }
+    inline size_t ImageBytes(int width, int height, Format format) {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+    }
+
+    // 16 pixels, RGBA, row by row
+    inline void FetchBlock(const Draw::ImageView& image, int bx, int by, uint8_t* block) {
+        for (int y = 0; y < 4; y++) {
+            const uint8_t* row = image.Row(std::min(by * 4 + y, image.Height - 1));
+            for (int x = 0; x < 4; x++) {
+                const uint8_t* pixel = row + (size_t)std::min(bx * 4 + x, image.Width - 1) * image.Channels;
+                std::memcpy(block + (y * 4 + x) * 4, pixel, 4);
+            }
+        }
+    }
+
+    // ---- one channel: BC4, and the alpha half of BC3 ----
+
+    // the 8 values endpoints e0, e1 decode to: e0 > e1 interpolates 6, otherwise 4 plus 0 and 255
+    inline void Palette1(int e0, int e1, int* p) {
+        p[0] = e0;
+        p[1] = e1;
+        if (e0 > e1) {
+            for (int k = 2; k < 8; k++) p[k] = ((8 - k) * e0 + (k - 1) * e1 + 3) / 7;
+        }
+        else {
+            for (int k = 2; k < 6; k++) p[k] = ((6 - k) * e0 + (k - 1) * e1 + 2) / 5;
+            p[6] = 0;
+            p[7] = 255;
+        }
+    }
+
+    // nearest palette entry per value, returns the summed squared error
+    inline int FitIndices1(const uint8_t* v, const int* p, uint8_t* index) {
+        int total = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = INT_MAX;
+            for (int k = 0; k < 8; k++) {
+                int d = v[i] - p[k];
+                if (d * d < bestError) { bestError = d * d; best = k; }
+            }
+            index[i] = (uint8_t)best;
+            total += bestError;
+        }
+        return total;
+    }
+
+    inline void Pack1(int e0, int e1, const uint8_t* index, uint8_t* out) {
+        out[0] = (uint8_t)e0;
+        out[1] = (uint8_t)e1;
+        uint64_t bits = 0;
+        for (int i = 0; i < 16; i++) bits |= (uint64_t)index[i] << (3 * i);
+        for (int b = 0; b < 6; b++) out[2 + b] = (uint8_t)(bits >> (8 * b));
+    }
+
+    // one channel of a fetched block (stride 4) into 8 bytes
+    inline void EncodeChannel(const uint8_t* block, int channel, Quality quality, uint8_t* out) {
+        uint8_t v[16];
+        int lo = 255, hi = 0;
+        for (int i = 0; i < 16; i++) {
+            v[i] = block[i * 4 + channel];
+            lo = std::min(lo, (int)v[i]);
+            hi = std::max(hi, (int)v[i]);
+        }
+        uint8_t index[16];
+        if (lo == hi) {
+            std::memset(index, 0, sizeof(index));
+            Pack1(hi, lo, index, out);
+            return;
+        }
+
+        if (quality == Quality::Fast) {
+            // position on the 8 step ramp from lo to hi; code 0 is hi, 1 is lo, 2..7 run down from hi
+            int range = hi - lo;
+            for (int i = 0; i < 16; i++) {
+                int step = ((v[i] - lo) * 14 + range) / (2 * range);
+                index[i] = (uint8_t)(step == 7 ? 0 : step == 0 ? 1 : 8 - step);
+            }
+            Pack1(hi, lo, index, out);
+            return;
+        }
+
+        // the 8 value ramp with the ends pulled in a little, and the 6 value ramp over the
+        // values that 0 and 255 don't already cover
+        int p[8];
+        uint8_t trial[16];
+        int bestError = INT_MAX, best0 = hi, best1 = lo;
+        auto consider = [&](int e0, int e1) {
+            Palette1(e0, e1, p);
+            int error = FitIndices1(v, p, trial);
+            if (error < bestError) {
+                bestError = error;
+                best0 = e0;
+                best1 = e1;
+                std::memcpy(index, trial, sizeof(index));
+            }
+        };
+        int inset = std::min(3, (hi - lo) / 8);
+        for (int a = 0; a <= inset; a++) {
+            for (int b = 0; b <= inset; b++) { consider(hi - a, lo + b); }
+        }
+        int lo6 = 255, hi6 = 0;
+        for (int i = 0; i < 16; i++) {
+            if (v[i] == 0 || v[i] == 255) continue;
+            lo6 = std::min(lo6, (int)v[i]);
+            hi6 = std::max(hi6, (int)v[i]);
+        }
+        if (lo6 <= hi6) consider(lo6, hi6);
+        Pack1(best0, best1, index, out);
+    }
+
+    // ---- color: BC1, and the color half of BC3 ----
+
+    inline uint16_t To565(float r, float g, float b) {
+        auto q = [](float v, int max) { return (int)std::clamp(std::lround(v * max / 255.f), 0l, (long)max); };
+        return (uint16_t)((q(r, 31) << 11) | (q(g, 63) << 5) | q(b, 31));
+    }
+    inline void From565(uint16_t c, int* rgb) {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // four color mode palette, c0 > c1
+    inline void Palette4(uint16_t c0, uint16_t c1, int p[4][3]) {
+        From565(c0, p[0]);
+        From565(c1, p[1]);
+        for (int c = 0; c < 3; c++) {
+            p[2][c] = (2 * p[0][c] + p[1][c] + 1) / 3;
+            p[3][c] = (p[0][c] + 2 * p[1][c] + 1) / 3;
+        }
+    }
+
+    inline int FitIndices4(const uint8_t* block, const int p[4][3], uint8_t* index) {
+        int total = 0;
+        for (int i = 0; i < 16; i++) {
+            const uint8_t* px = block + i * 4;
+            int best = 0, bestError = INT_MAX;
+            for (int k = 0; k < 4; k++) {
+                int dr = px[0] - p[k][0], dg = px[1] - p[k][1], db = px[2] - p[k][2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError) { bestError = error; best = k; }
+            }
+            index[i] = (uint8_t)best;
+            total += bestError;
+        }
+        return total;
+    }
+
+    // writes the endpoints in four color order (c0 > c1), swapping indices to match
+    inline void Pack4(uint16_t c0, uint16_t c1, uint8_t* index, uint8_t* out) {
+        if (c0 < c1) {
+            std::swap(c0, c1);
+            for (int i = 0; i < 16; i++) index[i] ^= 1;
+        }
+        else if (c0 == c1) {
+            std::memset(index, 0, 16);
+        }
+        uint32_t bits = 0;
+        for (int i = 0; i < 16; i++) bits |= (uint32_t)index[i] << (2 * i);
+        out[0] = (uint8_t)c0;
+        out[1] = (uint8_t)(c0 >> 8);
+        out[2] = (uint8_t)c1;
+        out[3] = (uint8_t)(c1 >> 8);
+        for (int b = 0; b < 4; b++) out[4 + b] = (uint8_t)(bits >> (8 * b));
+    }
+
+    inline void EncodeColor(const uint8_t* block, Quality quality, uint8_t* out) {
+        // principal axis of the colors by power iteration on their covariance
+        float mean[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 3; c++) mean[c] += block[i * 4 + c];
+        }
+        for (int c = 0; c < 3; c++) mean[c] /= 16.f;
+        float cov[6] = { 0, 0, 0, 0, 0, 0 };
+        for (int i = 0; i < 16; i++) {
+            float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+        float axis[3] = { 1.f, 1.f, 1.f };
+        for (int iteration = 0; iteration < 4; iteration++) {
+            float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+            float length = std::max({ std::fabs(x), std::fabs(y), std::fabs(z) });
+            if (length < 1e-6f) break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        // the extreme colors along the axis are the first endpoints
+        float lo = 1e30f, hi = -1e30f;
+        for (int i = 0; i < 16; i++) {
+            float t = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+        float dot = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        auto at = [&](float t, int c) { return mean[c] + axis[c] * t / dot; };
+        uint16_t c0 = To565(at(hi, 0), at(hi, 1), at(hi, 2));
+        uint16_t c1 = To565(at(lo, 0), at(lo, 1), at(lo, 2));
+
+        uint8_t index[16];
+        int p[4][3];
+        if (quality == Quality::Fast) {
+            // project onto the decoded endpoints; ramp step 3 is c0, 0 is c1
+            Palette4(std::max(c0, c1), std::min(c0, c1), p);
+            float d[3] = { (float)(p[0][0] - p[1][0]), (float)(p[0][1] - p[1][1]), (float)(p[0][2] - p[1][2]) };
+            float dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+            for (int i = 0; i < 16; i++) {
+                float t = dd > 0.f ? ((block[i * 4] - p[1][0]) * d[0] + (block[i * 4 + 1] - p[1][1]) * d[1] + (block[i * 4 + 2] - p[1][2]) * d[2]) / dd : 0.f;
+                int step = std::clamp((int)std::lround(t * 3.f), 0, 3);
+                static constexpr uint8_t code[4] = { 1, 3, 2, 0 };
+                index[i] = code[step];
+            }
+            Pack4(std::max(c0, c1), std::min(c0, c1), index, out);
+            return;
+        }
+
+        // fit indices, then solve the endpoints that best reproduce the colors for those
+        // indices (least squares per channel), while the error keeps dropping
+        uint16_t best0 = std::max(c0, c1), best1 = std::min(c0, c1);
+        Palette4(best0, best1, p);
+        int bestError = FitIndices4(block, p, index);
+        for (int iteration = 0; iteration < 3 && bestError > 0; iteration++) {
+            static constexpr float weight[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+            float a = 0, b = 0, c = 0, x0[3] = { 0, 0, 0 }, x1[3] = { 0, 0, 0 };
+            for (int i = 0; i < 16; i++) {
+                float w = weight[index[i]];
+                a += w * w;
+                b += w * (1 - w);
+                c += (1 - w) * (1 - w);
+                for (int k = 0; k < 3; k++) {
+                    x0[k] += w * block[i * 4 + k];
+                    x1[k] += (1 - w) * block[i * 4 + k];
+                }
+            }
+            float det = a * c - b * b;
+            if (std::fabs(det) < 1e-6f) break;
+            float e0[3], e1[3];
+            for (int k = 0; k < 3; k++) {
+                e0[k] = (c * x0[k] - b * x1[k]) / det;
+                e1[k] = (a * x1[k] - b * x0[k]) / det;
+            }
+            uint16_t n0 = To565(e0[0], e0[1], e0[2]), n1 = To565(e1[0], e1[1], e1[2]);
+            uint16_t t0 = std::max(n0, n1), t1 = std::min(n0, n1);
+            uint8_t trial[16];
+            Palette4(t0, t1, p);
+            int error = FitIndices4(block, p, trial);
+            if (error >= bestError) break;
+            bestError = error;
+            best0 = t0;
+            best1 = t1;
+            std::memcpy(index, trial, sizeof(index));
+        }
+        Pack4(best0, best1, index, out);
+    }
+
+    inline void EncodeBlock(const uint8_t* block, Format format, Quality quality, uint8_t* out) {
+        switch (format) {
+        case Format::BC1: EncodeColor(block, quality, out); break;
+        case Format::BC3: EncodeChannel(block, 3, quality, out); EncodeColor(block, quality, out + 8); break;
+        default: EncodeChannel(block, 0, quality, out); break;
+        }
+    }
+
+    // Runs body over [0, count) in ranges, on whatever threads the caller has to spare, and
+    // returns once every range is done. Serial keeps it all on the calling thread.
+    using RowSplitter = std::function<void(int count, const std::function<void(int, int)>& body)>;
+    inline void Serial(int count, const std::function<void(int, int)>& body) { body(0, count); }
+
+    // one image into out (ImageBytes long), rows of blocks handed to split
+    inline void CompressImage(const Draw::ImageView& image, Format format, Quality quality, uint8_t* out, const RowSplitter& split = Serial) {
+        int blocksX = (image.Width + 3) / 4;
+        int blocksY = (image.Height + 3) / 4;
+        int bytes = BlockBytes(format);
+        split(blocksY, [&](int y0, int y1) {
+            uint8_t block[64];
+            for (int by = y0; by < y1; by++) {
+                for (int bx = 0; bx < blocksX; bx++) {
+                    FetchBlock(image, bx, by, block);
+                    EncodeBlock(block, format, quality, out + ((size_t)by * blocksX + bx) * bytes);
+                }
+            }
+        });
+    }
+
+    struct Level {
+        int Width, Height;
+        std::vector<uint8_t> Blocks;
+    };
+
+    // the image and, with mips, every halving of it down to 1x1, each box filtered from the one before
+    inline std::vector<Level> Compress(const Draw::ImageView& image, Format format, Quality quality, bool mips, const RowSplitter& split = Serial) {
+        std::vector<Level> levels;
+        std::vector<uint8_t> current, next;
+        Draw::ImageView view = image;
+        while (true) {
+            Level level = { view.Width, view.Height, std::vector<uint8_t>(ImageBytes(view.Width, view.Height, format)) };
+            CompressImage(view, format, quality, level.Blocks.data(), split);
+            levels.push_back(std::move(level));
+            if (!mips || (view.Width == 1 && view.Height == 1)) break;
+
+            int width = std::max(1, view.Width / 2), height = std::max(1, view.Height / 2);
+            next.resize((size_t)width * height * 4);
+            Draw::ImageView half = { next.data(), width, height, 4 };
+            Draw::Downsample(view, half);
+            std::swap(current, next);
+            view = { current.data(), width, height, 4 };
+        }
+        return levels;
+    }
+
+    // ---- containers ----
+
+    inline void PutLittleEndian(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    // legacy DDS header with a FourCC, which every loader reads
+    inline std::vector<uint8_t> WriteDds(const std::vector<Level>& levels, Format format) {
+        static constexpr char fourCC[3][5] = { "DXT1", "DXT5", "BC4U" };
+        const uint32_t Caps = 0x1, Height = 0x2, Width = 0x4, PixelFormat = 0x1000, MipCount = 0x20000, LinearSize = 0x80000;
+        bool mipped = levels.size() > 1;
+
+        std::vector<uint8_t> out = { 'D', 'D', 'S', ' ' };
+        PutLittleEndian(out, 124, 4);
+        PutLittleEndian(out, Caps | Height | Width | PixelFormat | LinearSize | (mipped ? MipCount : 0), 4);
+        PutLittleEndian(out, levels[0].Height, 4);
+        PutLittleEndian(out, levels[0].Width, 4);
+        PutLittleEndian(out, levels[0].Blocks.size(), 4);
+        PutLittleEndian(out, 0, 4);                     // depth
+        PutLittleEndian(out, levels.size(), 4);
+        out.resize(out.size() + 11 * 4, 0);             // reserved
+        PutLittleEndian(out, 32, 4);                    // pixel format
+        PutLittleEndian(out, 0x4, 4);                   // FourCC
+        out.insert(out.end(), fourCC[(int)format], fourCC[(int)format] + 4);
+        out.resize(out.size() + 5 * 4, 0);              // bit count and masks
+        PutLittleEndian(out, 0x1000 | (mipped ? 0x8 | 0x400000 : 0), 4);  // texture, complex, mipmap
+        out.resize(out.size() + 4 * 4, 0);              // caps2..4, reserved
+
+        for (const Level& level : levels) out.insert(out.end(), level.Blocks.begin(), level.Blocks.end());
+        return out;
+    }
+
+    // KTX 2.0: header, level index, a basic data format descriptor, then the levels, smallest first
+    inline std::vector<uint8_t> WriteKtx2(const std::vector<Level>& levels, Format format) {
+        static constexpr uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+        static constexpr uint32_t vkFormat[3] = { 131, 137, 139 };     // BC1_RGB, BC3, BC4 UNORM blocks
+        static constexpr uint8_t colorModel[3] = { 128, 130, 131 };    // KHR_DF_MODEL_BC1A, BC3, BC4
+        int levelCount = (int)levels.size();
+        int blockBytes = BlockBytes(format);
+
+        // descriptor: one 64 bit sample per block half, BC3's alpha first
+        std::vector<uint8_t> dfd;
+        int samples = format == Format::BC3 ? 2 : 1;
+        uint32_t blockSize = 24 + 16 * samples;
+        PutLittleEndian(dfd, 4 + blockSize, 4);
+        PutLittleEndian(dfd, 0, 4);                                     // Khronos, basic descriptor
+        PutLittleEndian(dfd, 2 | (blockSize << 16), 4);                 // version 2
+        PutLittleEndian(dfd, colorModel[(int)format] | (1 << 8) | (1 << 16), 4);   // BT.709, linear, straight alpha
+        PutLittleEndian(dfd, 3 | (3 << 8), 4);                          // 4x4 texel blocks
+        PutLittleEndian(dfd, blockBytes, 4);
+        PutLittleEndian(dfd, 0, 4);
+        for (int s = 0; s < samples; s++) {
+            uint32_t channel = (format == Format::BC3 && s == 0) ? 15 : 0;    // BC3 alpha, else color or data
+            PutLittleEndian(dfd, (uint32_t)(64 * s) | (63 << 16) | (channel << 24), 4);
+            PutLittleEndian(dfd, 0, 4);
+            PutLittleEndian(dfd, 0, 4);
+            PutLittleEndian(dfd, 0xFFFFFFFFu, 4);
+        }
+
+        size_t indexEnd = 80 + 24 * (size_t)levelCount;
+        size_t dataStart = indexEnd + dfd.size();
+        // each level starts on a multiple of the block size
+        std::vector<size_t> offsets(levelCount);
+        size_t offset = dataStart;
+        for (int l = levelCount - 1; l >= 0; l--) {
+            offset = (offset + blockBytes - 1) / blockBytes * blockBytes;
+            offsets[l] = offset;
+            offset += levels[l].Blocks.size();
+        }
+
+        std::vector<uint8_t> out(identifier, identifier + 12);
+        PutLittleEndian(out, vkFormat[(int)format], 4);
+        PutLittleEndian(out, 1, 4);                     // type size
+        PutLittleEndian(out, levels[0].Width, 4);
+        PutLittleEndian(out, levels[0].Height, 4);
+        PutLittleEndian(out, 0, 4);                     // depth
+        PutLittleEndian(out, 0, 4);                     // layers
+        PutLittleEndian(out, 1, 4);                     // faces
+        PutLittleEndian(out, levelCount, 4);
+        PutLittleEndian(out, 0, 4);                     // no supercompression
+        PutLittleEndian(out, indexEnd, 4);
+        PutLittleEndian(out, dfd.size(), 4);
+        PutLittleEndian(out, 0, 4);                     // no key/value data
+        PutLittleEndian(out, 0, 4);
+        PutLittleEndian(out, 0, 8);                     // no supercompression global data
+        PutLittleEndian(out, 0, 8);
+        for (int l = 0; l < levelCount; l++) {
+            PutLittleEndian(out, offsets[l], 8);
+            PutLittleEndian(out, levels[l].Blocks.size(), 8);
+            PutLittleEndian(out, levels[l].Blocks.size(), 8);
+        }
+        out.insert(out.end(), dfd.begin(), dfd.end());
+        for (int l = levelCount - 1; l >= 0; l--) {
+            out.resize(offsets[l], 0);
+            out.insert(out.end(), levels[l].Blocks.begin(), levels[l].Blocks.end());
+        }
+        return out;
+    }
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include "FrameRenderer.h"
+#include "Png.h"
+
+struct CanvasSettings {
+    int Width = 16384;
+    int Height = 2048;
+    int BandRows = 64;
+    double Time = 0.0;
+    RenderSettings Render;      // threads and kernel variant
+    int InFlight = 0;           // bands rendered ahead of the writer, 0: threads + 2
+
+    int ResolveInFlight() const { return InFlight > 0 ? InFlight : Render.ResolveThreads() + 2; }
+};
+
+// One still far larger than a frame, rendered in horizontal bands and streamed into a PNG as
+// it goes, for images no texture or whole frame in RAM could hold: panoramic beam strips,
+// background decals. Each worker renders a band plus the row above it, so the band's row
+// filters and its deflate piece need nothing from its neighbours, and the writer appends the
+// pieces in order as one zlib stream. Workers stay at most InFlight bands ahead of the writer,
+// so memory is set by the band height and the thread count, never by the canvas size; row
+// offsets are 64-bit, a 100k x 100k canvas is 40 GB of pixels.
+class CanvasRender {
+public:
+    struct Stats {
+        int Bands = 0;
+        int Rendered = 0;
+        int Written = 0;
+        uint64_t BytesWritten = 0;
+        uint64_t PeakBytes = 0;     // band buffers and encoded pieces held at once
+        double ElapsedSeconds = 0;
+    };
+
+    // PNG chunk lengths are 31 bits, a band's piece is split well below that
+    static constexpr size_t MaxChunkBytes = 64u << 20;
+
+    // whole-frame passes need the whole frame, those generators can't be banded
+    static bool CanRender(const IFrameGenerator& generator) { return !generator.HasFinishPass(); }
+
+    CanvasRender(const IFrameGenerator& generator, CanvasSettings settings, std::filesystem::path path)
+        : Generator(generator.Clone()), Settings(settings), Path(std::move(path)), Start(std::chrono::steady_clock::now())
+    {
+        Settings.BandRows = std::clamp(Settings.BandRows, 1, Settings.Height);
+        BandCount = (Settings.Height + Settings.BandRows - 1) / Settings.BandRows;
+        InFlight = Settings.ResolveInFlight();
+        Variant = Generator->HasSimdKernel() ? Settings.Render.Variant : KernelVariant::Scalar;
+        stats.Bands = BandCount;
+        // per worker: the band with its row above, and the filtered copy
+        WorkingBytes = (uint64_t)Settings.Render.ResolveThreads() * (Settings.BandRows + 1) * ((uint64_t)Settings.Width * 4 + 1) * 2;
+
+        std::error_code ec;
+        std::filesystem::create_directories(Path.parent_path(), ec);
+        for (int i = 0; i < Settings.Render.ResolveThreads(); i++) { Workers.emplace_back(&CanvasRender::RenderLoop, this, i); }
+        Writer = std::thread(&CanvasRender::WriteLoop, this);
+    }
+
+    ~CanvasRender() {
+        Cancel();
+        for (auto& worker : Workers) worker.join();
+        if (Writer.joinable()) Writer.join();
+    }
+
+    void Cancel() {
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            Cancelled = true;
+        }
+        Changed.notify_all();
+    }
+
+    const std::filesystem::path& FilePath() const { return Path; }
+    bool IsDone() const { return Done.load(); }
+    bool Failed() const { return HasFailed.load(); }
+    float Progress() const {
+        std::lock_guard<std::mutex> lock(Lock);
+        return BandCount ? (float)stats.Written / BandCount : 1.f;
+    }
+    Stats GetStats() const {
+        std::lock_guard<std::mutex> lock(Lock);
+        Stats s = stats;
+        s.ElapsedSeconds = std::chrono::duration<double>((Done ? Finish : std::chrono::steady_clock::now()) - Start).count();
+        return s;
+    }
+
+private:
+    struct Piece {
+        std::vector<uint8_t> Bytes;     // IDAT chunks
+        uint32_t Adler = 1;             // of the filtered bytes, for the stream trailer
+        size_t RawSize = 0;
+    };
+
+    void RenderLoop(int index) {
+        PROFILE_THREAD_NAME("Canvas " + std::to_string(index));
+        std::vector<uint8_t> pixels, filtered;
+        const int width = Settings.Width;
+        const size_t rowBytes = (size_t)width * 4;
+        while (true) {
+            int band;
+            {
+                std::unique_lock<std::mutex> lock(Lock);
+                Changed.wait(lock, [&]() { return Cancelled || NextBand == BandCount || NextBand - stats.Written < InFlight; });
+                if (Cancelled || NextBand == BandCount) return;
+                band = NextBand++;
+            }
+
+            PROFILE_SCOPE_FRAME("Canvas Band", band);
+            int y0 = band * Settings.BandRows;
+            int y1 = std::min(y0 + Settings.BandRows, Settings.Height);
+            int above = band > 0 ? 1 : 0;
+            pixels.resize((size_t)(y1 - y0 + above) * rowBytes);
+            Draw::ImageView view = { pixels.data(), width, Settings.Height, 4, 0, y0 - above };
+            Generator->GenerateTile(view, Settings.Time, y0 - above, y1, Variant);
+
+            filtered.clear();
+            filtered.reserve((size_t)(y1 - y0) * (rowBytes + 1));
+            Png::FilterRows(view, y0, y1, filtered);
+            Piece piece;
+            piece.Adler = Png::Adler32(filtered.data(), filtered.size());
+            piece.RawSize = filtered.size();
+            std::vector<uint8_t> stream;
+            if (band == 0) stream.assign(Png::ZlibHeader, Png::ZlibHeader + 2);
+            Png::Deflate(filtered.data(), filtered.size(), band == BandCount - 1, stream);
+            for (size_t at = 0; at < stream.size(); at += MaxChunkBytes) {
+                Png::WriteChunk(piece.Bytes, "IDAT", stream.data() + at, std::min(MaxChunkBytes, stream.size() - at));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(Lock);
+                Held += piece.Bytes.size();
+                stats.PeakBytes = std::max(stats.PeakBytes, Held + WorkingBytes);
+                stats.Rendered++;
+                ToWrite[band] = std::move(piece);
+            }
+            Changed.notify_all();
+        }
+    }
+
+    void WriteLoop() {
+        PROFILE_THREAD_NAME("Canvas Writer");
+        std::ofstream out(Path, std::ios::binary);
+        std::vector<uint8_t> header = Png::FileHeader(Settings.Width, Settings.Height);
+        out.write((const char*)header.data(), header.size());
+        if (!out) Fail();
+
+        uint32_t adler = 1;
+        for (int band = 0; band < BandCount; band++) {
+            Piece piece;
+            {
+                std::unique_lock<std::mutex> lock(Lock);
+                Changed.wait(lock, [&]() { return Cancelled || ToWrite.count(band); });
+                if (Cancelled) break;
+                piece = std::move(ToWrite[band]);
+                ToWrite.erase(band);
+            }
+
+            PROFILE_SCOPE_FRAME("Write Band", band);
+            adler = band == 0 ? piece.Adler : Png::Adler32Combine(adler, piece.Adler, piece.RawSize);
+            out.write((const char*)piece.Bytes.data(), piece.Bytes.size());
+            if (band == BandCount - 1) {
+                std::vector<uint8_t> trailer, tail;
+                Png::PutBigEndian(trailer, adler);
+                Png::WriteChunk(tail, "IDAT", trailer.data(), trailer.size());
+                Png::WriteEnd(tail);
+                out.write((const char*)tail.data(), tail.size());
+                out.flush();
+            }
+            if (!out) Fail();
+
+            {
+                std::lock_guard<std::mutex> lock(Lock);
+                Held -= piece.Bytes.size();
+                stats.Written++;
+                stats.BytesWritten += piece.Bytes.size();
+            }
+            Changed.notify_all();
+        }
+
+        // a canvas that didn't finish isn't left behind as a broken PNG
+        out.close();
+        if (IsCancelledOrFailed()) {
+            std::error_code ec;
+            std::filesystem::remove(Path, ec);
+        }
+        Finish = std::chrono::steady_clock::now();
+        Done = true;
+    }
+
+    bool IsCancelledOrFailed() const {
+        std::lock_guard<std::mutex> lock(Lock);
+        return Cancelled || stats.Written < BandCount;
+    }
+
+    void Fail() {
+        DXE_LOG("Canvas render failed writing ", Path.string());
+        HasFailed = true;
+        Cancel();
+    }
+
+    std::unique_ptr<IFrameGenerator> Generator;
+    CanvasSettings Settings;
+    const std::filesystem::path Path;
+    int BandCount = 0;
+    int InFlight = 0;
+    KernelVariant Variant = KernelVariant::Scalar;
+    uint64_t WorkingBytes = 0;
+
+    mutable std::mutex Lock;
+    std::condition_variable Changed;
+    bool Cancelled = false;
+    int NextBand = 0;
+    uint64_t Held = 0;                  // encoded bytes waiting for the writer
+    std::map<int, Piece> ToWrite;
+    Stats stats;
+
+    std::vector<std::thread> Workers;
+    std::thread Writer;
+    std::atomic<bool> Done = false;
+    std::atomic<bool> HasFailed = false;
+    std::chrono::steady_clock::time_point Start;
+    std::chrono::steady_clock::time_point Finish;
+};
@@ -0,0 +1,336 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <cstring>
+#include <mutex>
+#include "DrawFunctions.h"
+
+// How a layer lands on the layers below it. Frames are treated as premultiplied, which is
+// what the generators write: the same value in color and alpha.
+enum class BlendMode { Add, Screen, Max, AlphaOver };
+
+inline const char* BlendModeName(BlendMode mode) {
+    switch (mode) {
+    case BlendMode::Screen: return "Screen";
+    case BlendMode::Max: return "Max";
+    case BlendMode::AlphaOver: return "Alpha Over";
+    default: return "Add";
+    }
+}
+
+// Where a layer's frame sits in the composite, in the generators' -1..1 frame units:
+// scaled about the centre, then moved. Axis-aligned, so a band of composite rows
+// always comes from a band of layer rows.
+struct LayerTransform {
+    float OffsetX = 0.f;
+    float OffsetY = 0.f;
+    float Scale = 1.f;
+
+    bool IsIdentity() const { return OffsetX == 0.f && OffsetY == 0.f && Scale == 1.f; }
+    // composite units back to the layer's own
+    float SourceX(float x) const { return (x - OffsetX) / std::max(Scale, 1e-3f); }
+    float SourceY(float y) const { return (y - OffsetY) / std::max(Scale, 1e-3f); }
+};
+
+namespace Draw {
+
+    inline uint8_t MulDiv255(int a, int b) { return (uint8_t)((a * b + 127) / 255); }
+
+    // blends count pixels of src onto dst; opacity 0..256
+    inline void BlendRow(uint8_t* dst, const uint8_t* src, int count, int channels, BlendMode mode, int opacity) {
+        int n = count * channels;
+        switch (mode) {
+        case BlendMode::Add:
+            for (int i = 0; i < n; i++) { dst[i] = (uint8_t)std::min(255, dst[i] + ((src[i] * opacity) >> 8)); }
+            break;
+        case BlendMode::Screen:
+            for (int i = 0; i < n; i++) {
+                int s = (src[i] * opacity) >> 8;
+                dst[i] = (uint8_t)(dst[i] + s - MulDiv255(dst[i], s));
+            }
+            break;
+        case BlendMode::Max:
+            for (int i = 0; i < n; i++) { dst[i] = (uint8_t)std::max<int>(dst[i], (src[i] * opacity) >> 8); }
+            break;
+        case BlendMode::AlphaOver:
+            for (int p = 0; p < count; p++) {
+                const uint8_t* s = src + (size_t)p * channels;
+                uint8_t* d = dst + (size_t)p * channels;
+                int keep = 255 - ((s[channels - 1] * opacity) >> 8);
+                for (int c = 0; c < channels; c++) { d[c] = (uint8_t)(((s[c] * opacity) >> 8) + MulDiv255(d[c], keep)); }
+            }
+            break;
+        }
+    }
+}
+
+// Several generators composited into one frame. Every composite tile is built a few rows at a
+// time: each layer renders the rows it needs into a small band, which is blended into the
+// target straight away, so the layers' intermediate pixels never leave the cache and only the
+// composite is written out. A layer with a whole-frame pass can't be cut into bands: from the
+// first such layer up, each layer's tiles still render on the pool, into a frame buffer of its
+// own, and FinishFrame runs the passes and blends those layers on top.
+class LayerStackGenerator : public IFrameGenerator {
+public:
+    using Factory = std::function<std::unique_ptr<IFrameGenerator>()>;
+    using Factories = std::map<std::string, Factory>;
+
+    static constexpr size_t BandBytes = 64 * 1024;   // per layer band, sized for L2
+
+    struct Layer {
+        std::string Kind;   // the factory it came from
+        std::unique_ptr<IFrameGenerator> Generator;
+        BlendMode Blend = BlendMode::Add;
+        float Opacity = 1.f;
+        LayerTransform Transform;
+        bool Visible = true;
+    };
+
+    explicit LayerStackGenerator(std::shared_ptr<const Factories> factories) : Available(std::move(factories)) {}
+    LayerStackGenerator(const LayerStackGenerator& other) : Available(other.Available) {
+        for (const Layer& layer : other.Layers) {
+            Layers.push_back({ layer.Kind, layer.Generator->Clone(), layer.Blend, layer.Opacity, layer.Transform, layer.Visible });
+        }
+    }
+
+    bool AddLayer(const std::string& kind, BlendMode blend = BlendMode::Add, float opacity = 1.f) {
+        auto it = Available->find(kind);
+        if (it == Available->end()) return false;
+        Layers.push_back({ kind, it->second(), blend, opacity });
+        return true;
+    }
+
+    const char* GetName() const override { return "Layer Stack"; }
+    bool IsLooping() override {
+        for (Layer& layer : Layers) {
+            if (layer.Visible && !layer.Generator->IsLooping()) return false;
+        }
+        return true;
+    }
+    std::unique_ptr<IFrameGenerator> Clone() const override { return std::make_unique<LayerStackGenerator>(*this); }
+    bool HasSimdKernel() const override {
+        for (const Layer& layer : Layers) {
+            if (layer.Visible && layer.Generator->HasSimdKernel()) return true;
+        }
+        return false;
+    }
+    bool HasFinishPass() const override { return !Fused(); }
+    bool HashState(StateKey& key) const override {
+        key.Add((int)Layers.size());
+        for (const Layer& layer : Layers) {
+            key.Add(layer.Kind).Add(layer.Blend).Add(layer.Opacity).Add(layer.Visible);
+            key.Add(layer.Transform.OffsetX).Add(layer.Transform.OffsetY).Add(layer.Transform.Scale);
+            if (!HashGenerator(*layer.Generator, key)) return false;
+        }
+        return true;
+    }
+    // the composite repeats when every visible layer has, a still layer never breaks a period
+    int Repeats() const override {
+        int repeats = 0;
+        for (const Layer& layer : Layers) {
+            if (layer.Visible) repeats = std::gcd(repeats, layer.Generator->Repeats());
+        }
+        return repeats;
+    }
+
+    void GenerateTile(const Draw::ImageView& target, double t, int y0, int y1, KernelVariant variant) override {
+        size_t split = FirstFinishLayer();
+        if (split < Layers.size()) {
+            std::vector<Draw::ImageView> frames = FramesFor(target, Layers.size() - split);
+            for (size_t i = split; i < Layers.size(); i++) {
+                Layer& layer = Layers[i];
+                if (!layer.Visible || layer.Opacity <= 0.f) continue;
+                layer.Generator->GenerateTile(frames[i - split], t, y0, y1, layer.Generator->HasSimdKernel() ? variant : KernelVariant::Scalar);
+            }
+        }
+
+        // the layers below go straight into the target, band by band
+        std::vector<uint8_t> band, row((size_t)target.Width * target.Channels);
+        int bandRows = (int)std::clamp<size_t>(BandBytes / row.size(), 4, 64);
+        for (int b0 = y0; b0 < y1; b0 += bandRows) {
+            int b1 = std::min(b0 + bandRows, y1);
+            for (int y = b0; y < b1; y++) { std::memset(target.Row(y), 0, target.RowBytes()); }
+
+            for (size_t i = 0; i < split; i++) {
+                Layer& layer = Layers[i];
+                if (!layer.Visible || layer.Opacity <= 0.f) continue;
+                auto [r0, r1] = SourceRows(layer.Transform, target.Height, b0, b1);
+                if (r0 >= r1) continue;
+
+                // only rows [r0, r1) of this view exist, they are all the layer's kernel touches
+                band.resize((size_t)(r1 - r0) * target.Width * target.Channels);
+                Draw::ImageView source = { band.data(), target.Width, target.Height, target.Channels, 0, r0 };
+                layer.Generator->GenerateTile(source, t, r0, r1, layer.Generator->HasSimdKernel() ? variant : KernelVariant::Scalar);
+                BlendLayer(layer, source, r0, r1, target, b0, b1, row.data());
+            }
+        }
+    }
+
+    void FinishFrame(const Draw::ImageView& target, double t) override {
+        size_t split = FirstFinishLayer();
+        if (split == Layers.size()) return;
+        std::vector<std::vector<uint8_t>> frames = TakeFrames(target);
+        if (frames.empty()) {
+            // no tiles came through for this frame
+            GenerateTile(target, t, 0, target.Height, KernelVariant::Scalar);
+            frames = TakeFrames(target);
+        }
+
+        std::vector<uint8_t> row((size_t)target.Width * target.Channels);
+        for (size_t i = split; i < Layers.size(); i++) {
+            Layer& layer = Layers[i];
+            if (!layer.Visible || layer.Opacity <= 0.f) continue;
+            // a layer off the frame still rendered whole, its finish pass may pull pixels in
+            Draw::ImageView source = { frames[i - split].data(), target.Width, target.Height, target.Channels };
+            layer.Generator->FinishFrame(source, t);
+            BlendLayer(layer, source, 0, target.Height, target, 0, target.Height, row.data());
+        }
+
+        std::lock_guard<std::mutex> lock(FrameLock);
+        for (std::vector<uint8_t>& pixels : frames) Spare.push_back(std::move(pixels));
+    }
+
+    bool DrawImGui() override {
+        bool changing = false;
+        ImGui::TextUnformatted("Layer Stack");
+
+        int remove = -1, lower = -1;
+        for (int i = 0; i < (int)Layers.size(); i++) {
+            Layer& layer = Layers[i];
+            ImGui::PushID(i);
+            std::string label = std::to_string(i + 1) + ". " + layer.Kind + " (" + BlendModeName(layer.Blend) + ")###layer";
+            if (ImGui::TreeNode(label.c_str())) {
+                changing |= ImGui::Checkbox("Visible", &layer.Visible);
+                int blend = (int)layer.Blend;
+                changing |= ImGui::Combo("Blend", &blend, "Add\0Screen\0Max\0Alpha Over\0");
+                layer.Blend = (BlendMode)blend;
+                changing |= ImGui::SliderFloat("Opacity", &layer.Opacity, 0.f, 1.f);
+                changing |= ImGui::SliderFloat("Offset X", &layer.Transform.OffsetX, -1.f, 1.f);
+                changing |= ImGui::SliderFloat("Offset Y", &layer.Transform.OffsetY, -1.f, 1.f);
+                changing |= ImGui::SliderFloat("Scale", &layer.Transform.Scale, 0.1f, 4.f);
+                if (i > 0 && ImGui::SmallButton("Move Down")) lower = i;
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Remove")) remove = i;
+                changing |= layer.Generator->DrawImGui();
+                ImGui::TreePop();
+            }
+            ImGui::PopID();
+        }
+        if (lower > 0) { std::swap(Layers[lower], Layers[lower - 1]); changing = true; }
+        if (remove >= 0) { Layers.erase(Layers.begin() + remove); changing = true; }
+
+        if (ImGui::BeginCombo("Add Layer", nullptr)) {
+            for (auto& [kind, factory] : *Available) {
+                if (ImGui::Selectable(kind.c_str())) { changing |= AddLayer(kind); }
+            }
+            ImGui::EndCombo();
+        }
+        return changing;
+    }
+
+private:
+    bool Fused() const { return FirstFinishLayer() == Layers.size(); }
+    // layers from this one up wait for FinishFrame to be blended
+    size_t FirstFinishLayer() const {
+        for (size_t i = 0; i < Layers.size(); i++) {
+            if (Layers[i].Visible && Layers[i].Generator->HasFinishPass()) return i;
+        }
+        return Layers.size();
+    }
+
+    // Frame buffers of the waiting layers, one each, for the frame a target belongs to, made by
+    // whichever of its tiles comes first. Buffers of finished frames go back to Spare for the next ones.
+    std::vector<Draw::ImageView> FramesFor(const Draw::ImageView& target, size_t count) {
+        std::lock_guard<std::mutex> lock(FrameLock);
+        std::vector<std::vector<uint8_t>>& frames = Frames[target.Pixels];
+        if (frames.empty()) {
+            frames.resize(count);
+            for (std::vector<uint8_t>& pixels : frames) {
+                if (!Spare.empty()) {
+                    pixels = std::move(Spare.back());
+                    Spare.pop_back();
+                }
+                pixels.resize(target.ByteSize());
+            }
+        }
+        std::vector<Draw::ImageView> views;
+        for (std::vector<uint8_t>& pixels : frames) views.push_back({ pixels.data(), target.Width, target.Height, target.Channels });
+        return views;
+    }
+    std::vector<std::vector<uint8_t>> TakeFrames(const Draw::ImageView& target) {
+        std::lock_guard<std::mutex> lock(FrameLock);
+        auto it = Frames.find(target.Pixels);
+        if (it == Frames.end()) return {};
+        std::vector<std::vector<uint8_t>> frames = std::move(it->second);
+        Frames.erase(it);
+        return frames;
+    }
+
+    // frame pixel <-> frame units
+    static float ToUnits(float pixel, int size) { return 2.f * pixel / (size - 1) - 1.f; }
+    static float ToPixels(float units, int size) { return (units + 1.f) * 0.5f * (size - 1); }
+
+    // layer rows the composite rows [y0, y1) sample from, with the bilinear neighbours
+    static std::pair<int, int> SourceRows(const LayerTransform& tf, int size, int y0, int y1) {
+        if (tf.IsIdentity()) return { y0, y1 };
+        float a = ToPixels(tf.SourceY(ToUnits((float)y0, size)), size);
+        float b = ToPixels(tf.SourceY(ToUnits((float)(y1 - 1), size)), size);
+        int r0 = std::max(0, (int)std::floor(std::min(a, b)));
+        int r1 = std::min(size, (int)std::floor(std::max(a, b)) + 2);
+        return { r0, r1 };
+    }
+
+    // blends composite rows [y0, y1) from a layer frame of which rows [r0, r1) are valid
+    static void BlendLayer(const Layer& layer, const Draw::ImageView& source, int r0, int r1,
+        const Draw::ImageView& target, int y0, int y1, uint8_t* row)
+    {
+        int opacity = (int)std::lround(std::clamp(layer.Opacity, 0.f, 1.f) * 256.f);
+        int width = target.Width;
+        int channels = target.Channels;
+        const LayerTransform& tf = layer.Transform;
+        if (tf.IsIdentity()) {
+            for (int y = y0; y < y1; y++) { Draw::BlendRow(target.Row(y), source.Row(y), width, channels, layer.Blend, opacity); }
+            return;
+        }
+
+        // the same columns for every row, outside the layer's frame reads as empty
+        std::vector<int> xa(width);
+        std::vector<float> fx(width);
+        for (int X = 0; X < width; X++) {
+            float sx = ToPixels(tf.SourceX(ToUnits((float)X, width)), width);
+            xa[X] = (int)std::floor(sx);
+            fx[X] = sx - xa[X];
+        }
+        auto texel = [&](int x, int y, int c) -> float {
+            if (x < 0 || x >= width || y < r0 || y >= r1) return 0.f;
+            return source.Row(y)[(size_t)x * channels + c];
+        };
+        for (int y = y0; y < y1; y++) {
+            float sy = ToPixels(tf.SourceY(ToUnits((float)y, target.Height)), target.Height);
+            int ya = (int)std::floor(sy);
+            float fy = sy - ya;
+            for (int X = 0; X < width; X++) {
+                for (int c = 0; c < channels; c++) {
+                    float top = texel(xa[X], ya, c) * (1.f - fx[X]) + texel(xa[X] + 1, ya, c) * fx[X];
+                    float bottom = texel(xa[X], ya + 1, c) * (1.f - fx[X]) + texel(xa[X] + 1, ya + 1, c) * fx[X];
+                    row[(size_t)X * channels + c] = (uint8_t)std::lround(top * (1.f - fy) + bottom * fy);
+                }
+            }
+            Draw::BlendRow(target.Row(y), row, width, channels, layer.Blend, opacity);
+        }
+    }
+
+    std::shared_ptr<const Factories> Available;
+    std::vector<Layer> Layers;
+
+    std::mutex FrameLock;
+    std::unordered_map<const uint8_t*, std::vector<std::vector<uint8_t>>> Frames;    // frames whose tiles are still coming
+    std::vector<std::vector<uint8_t>> Spare;
+};
@@ -0,0 +1,193 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include "DrawFunctions.h"
+
+// Signed distance output: frames hold distance to the shape edge instead of a brightness
+// ramp, so the runtime can ship a small SDF and upscale it on the GPU. Masks packs several
+// masks shaped from one evaluation into the channels (MaskGenerator).
+enum class OutputMode { Bitmap, DistanceField, Masks };
+
+namespace Draw {
+
+    // Cells with no source use this instead of infinity so the envelope arithmetic stays finite.
+    constexpr float FarDistance = 1e20f;
+
+    // Felzenszwalb & Huttenlocher lower envelope of parabolas: d[q] = min_p (q - p)^2 + f[p].
+    // v and z are scratch of n and n + 1 entries.
+    inline void DistanceTransform1D(const float* f, float* d, int n, int* v, float* z) {
+        int k = 0;
+        v[0] = 0;
+        z[0] = -FarDistance;
+        z[1] = FarDistance;
+        for (int q = 1; q < n; q++) {
+            float s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) / (2.f * (q - v[k]));
+            while (s <= z[k]) {
+                k--;
+                s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) / (2.f * (q - v[k]));
+            }
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = FarDistance;
+        }
+        k = 0;
+        for (int q = 0; q < n; q++) {
+            while (z[k + 1] < q) k++;
+            d[q] = (float)(q - v[k]) * (q - v[k]) + f[v[k]];
+        }
+    }
+
+    // Exact squared Euclidean distance to the nearest zero cell, in place. Linear in the pixel
+    // count: one 1D pass down every column, then one along every row, each split across threads.
+    inline void SquaredDistance(std::vector<float>& grid, int width, int height, int threads) {
+        PROFILE_SCOPE("SquaredDistance");
+        ParallelFor(width, threads, [&](int x0, int x1) {
+            std::vector<float> f(height), d(height), z(height + 1);
+            std::vector<int> v(height);
+            for (int x = x0; x < x1; x++) {
+                for (int y = 0; y < height; y++) f[y] = grid[(size_t)y * width + x];
+                DistanceTransform1D(f.data(), d.data(), height, v.data(), z.data());
+                for (int y = 0; y < height; y++) grid[(size_t)y * width + x] = d[y];
+            }
+        });
+        ParallelFor(height, threads, [&](int y0, int y1) {
+            std::vector<float> d(width), z(width + 1);
+            std::vector<int> v(width);
+            for (int y = y0; y < y1; y++) {
+                float* row = grid.data() + (size_t)y * width;
+                DistanceTransform1D(row, d.data(), width, v.data(), z.data());
+                std::copy(d.begin(), d.end(), row);
+            }
+        });
+    }
+
+    // Signed distance in pixels for any mask frame: a pixel is inside when its first channel
+    // is above threshold. Negative inside, measured to the pixel boundary between the two sides.
+    inline void SignedDistance(const ImageView& mask, std::vector<float>& out, int threads, uint8_t threshold = 0) {
+        int width = mask.Width;
+        int height = mask.Height;
+        size_t count = (size_t)width * height;
+
+        std::vector<float> outside(count), inside(count);
+        for (int y = 0; y < height; y++) {
+            const uint8_t* row = mask.Row(y);
+            for (int x = 0; x < width; x++) {
+                bool in = row[(size_t)x * mask.Channels] > threshold;
+                outside[(size_t)y * width + x] = in ? 0.f : Draw::FarDistance;
+                inside[(size_t)y * width + x] = in ? Draw::FarDistance : 0.f;
+            }
+        }
+        SquaredDistance(outside, width, height, threads);
+        SquaredDistance(inside, width, height, threads);
+
+        // with no edge in the frame one side never finds a source, clamp it to the frame diagonal
+        float diagonal = std::sqrt((float)width * width + (float)height * height);
+        out.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            float dOut = std::min(std::sqrt(outside[i]), diagonal);
+            float dIn = std::min(std::sqrt(inside[i]), diagonal);
+            out[i] = dOut > 0.f ? dOut - 0.5f : 0.5f - dIn;
+        }
+    }
+}
+
+// Wraps any generator for DistanceField output. Generators with an analytic distance kernel
+// write it straight into the small target. Mask-only generators are rendered at SourceSize,
+// each tile of the target rendering its share of the mask rows on whichever worker claimed
+// it, and run through the EDT in FinishFrame, then resampled down to the target.
+class DistanceFieldGenerator : public IFrameGenerator {
+public:
+    DistanceFieldGenerator(std::unique_ptr<IFrameGenerator> inner, int sourceSize, float range, int edtThreads = 1)
+        : Inner(std::move(inner)), SourceSize(sourceSize), Range(range), EdtThreads(edtThreads) {}
+
+    const char* GetName() const override { return Inner->GetName(); }
+    bool IsLooping() override { return Inner->IsLooping(); }
+    int Repeats() const override { return Inner->Repeats(); }
+    bool DrawImGui() override { return Inner->DrawImGui(); }
+    std::unique_ptr<IFrameGenerator> Clone() const override {
+        return std::make_unique<DistanceFieldGenerator>(Inner->Clone(), SourceSize, Range, EdtThreads);
+    }
+    bool HasSimdKernel() const override { return Inner->HasSimdKernel(); }
+    bool HasFinishPass() const override { return !Inner->HasDistanceKernel(); }
+    // EdtThreads only splits the work, the field comes out the same
+    bool HashState(StateKey& key) const override {
+        key.Add("Distance Field").Add(SourceSize).Add(Range);
+        return HashGenerator(*Inner, key);
+    }
+
+    // rows [y0, y1) of the target map to the same share of the mask rows, so a frame's tiles
+    // render the whole mask between them
+    void GenerateTile(const Draw::ImageView& target, double t, int y0, int y1, KernelVariant variant) override {
+        if (Inner->HasDistanceKernel()) { Inner->GenerateDistanceTile(target, t, y0, y1, Range, variant); return; }
+        Draw::ImageView mask = { MaskFor(target).data(), SourceSize, SourceSize, 4 };
+        int m0 = (int)((int64_t)y0 * SourceSize / target.Height);
+        int m1 = (int)((int64_t)y1 * SourceSize / target.Height);
+        if (m1 > m0) Inner->GenerateTile(mask, t, m0, m1, variant);
+    }
+
+    void FinishFrame(const Draw::ImageView& target, double t) override {
+        if (Inner->HasDistanceKernel()) return;
+        PROFILE_SCOPE("DistanceTransform");
+
+        std::vector<uint8_t> pixels = TakeMask(target);
+        Draw::ImageView mask = { pixels.data(), SourceSize, SourceSize, 4 };
+        Inner->FinishFrame(mask, t);
+
+        std::vector<float> distance;
+        Draw::SignedDistance(mask, distance, EdtThreads);
+
+        // pixels to the generators' -1..1 frame units, bilinear at each target pixel
+        float toUnits = 2.f / (SourceSize - 1);
+        float step = (float)(SourceSize - 1) / std::max(1, target.Width - 1);
+        for (int Y = 0; Y < target.Height; Y++) {
+            uint8_t* row = target.Row(Y);
+            float sy = Y * step;
+            int y0 = std::min((int)sy, SourceSize - 2);
+            float fy = sy - y0;
+            for (int X = 0; X < target.Width; X++) {
+                float sx = X * step;
+                int x0 = std::min((int)sx, SourceSize - 2);
+                float fx = sx - x0;
+                const float* d0 = distance.data() + (size_t)y0 * SourceSize + x0;
+                const float* d1 = d0 + SourceSize;
+                float d = (d0[0] * (1 - fx) + d0[1] * fx) * (1 - fy) + (d1[0] * (1 - fx) + d1[1] * fx) * fy;
+
+                uint8_t col = Draw::EncodeDistance(d * toUnits, Range);
+                uint8_t* pixel = row + (size_t)X * target.Channels;
+                pixel[0] = col;
+                pixel[1] = col;
+                pixel[2] = col;
+                pixel[3] = col;
+            }
+        }
+    }
+
+private:
+    // the mask of the frame a target belongs to, made by whichever of its tiles comes first
+    std::vector<uint8_t>& MaskFor(const Draw::ImageView& target) {
+        std::lock_guard<std::mutex> lock(MaskLock);
+        std::vector<uint8_t>& pixels = Masks[target.Pixels];
+        if (pixels.empty()) pixels.resize((size_t)SourceSize * SourceSize * 4);
+        return pixels;
+    }
+    std::vector<uint8_t> TakeMask(const Draw::ImageView& target) {
+        std::lock_guard<std::mutex> lock(MaskLock);
+        auto it = Masks.find(target.Pixels);
+        if (it == Masks.end()) return std::vector<uint8_t>((size_t)SourceSize * SourceSize * 4);
+        std::vector<uint8_t> pixels = std::move(it->second);
+        Masks.erase(it);
+        return pixels;
+    }
+
+    std::unique_ptr<IFrameGenerator> Inner;
+    int SourceSize;
+    float Range;
+    int EdtThreads;
+
+    std::mutex MaskLock;
+    std::unordered_map<const uint8_t*, std::vector<uint8_t>> Masks;    // frames whose tiles are still coming
+};
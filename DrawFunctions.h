@@ -1,15 +1,54 @@
 #pragma once
 #include <DXE.h>
+#include <thread>
+#include <functional>
+#include <string>
+#include <cstring>
+#include <type_traits>
+#include <cfloat>
 #include <Renderer/Texture.h>
 #include "Maths/Maths.h"
 #include "UIWidgets.h"
+#include "Profiler.h"
+#include "Noise.h"
 
 namespace Draw {
 
 
     struct Pixel { uint8_t r, g, b, a; };
 
-    inline Pixel sample(const std::vector<uint8_t>& img, int W, int H, double x, double y) {
+    // Raw view over an RGBA8 frame so kernels can render into any buffer, not just a DXE::Texture.
+    // Stride is set for views into part of a larger image, FirstRow for views that hold only a
+    // band of an image's rows; ByteSize() and whole-frame passes assume a packed whole view.
+    struct ImageView {
+        uint8_t* Pixels = nullptr;
+        int Width = 0;
+        int Height = 0;
+        int Channels = 4;
+        size_t Stride = 0;      // bytes per row, 0 when packed
+        int FirstRow = 0;       // image row at Pixels, kernels still address rows of the whole image
+
+        uint8_t* Row(int y) const { return Pixels + (size_t)(y - FirstRow) * RowBytes(); }
+        size_t RowBytes() const { return Stride ? Stride : (size_t)Width * Channels; }
+        size_t ByteSize() const { return (size_t)Width * Height * Channels; }
+        ImageView Sub(int x, int y, int width, int height) const {
+            return { Row(y) + (size_t)x * Channels, width, height, Channels, RowBytes() };
+        }
+
+        static ImageView Of(DXE::Texture* texture) {
+            return { texture->Pixels().data(), texture->Width(), texture->Height(), texture->Channels() };
+        }
+    };
+
+    // 0.5 on the edge, 1 at `range` inside, 0 at `range` outside (distances negative inside)
+    // a NaN distance (clamp passes it through, its cast is undefined) reads as outside
+    inline uint8_t EncodeDistance(float d, float range) {
+        float v = 0.5f - 0.5f * d / range;
+        if (!(v > 0.f)) return 0;
+        return (uint8_t)(255.f * std::min(v, 1.f) + 0.5f);
+    }
+
+    inline Pixel sample(const uint8_t* img, int W, int H, double x, double y) {
         if (x < 0 || y < 0 || x >= W - 1 || y >= H - 1) return { 0, 0, 0, 255 };
         int x0 = int(floor(x));
         int y0 = int(floor(y));
@@ -17,7 +56,7 @@ namespace Draw {
         double fy = y - y0;
 
         auto getP = [&](int xi, int yi) -> Pixel {
-            size_t idx = (yi * W + xi) * 4;
+            size_t idx = ((size_t)yi * W + xi) * 4;
             return { img[idx], img[idx + 1], img[idx + 2], img[idx + 3] };
             };
 
@@ -36,13 +75,13 @@ namespace Draw {
         return out;
     }
 
-    inline void RectangleToRing(DXE::Texture* texture) {
-        int width = texture->Width();
-        int height = texture->Height();
-        int channels = texture->Channels();
-        auto& pixels = texture->Pixels();
+    inline void RectangleToRing(const ImageView& image) {
+        PROFILE_SCOPE("RectangleToRing");
+        int width = image.Width;
+        int height = image.Height;
+        int channels = image.Channels;
 
-        std::vector<uint8_t> output(width * height * channels, 0);
+        std::vector<uint8_t> output(image.ByteSize(), 0);
 
         double maxRadius = 0.5*(height-1); // thickness = input height
 
@@ -54,14 +93,14 @@ namespace Draw {
                 double theta = std::atan2(dy, dx);
                 if (theta < 0) theta += 2 * DXM::Pi;
 
-                size_t idx = (y * width + x) * 4;
+                size_t idx = ((size_t)y * width + x) * 4;
 
                 if (r >= 0 && r <= maxRadius) {
                     // Map polar (r, theta) back to input rectangle coordinates
                     double inX = (theta / (2 * DXM::Pi)) * (width-1);
                     double inY = (r / maxRadius) * (height-1);
 
-                    Pixel color = sample(texture->Pixels(), width, height, inX, inY);
+                    Pixel color = sample(image.Pixels, width, height, inX, inY);
 
          
                     output[idx + 0] = color.r;
@@ -77,7 +116,93 @@ namespace Draw {
                 }
             }
         }
-        texture->Pixels() = output;
+        std::copy(output.begin(), output.end(), image.Pixels);
+    }
+    inline void RectangleToRing(DXE::Texture* texture) { RectangleToRing(ImageView::Of(texture)); }
+
+    // Circular generators evaluate their rectangle straight in polar form instead of rendering
+    // it and calling RectangleToRing: a ring pixel gets the frame point RectangleToRing would
+    // sample there (angle across, radius down), unfiltered, and pixels off the ring are skipped.
+    struct RingMap {
+        float CenterX, CenterY, Radius;
+
+        RingMap(int width, int height) : CenterX(width / 2.f), CenterY(height / 2.f), Radius(0.5f * (height - 1)) {}
+
+        bool Inside(int x, int y) const {
+            float dx = x - CenterX, dy = y - CenterY;
+            return dx * dx + dy * dy <= Radius * Radius;
+        }
+        // -1..1 frame coordinates shown at pixel (x, y), false off the ring
+        bool Map(int x, int y, float& u, float& v) const {
+            if (!Inside(x, y)) return false;
+            float dx = x - CenterX, dy = y - CenterY;
+            float theta = std::atan2(dy, dx);
+            if (theta < 0) theta += 2 * DXM::Pi;
+            u = theta / DXM::Pi - 1.f;
+            v = 2.f * std::sqrt(dx * dx + dy * dy) / Radius - 1.f;
+            return true;
+        }
+        // pixels [x0, x1) of row y on the ring, with their frame coordinates in us and vs from index 0
+        int Row(int y, int width, float* us, float* vs, int& x0) const {
+            float dy = y - CenterY;
+            float rest = Radius * Radius - dy * dy;
+            x0 = 0;
+            if (rest < 0.f) return 0;
+            float half = std::sqrt(rest);
+            int a = std::clamp((int)std::ceil(CenterX - half), 0, width);
+            int b = std::clamp((int)std::floor(CenterX + half) + 1, a, width);
+            // settle the rounding with the exact test Map uses
+            while (a < b && !Inside(a, y)) a++;
+            while (a > 0 && Inside(a - 1, y)) a--;
+            while (b > a && !Inside(b - 1, y)) b--;
+            while (b < width && Inside(b, y)) b++;
+            for (int x = a; x < b; x++) { Map(x, y, us[x - a], vs[x - a]); }
+            x0 = a;
+            return b - a;
+        }
+    };
+
+    // Splits [0, count) into one contiguous range per thread for work outside the render pool
+    // (single-frame passes, on-demand decodes). Runs inline when threads is 1.
+    inline void ParallelFor(int count, int threads, const std::function<void(int, int)>& body) {
+        threads = std::clamp(threads, 1, std::max(1, count));
+        if (threads == 1) { body(0, count); return; }
+
+        std::vector<std::thread> workers;
+        int chunk = (count + threads - 1) / threads;
+        for (int begin = 0; begin < count; begin += chunk) {
+            workers.emplace_back(body, begin, std::min(count, begin + chunk));
+        }
+        for (auto& worker : workers) worker.join();
+    }
+
+    // Box-filtered shrink for thumbnails. Each output pixel averages at most 4x4 evenly spaced
+    // source pixels, so the cost depends on the output size rather than the frame size.
+    inline void Downsample(const ImageView& src, const ImageView& dst) {
+        const int maxTaps = 4;
+        for (int y = 0; y < dst.Height; y++) {
+            int sy0 = y * src.Height / dst.Height;
+            int sy1 = std::max(sy0 + 1, (y + 1) * src.Height / dst.Height);
+            int stepY = std::max(1, (sy1 - sy0) / maxTaps);
+            uint8_t* out = dst.Row(y);
+
+            for (int x = 0; x < dst.Width; x++) {
+                int sx0 = x * src.Width / dst.Width;
+                int sx1 = std::max(sx0 + 1, (x + 1) * src.Width / dst.Width);
+                int stepX = std::max(1, (sx1 - sx0) / maxTaps);
+
+                uint32_t sum[4] = { 0, 0, 0, 0 };
+                uint32_t count = 0;
+                for (int sy = sy0; sy < sy1; sy += stepY) {
+                    const uint8_t* row = src.Row(sy);
+                    for (int sx = sx0; sx < sx1; sx += stepX) {
+                        for (int c = 0; c < 4; c++) sum[c] += row[(size_t)sx * src.Channels + c];
+                        count++;
+                    }
+                }
+                for (int c = 0; c < 4; c++) out[(size_t)x * dst.Channels + c] = (uint8_t)(sum[c] / count);
+            }
+        }
     }
 
     inline void Leaf(DXE::Texture* texture) {
@@ -116,7 +241,7 @@ namespace Draw {
         for (int Y = 0; Y < height; Y++) {
             for (int X = 0; X < width; X++) {
 
-                int pixelIndex = (Y * width + X) * channels;
+                size_t pixelIndex = ((size_t)Y * width + X) * channels;
                 auto& pixel = pixels[pixelIndex];
                 // Access components
                 unsigned char& r = pixels[pixelIndex + 0];
@@ -152,7 +277,7 @@ namespace Draw {
         for (int Y = 0; Y < height; Y++) {
             for (int X = 0; X < width; X++) {
                 //access rgba components
-                int pixelIndex = (Y * width + X) * channels;
+                size_t pixelIndex = ((size_t)Y * width + X) * channels;
                 auto& pixel = pixels[pixelIndex];
                 unsigned char& r = pixels[pixelIndex + 0];
                 unsigned char& g = pixels[pixelIndex + 1];
@@ -218,7 +343,7 @@ namespace Draw {
         for (int Y = 0; Y < height; Y++) {
             for (int X = 0; X < width; X++) {
                 //access rgba components
-                int pixelIndex = (Y * width + X) * channels;
+                size_t pixelIndex = ((size_t)Y * width + X) * channels;
                 auto& pixel = pixels[pixelIndex];
                 unsigned char& r = pixels[pixelIndex + 0];
                 unsigned char& g = pixels[pixelIndex + 1];
@@ -285,7 +410,7 @@ namespace Draw {
         for (int Y = 0; Y < height; Y++) {
             for (int X = 0; X < width; X++) {
                 //access rgba components
-                int pixelIndex = (Y * width + X) * channels;
+                size_t pixelIndex = ((size_t)Y * width + X) * channels;
                 auto& pixel = pixels[pixelIndex];
                 unsigned char& r = pixels[pixelIndex + 0];
                 unsigned char& g = pixels[pixelIndex + 1];
@@ -343,7 +468,7 @@ namespace Draw {
         for (int Y = 0; Y < height; Y++) {
             for (int X = 0; X < width; X++) {
                 //access rgba components
-                int pixelIndex = (Y * width + X) * channels;
+                size_t pixelIndex = ((size_t)Y * width + X) * channels;
                 auto& pixel = pixels[pixelIndex];
                 unsigned char& r = pixels[pixelIndex + 0];
                 unsigned char& g = pixels[pixelIndex + 1];
@@ -372,13 +497,277 @@ namespace Draw {
 
 }
 
+enum class KernelVariant { Scalar, Simd };
+
+// Calls f with each runtime flag as a std::bool_constant, so a kernel can be a template over
+// flags that hold for a whole call and pick its instantiation once instead of testing them
+// per pixel. 2^flags instantiations, keep the list short.
+template<typename F>
+void WithFlags(F&& f) { f(); }
+template<typename F, typename... Flags>
+void WithFlags(F&& f, bool flag, Flags... rest) {
+    if (flag) WithFlags([&](auto... set) { f(std::true_type{}, set...); }, rest...);
+    else WithFlags([&](auto... set) { f(std::false_type{}, set...); }, rest...);
+}
+
+// A Parameters field a sweep can vary. Int fields take the value rounded.
+template<typename P>
+struct SweepField {
+    const char* Name;
+    float P::* Float = nullptr;
+    int P::* Int = nullptr;
+
+    float Get(const P& p) const { return Float ? p.*Float : (float)(p.*Int); }
+    void Set(P& p, float v) const {
+        if (Float) p.*Float = v;
+        else p.*Int = (int)std::lround(v);
+    }
+};
+
+// Variants rendered together by a sweep: per variant, one value for each of Fields
+// (indices into the generator's SweepFields()).
+struct SweepBatch {
+    std::vector<int> Fields;
+    std::vector<float> Values;  // variant-major
+
+    int Count() const { return Fields.empty() ? 0 : (int)(Values.size() / Fields.size()); }
+    float Value(int variant, int field) const { return Values[(size_t)variant * Fields.size() + field]; }
+};
+
+// For batched kernels: the index of the first variant that can share v's intermediate work.
+template<typename P, typename Same>
+std::vector<int> SweepGroups(const std::vector<P>& variants, Same same) {
+    std::vector<int> leader(variants.size());
+    for (size_t v = 0; v < variants.size(); v++) {
+        leader[v] = (int)v;
+        for (size_t u = 0; u < v; u++) {
+            if (leader[u] == (int)u && same(variants[u], variants[v])) { leader[v] = (int)u; break; }
+        }
+    }
+    return leader;
+}
+
+namespace Draw {
+
+    // what a field kernel writes for pixels it doesn't cover, every mask maps it to 0
+    constexpr float NoField = -FLT_MAX;
+
+    // Row writers for the vector kernels, whose rows cover pixels [x0, x0 + n): the whole row,
+    // or the part of a circular frame's row that lies on the ring.
+
+    // 0..1 mask values into every channel, pixels off the ring black
+    inline void WriteMaskRow(uint8_t* row, int width, int channels, int x0, int n, const float* values) {
+        if (n < width) std::memset(row, 0, (size_t)width * channels);
+        for (int X = 0; X < n; X++) {
+            uint8_t col = (uint8_t)(255.f * values[X]);
+            for (int c = 0; c < channels; c++) { row[(size_t)(x0 + X) * channels + c] = col; }
+        }
+    }
+    // values times scale, NoField off the ring
+    inline void WriteFieldRow(float* row, int width, int x0, int n, const float* values, float scale) {
+        std::fill(row, row + x0, NoField);
+        for (int X = 0; X < n; X++) { row[x0 + X] = scale * values[X]; }
+        std::fill(row + x0 + n, row + width, NoField);
+    }
+}
+
+// The inputs that decide a generator's output, serialized for caches that outlive the session.
+// Values go in one at a time, never as whole structs, so padding stays out and equal
+// parameters give equal keys in every build and on every machine.
+struct StateKey {
+    std::string Bytes;
+
+    template<typename T>
+    StateKey& Add(T value) {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "add structs field by field");
+        Bytes.append((const char*)&value, sizeof(value));
+        return *this;
+    }
+    StateKey& Add(const char* text) { Bytes.append(text, std::strlen(text) + 1); return *this; }
+    StateKey& Add(const std::string& text) { return Add(text.c_str()); }
+    StateKey& Add(const DXM::Vector2& v) { return Add(v.x).Add(v.y); }
+
+    // FNV-1a: std::hash differs between runs and standard libraries
+    uint64_t Hash() const {
+        uint64_t h = 14695981039346656037ull;
+        for (char c : Bytes) { h = (h ^ (uint8_t)c) * 1099511628211ull; }
+        return h;
+    }
+};
+
+// Walks the parameters a generator's output depends on, by name, in a fixed order. Vectors go
+// as their components ("pa.x") and noise fields under their own name ("noise.seed"). A visitor
+// may change a value; the walk writes back only what changed, so one that only reads never
+// touches the generator.
+struct StateVisitor {
+    virtual ~StateVisitor() = default;
+    virtual void Visit(const std::string& name, float& value) = 0;
+    virtual void Visit(const std::string& name, int& value) = 0;
+    virtual void Visit(const std::string& name, bool& value) = 0;
+
+    void Visit(const std::string& name, DXM::Vector2& v) {
+        Visit(name + ".x", v.x);
+        Visit(name + ".y", v.y);
+    }
+    // the permutation table is built from the seed
+    void Visit(const std::string& name, Noise::Field& f) {
+        int type = (int)f.type, octaves = f.octaves, seed = f.seed;
+        Visit(name + ".type", type);
+        Visit(name + ".octaves", octaves);
+        Visit(name + ".lacunarity", f.lacunarity);
+        Visit(name + ".gain", f.gain);
+        Visit(name + ".ridged", f.ridged);
+        Visit(name + ".speed", f.speed);
+        Visit(name + ".seed", seed);
+        if (type != (int)f.type) f.type = (Noise::Type)std::clamp(type, 0, (int)Noise::Type::Simplex);
+        if (octaves != f.octaves) f.octaves = std::clamp(octaves, 1, 8);
+        if (seed != f.seed) {
+            f.seed = seed;
+            f.Reseed();
+        }
+    }
+};
+
+// adds every value to a key, names stay out of it
+struct StateHasher : StateVisitor {
+    StateKey& Key;
+    explicit StateHasher(StateKey& key) : Key(key) {}
+    using StateVisitor::Visit;
+    void Visit(const std::string&, float& value) override { Key.Add(value); }
+    void Visit(const std::string&, int& value) override { Key.Add(value); }
+    void Visit(const std::string&, bool& value) override { Key.Add(value); }
+};
+
+// sets the parameter called Name, Found says whether there was one
+struct StateSetter : StateVisitor {
+    std::string Name;
+    float Value = 0.f;
+    bool Found = false;
+    StateSetter(std::string name, float value) : Name(std::move(name)), Value(value) {}
+    using StateVisitor::Visit;
+    void Visit(const std::string& name, float& value) override { if (name == Name) { value = Value; Found = true; } }
+    void Visit(const std::string& name, int& value) override { if (name == Name) { value = (int)std::lround(Value); Found = true; } }
+    void Visit(const std::string& name, bool& value) override { if (name == Name) { value = Value != 0.f; Found = true; } }
+};
+
+// the names of every parameter, in walk order
+struct StateNames : StateVisitor {
+    std::vector<std::string> Names;
+    using StateVisitor::Visit;
+    void Visit(const std::string& name, float&) override { Names.push_back(name); }
+    void Visit(const std::string& name, int&) override { Names.push_back(name); }
+    void Visit(const std::string& name, bool&) override { Names.push_back(name); }
+};
+
+enum class MaskCurve { Linear, Smooth, Power };
+
+// One mask shaped from a generator's field: shifted by Bias, scaled by Brightness and clamped to
+// 0..1, then through the curve. Channel is where it lands in a packed frame, R, G, B or A.
+struct MaskOutput {
+    std::string Name = "mask";
+    float Bias = 0.f;
+    float Brightness = 1.f;
+    MaskCurve Curve = MaskCurve::Linear;
+    float Exponent = 1.f;       // Power only
+    int Channel = 0;
+
+    // n field values into every stride-th byte of out, the curve picked once for the row
+    void ApplyRow(const float* field, uint8_t* out, size_t stride, int n) const {
+        auto shape = [&](auto curve) {
+            for (int X = 0; X < n; X++) {
+                float v = std::clamp(Brightness * (field[X] - Bias), 0.f, 1.f);
+                out[(size_t)X * stride] = (uint8_t)(255.f * curve(v));
+            }
+        };
+        switch (Curve) {
+        case MaskCurve::Smooth: shape([](float v) { return v * v * (3.f - 2.f * v); }); break;
+        case MaskCurve::Power: shape([&](float v) { return std::pow(v, Exponent); }); break;
+        default: shape([](float v) { return v; }); break;
+        }
+    }
+};
+
 class IFrameGenerator {
 public:
     virtual ~IFrameGenerator() = default;
     virtual const char* GetName() const = 0;
     virtual bool IsLooping() = 0;
-    virtual void Generate(DXE::Texture* tex, double t) = 0;
     virtual bool DrawImGui() = 0; //draw parameters in ImGui
+    virtual std::unique_ptr<IFrameGenerator> Clone() const = 0;
+
+    // renders rows [y0, y1) of a frame, tiles of one frame may run on different threads
+    virtual void GenerateTile(const Draw::ImageView& target, double t, int y0, int y1, KernelVariant variant) = 0;
+    // whole-frame pass once every tile of the frame is done
+    virtual void FinishFrame(const Draw::ImageView& target, double t) {}
+    // FinishFrame does whole-frame work, a frame's tiles alone aren't the final image
+    virtual bool HasFinishPass() const { return false; }
+    virtual bool HasSimdKernel() const { return false; }
+
+    // analytic signed distance for OutputMode::DistanceField, encoded with Draw::EncodeDistance;
+    // generators without one are converted from their mask by the EDT
+    virtual bool HasDistanceKernel() const { return false; }
+    virtual void GenerateDistanceTile(const Draw::ImageView& target, double t, int y0, int y1, float range, KernelVariant variant) {}
+
+    // The per-pixel field a generator's mask is shaped from, before its own bias and brightness,
+    // so several masks can come from one evaluation (MaskGenerator). Rows [y0, y1) of a width x
+    // height frame into field, width floats a row, Draw::NoField where the frame isn't covered.
+    // FieldMask is the output that gives the generator's own mask back.
+    virtual bool HasFieldKernel() const { return false; }
+    virtual void GenerateFieldTile(float* field, int width, int height, double t, int y0, int y1, KernelVariant variant) {}
+    virtual MaskOutput FieldMask() const { return {}; }
+
+    // parameter sweeps: the fields a sweep may vary, and rows [y0, y1) of every variant of a
+    // batch in one call. Generators with a batched kernel share the work that doesn't depend
+    // on the varied fields; the default renders the variants one by one.
+    virtual std::vector<const char*> SweepFields() const { return {}; }
+    virtual float GetSweepField(int field) const { return 0.f; }
+    virtual void SetSweepField(int field, float value) {}
+    virtual void GenerateVariantsTile(const std::vector<Draw::ImageView>& targets, const SweepBatch& batch, double t, int y0, int y1, KernelVariant variant) {
+        for (int v = 0; v < batch.Count(); v++) {
+            auto copy = Clone();
+            for (int f = 0; f < (int)batch.Fields.size(); f++) copy->SetSweepField(batch.Fields[f], batch.Value(v, f));
+            copy->GenerateTile(targets[v], t, y0, y1, variant);
+        }
+    }
+
+    // sequence rendering: rows [y0, y1) of several frames in one call, so a generator can do
+    // the work that doesn't depend on time once for all of them. The default goes frame by frame.
+    virtual bool HasSequenceKernel() const { return false; }
+    virtual void GenerateSequenceTile(const std::vector<Draw::ImageView>& targets, const std::vector<double>& times, int y0, int y1, KernelVariant variant) {
+        for (size_t i = 0; i < targets.size(); i++) GenerateTile(targets[i], times[i], y0, y1, variant);
+    }
+    void GenerateSequence(const std::vector<Draw::ImageView>& targets, const std::vector<double>& times, KernelVariant variant) {
+        if (targets.empty()) return;
+        GenerateSequenceTile(targets, times, 0, targets[0].Height, variant);
+        for (size_t i = 0; i < targets.size(); i++) FinishFrame(targets[i], times[i]);
+    }
+
+    // Cache identity: HashState adds every parameter the output depends on, Version goes up
+    // whenever a kernel change alters the pixels. By default it hashes what VisitState walks,
+    // the same parameters the render service sets by name, so the two can't drift apart.
+    // Generators that neither walk their state nor override HashState are never cached.
+    virtual int Version() const { return 1; }
+    virtual bool VisitState(StateVisitor& visitor) { return false; }
+    virtual bool HashState(StateKey& key) const {
+        StateHasher hasher(key);
+        // the hasher only reads, the walk writes nothing back
+        return const_cast<IFrameGenerator*>(this)->VisitState(hasher);
+    }
+    static bool HashGenerator(const IFrameGenerator& generator, StateKey& key) {
+        key.Add(generator.GetName()).Add(generator.Version());
+        return generator.HashState(key);
+    }
+
+    // How many times the output repeats over a looping generator's 0..1, so a job renders one
+    // period and aliases the rest; 0 when it doesn't change with time at all. The default
+    // claims nothing.
+    virtual int Repeats() const { return 1; }
+
+    virtual void Generate(DXE::Texture* tex, double t) {
+        Draw::ImageView view = Draw::ImageView::Of(tex);
+        GenerateTile(view, t, 0, view.Height, KernelVariant::Scalar);
+        FinishFrame(view, t);
+    }
 };
 
 class SlashTrailGenerator : public IFrameGenerator {
@@ -392,14 +781,54 @@ public:
         float noise_scale = 0.00f;
         int noise_freq_x = 2;
         int noise_freq_y = 3;
+        Noise::Field noise;
         float brightness = 2.f;
         bool circular = false;
     } S;
+    // noise octaves for the frames being rendered, shared by all their tiles
+    Noise::PreparedCache NoiseCache;
 
     const char* GetName() const override { return "Slash Trail"; }
     bool IsLooping() override { return false; }
-    void Generate(DXE::Texture* tex, double t) override {
-        SlashTrail(tex, t, S);
+    std::unique_ptr<IFrameGenerator> Clone() const override { return std::make_unique<SlashTrailGenerator>(*this); }
+    bool HasSimdKernel() const override { return true; }
+    // 2: equal radii go through the segment distance, last bits of the edge may differ
+    int Version() const override { return 2; }
+
+    void GenerateTile(const Draw::ImageView& target, double t, int y0, int y1, KernelVariant variant) override {
+        if (variant == KernelVariant::Simd) { SlashTrailRowsSimd(target, t, S, y0, y1); }
+        else { SlashTrail(target, t, S, y0, y1); }
+    }
+    // the ring mapping doesn't preserve distances, circular trails go through the EDT instead
+    bool HasDistanceKernel() const override { return !S.circular; }
+    void GenerateDistanceTile(const Draw::ImageView& target, double t, int y0, int y1, float range, KernelVariant variant) override {
+        SlashTrailRowsSimd(target, t, S, y0, y1, range);
+    }
+    // the field is the depth inside the capsule, the mask is 8 times it
+    bool HasFieldKernel() const override { return true; }
+    void GenerateFieldTile(float* field, int width, int height, double t, int y0, int y1, KernelVariant variant) override {
+        SlashTrailRowValues(width, height, t, { S }, y0, y1, true, [&](int, int Y, int x0, int n, const float* d) {
+            Draw::WriteFieldRow(field + (size_t)(Y - y0) * width, width, x0, n, d, -1.f);
+        });
+    }
+    MaskOutput FieldMask() const override {
+        MaskOutput mask;
+        mask.Brightness = 8.f;
+        return mask;
+    }
+    bool VisitState(StateVisitor& visitor) override {
+        visitor.Visit("pa", S.pa);
+        visitor.Visit("pb", S.pb);
+        visitor.Visit("ra", S.ra);
+        visitor.Visit("rb", S.rb);
+        visitor.Visit("bias", S.bias);
+        visitor.Visit("noise_scale", S.noise_scale);
+        visitor.Visit("noise_freq_x", S.noise_freq_x);
+        visitor.Visit("noise_freq_y", S.noise_freq_y);
+        visitor.Visit("noise", S.noise);
+        visitor.Visit("brightness", S.brightness);
+        visitor.Visit("circular", S.circular);
+        return true;
     }
 
     bool DrawImGui() override {
@@ -413,6 +842,7 @@ public:
         changing |= ImGui::SliderFloat("Noise Scale", &S.noise_scale, 0.0f, 1.0f);
         changing |= ImGui::SliderInt("Noise Freq X", &S.noise_freq_x, 1, 10);
         changing |= ImGui::SliderInt("Noise Freq Y", &S.noise_freq_y, 1, 10);
+        changing |= Noise::DrawImGui(S.noise);
         changing |= ImGui::Checkbox("Circular", &S.circular);
   
 
@@ -422,7 +852,39 @@ public:
         return changing;
     }
 
-    void SlashTrail(DXE::Texture* texture, double time, Parameters s) {
+    // the kernel doesn't read bias or brightness, sweeping them would give identical cells
+    static constexpr SweepField<Parameters> Fields[] = {
+        { "RA", &Parameters::ra }, { "RB", &Parameters::rb }, { "Noise Scale", &Parameters::noise_scale },
+        { "Noise Freq X", nullptr, &Parameters::noise_freq_x }, { "Noise Freq Y", nullptr, &Parameters::noise_freq_y },
+    };
+    std::vector<const char*> SweepFields() const override {
+        std::vector<const char*> names;
+        for (auto& f : Fields) names.push_back(f.Name);
+        return names;
+    }
+    float GetSweepField(int field) const override { return Fields[field].Get(S); }
+    void SetSweepField(int field, float value) override { Fields[field].Set(S, value); }
+
+    void GenerateVariantsTile(const std::vector<Draw::ImageView>& targets, const SweepBatch& batch, double t, int y0, int y1, KernelVariant variant) override {
+        if (variant != KernelVariant::Simd) { IFrameGenerator::GenerateVariantsTile(targets, batch, t, y0, y1, variant); return; }
+        std::vector<Parameters> variants(batch.Count(), S);
+        for (int v = 0; v < batch.Count(); v++) {
+            for (int f = 0; f < (int)batch.Fields.size(); f++) Fields[batch.Fields[f]].Set(variants[v], batch.Value(v, f));
+        }
+        SlashTrailSweepRows(targets, t, variants, y0, y1);
+    }
+
+    // Picks the scalar kernel for what holds over the whole call: the ring mapping, the
+    // distortion (none at all when noise_scale is 0, the default; sines or lattice noise
+    // otherwise) and equal radii, where the capsule is a plain rounded segment.
+    void SlashTrail(const Draw::ImageView& target, double time, const Parameters& s, int y0, int y1) {
+        WithFlags([&](auto circular, auto distorted, auto sine, auto equalRadii) {
+            SlashTrailRows<decltype(circular)::value, decltype(distorted)::value, decltype(sine)::value, decltype(equalRadii)::value>(target, time, s, y0, y1);
+        }, s.circular, s.noise_scale != 0.f, s.noise.type == Noise::Type::Sine, s.ra == s.rb);
+    }
+
+    template<bool Circular, bool Distorted, bool Sine, bool EqualRadii>
+    void SlashTrailRows(const Draw::ImageView& target, double time, const Parameters& s, int y0, int y1) {
         DXM::Vector2 pa = s.pa;
         DXM::Vector2 pb = s.pb;
         float ra = s.ra;
@@ -431,7 +893,8 @@ public:
         float noise_scale = s.noise_scale;
         int noise_freq_x = s.noise_freq_x;
         int noise_freq_y = s.noise_freq_y;
-
+        std::shared_ptr<const Noise::Prepared> noise;
+        if constexpr (Distorted && !Sine) { noise = NoiseCache.Get(s.noise, (float)time, false, NoiseCellPixels(s, target.Width)); }
 
         auto sdUnevenCapsule = [](DXM::Vector2 p, DXM::Vector2 pa, DXM::Vector2 pb, float ra, float rb) {
 
@@ -439,6 +902,11 @@ public:
             pb -= pa;
             float h = pb.Dot(pb);
 
+            if constexpr (EqualRadii) {
+                // no end caps of their own to pick between, the distance to the segment
+                float along = std::clamp(p.Dot(pb) / h, 0.f, 1.f);
+                return (p - pb * along).Length() - ra;
+            }
 
             DXM::Vector2  q = DXM::Vector2(p.Dot(DXM::Vector2(pb.y, -pb.x)), p.Dot(pb)) / h;
 
@@ -458,39 +926,52 @@ public:
             return m - ra;
             };
 
-        int width = texture->Width();
-        int height = texture->Height();
-        int channels = texture->Channels();
-        auto& pixels = texture->Pixels();
+        int width = target.Width;
+        int height = target.Height;
+        int channels = target.Channels;
+        Draw::RingMap ring(width, height);
 
-        for (int Y = 0; Y < height; Y++) {
+        //time = std::clamp(time, 0.f, 1.f);
+        double u = (1 - time);
+        double t = 1 - u * u * u * u;
+        DXM::Vector2 end_pos = pa * (1 - t) + (t)*pb;
+        float end_rad = ra * (1 - t) + (t)*rb;
+
+        for (int Y = y0; Y < y1; Y++) {
+            uint8_t* row = target.Row(Y);
             for (int X = 0; X < width; X++) {
                 //access rgba components
-                int pixelIndex = (Y * width + X) * channels;
-                auto& pixel = pixels[pixelIndex];
-                unsigned char& r = pixels[pixelIndex + 0];
-                unsigned char& g = pixels[pixelIndex + 1];
-                unsigned char& b = pixels[pixelIndex + 2];
-                unsigned char& a = pixels[pixelIndex + 3];
+                uint8_t* pixel = row + (size_t)X * channels;
+                unsigned char& r = pixel[0];
+                unsigned char& g = pixel[1];
+                unsigned char& b = pixel[2];
+                unsigned char& a = pixel[3];
 
                 // scale coords to -1 <= 0 <= 1
                 DXM::Vector2 p = { (float)X / (width - 1), (float)Y / (height - 1) };
                 p = 2.f * p - DXM::Vector2(1.f, 1.f);
+                if (Circular && !ring.Map(X, Y, p.x, p.y)) {
+                    r = g = b = a = 0;
+                    continue;
+                }
 
-                p.x += noise_scale * std::sin(DXM::Pi * noise_freq_x * (p.x + 2 * time));
-                p.y += noise_scale * std::sin(DXM::Pi * noise_freq_y * (p.y + 2 * time));
+                if constexpr (Distorted && Sine) {
+                    p.x += noise_scale * std::sin(DXM::Pi * noise_freq_x * (p.x + 2 * time));
+                    p.y += noise_scale * std::sin(DXM::Pi * noise_freq_y * (p.y + 2 * time));
+                }
+                else if constexpr (Distorted) {
+                    // x and y distortion read the same field at two far apart offsets
+                    float nx = noise_freq_x * p.x, ny = noise_freq_y * p.y;
+                    float dx = Noise::Sample(*noise, nx, ny);
+                    float dy = Noise::Sample(*noise, nx + 31.7f, ny + 47.3f);
+                    p.x += noise_scale * dx;
+                    p.y += noise_scale * dy;
+                }
 
-                //time = std::clamp(time, 0.f, 1.f);
-                double u = (1 - time);
-                double t = 1 - u * u * u * u;
-                DXM::Vector2 end_pos = pa * (1 - t) + (t)*pb;
-                float end_rad = ra * (1 - t) + (t)*rb;
+                // brighten, value is never negative
                 float value = std::max(0.f, -sdUnevenCapsule(p, pa, end_pos, ra, end_rad));
-
-
-                // brighten
-                if (value > 0) { value = std::clamp(8.f * value, 0.f, 1.f); }
-                uint8_t col = std::clamp((int)(255 * value), 0, 255);
+                value = std::min(8.f * value, 1.f);
+                uint8_t col = (uint8_t)(int)(255 * value);
 
                 r = col;
                 g = col;
@@ -499,9 +980,201 @@ public:
 
             }
         }
+    }
+
+    // Pixels across a first octave lattice cell: x spans 2 over width - 1 pixels and the noise
+    // has noise_freq cells per unit of x. Octaves finer than a couple of pixels are dropped.
+    static float NoiseCellPixels(const Parameters& s, int width) {
+        return (width - 1) / (2.f * std::max({ s.noise_freq_x, s.noise_freq_y, 1 }));
+    }
+
+    // Same shape as SlashTrail, laid out for the vectorizer: time-only terms are hoisted,
+    // the sine x distortion is computed once per column, lattice noise a row at a time,
+    // and the capsule branches become selects. With sdfRange set it writes the raw capsule
+    // distance instead of the brightened mask.
+    void SlashTrailRowsSimd(const Draw::ImageView& target, double time, const Parameters& s, int y0, int y1, float sdfRange = 0.f) {
+        SlashTrailSweepRows({ target }, time, { s }, y0, y1, sdfRange);
+    }
+
+    // capsule terms that only depend on the parameters and time
+    struct CapsuleTerms {
+        float pax, pay;
+        float bax, bay;
+        float h, inv_h;
+        float cb, cx;
+        float ra, rb;
+
+        static CapsuleTerms For(const Parameters& s, double time) {
+            double u = (1 - time);
+            float t = (float)(1 - u * u * u * u);
+            DXM::Vector2 end_pos = s.pa * (1 - t) + t * s.pb;
+            DXM::Vector2 ba = end_pos - s.pa;
+            CapsuleTerms c;
+            c.pax = s.pa.x;
+            c.pay = s.pa.y;
+            c.bax = ba.x;
+            c.bay = ba.y;
+            c.h = ba.Dot(ba);
+            c.inv_h = 1.f / c.h;
+            c.ra = s.ra;
+            c.rb = s.ra * (1 - t) + t * s.rb;
+            c.cb = c.ra - c.rb;
+            c.cx = std::sqrt(c.h - c.cb * c.cb);
+            return c;
+        }
+    };
+
+    // One row of the capsule over distorted coordinates px, py: the raw distance with
+    // Distance set, the brightened mask otherwise. With equal radii there is no cap to pick,
+    // the distance is to the segment, qy clamped to it.
+    template<bool EqualRadii, bool Distance>
+    static void CapsuleRow(const CapsuleTerms& c, const float* xs, const float* ys, float* values, int width) {
+        for (int X = 0; X < width; X++) {
+            float px = xs[X] - c.pax;
+            float py = ys[X] - c.pay;
+            float qx = std::fabs((px * c.bay - py * c.bax) * c.inv_h);
+            float qy = (px * c.bax + py * c.bay) * c.inv_h;
+
+            float d;
+            if constexpr (EqualRadii) {
+                float e = qy - std::clamp(qy, 0.f, 1.f);
+                d = std::sqrt(c.h * (qx * qx + e * e)) - c.ra;
+            }
+            else {
+                float k = c.cx * qy - c.cb * qx;
+                float m = c.cx * qx + c.cb * qy;
+                float n = qx * qx + qy * qy;
+
+                float d_start = std::sqrt(c.h * n) - c.ra;
+                float d_end = std::sqrt(std::max(0.f, c.h * (n + 1.0f - 2.0f * qy))) - c.rb;
+                d = (k < 0.f) ? d_start : ((k > c.cx) ? d_end : m - c.ra);
+            }
+
+            if constexpr (Distance) { values[X] = d; }
+            else { values[X] = std::min(8.f * std::max(0.f, -d), 1.f); }
+        }
+    }
+    using CapsuleRowFn = void (*)(const CapsuleTerms&, const float*, const float*, float*, int);
+    static CapsuleRowFn CapsuleRowFor(const CapsuleTerms& c, bool distance) {
+        CapsuleRowFn fn = nullptr;
+        WithFlags([&](auto equalRadii, auto raw) { fn = &CapsuleRow<decltype(equalRadii)::value, decltype(raw)::value>; }, c.ra == c.rb, distance);
+        return fn;
+    }
+
+    // Rows [y0, y1) of several parameter variants at once, one target each.
+    void SlashTrailSweepRows(const std::vector<Draw::ImageView>& targets, double time, const std::vector<Parameters>& variants, int y0, int y1, float sdfRange = 0.f) {
+        int width = targets[0].Width;
+        int channels = targets[0].Channels;
+        if (sdfRange > 0.f) {
+            SlashTrailRowValues(width, targets[0].Height, time, variants, y0, y1, true, [&](int v, int Y, int x0, int n, const float* d) {
+                uint8_t* row = targets[v].Row(Y);
+                if (n < width) { std::memset(row, 0, (size_t)width * channels); }
+                for (int i = 0; i < n; i++) {
+                    uint8_t col = Draw::EncodeDistance(d[i], sdfRange);
+                    for (int c = 0; c < channels; c++) { row[(size_t)(x0 + i) * channels + c] = col; }
+                }
+            });
+        }
+        else {
+            SlashTrailRowValues(width, targets[0].Height, time, variants, y0, y1, false, [&](int v, int Y, int x0, int n, const float* mask) {
+                Draw::WriteMaskRow(targets[v].Row(Y), width, channels, x0, n, mask);
+            });
+        }
+    }
+
+    // The capsule of every variant over rows [y0, y1), handed to emit(variant, row, x0, n,
+    // values) a row at a time: the distance with distance set, the brightened mask otherwise.
+    // The distortion (sines or lattice noise) is the expensive part and depends only on the
+    // noise fields, so variants that agree on them share one evaluation per row and only run
+    // the capsule.
+    template<typename Emit>
+    void SlashTrailRowValues(int width, int height, double time, const std::vector<Parameters>& variants, int y0, int y1, bool distance, Emit&& emit) {
+        int count = (int)variants.size();
+        float ft = (float)time;
+
+        std::vector<CapsuleTerms> capsules(count);
+        std::vector<CapsuleRowFn> capsuleRows(count);
+        for (int v = 0; v < count; v++) {
+            capsules[v] = CapsuleTerms::For(variants[v], time);
+            capsuleRows[v] = CapsuleRowFor(capsules[v], distance);
+        }
+
+        // each variant renders with the distortion of the first variant that has the same one
+        std::vector<int> leader = SweepGroups(variants, [](const Parameters& a, const Parameters& b) {
+            return a.noise_scale == b.noise_scale && a.noise_freq_x == b.noise_freq_x && a.noise_freq_y == b.noise_freq_y;
+        });
+
+        // the noise field and the ring mode are never swept; the octaves a group keeps depend on
+        // its frequencies, so each group gets its own prepared noise
+        bool sine = variants[0].noise.type == Noise::Type::Sine;
+        bool polar = variants[0].circular;
+        std::vector<std::shared_ptr<const Noise::Prepared>> noise(count);
+        for (int g = 0; g < count && !sine; g++) {
+            if (leader[g] == g) noise[g] = NoiseCache.Get(variants[g].noise, ft, false, NoiseCellPixels(variants[g], width));
+        }
+        Draw::RingMap ring(width, height);
+
+        std::vector<float> xs(width), ys(width);
+        for (int X = 0; X < width; X++) { xs[X] = 2.f * X / (width - 1) - 1.f; }
+        std::vector<std::vector<float>> sineXs(sine && !polar ? count : 0);
+        for (int g = 0; g < (int)sineXs.size(); g++) {
+            if (leader[g] != g || variants[g].noise_scale == 0.f) continue;
+            const Parameters& s = variants[g];
+            sineXs[g].resize(width);
+            for (int X = 0; X < width; X++) { sineXs[g][X] = xs[X] + s.noise_scale * std::sin(DXM::Pi * s.noise_freq_x * (xs[X] + 2.f * ft)); }
+        }
+
+        std::vector<float> us(polar ? width : 0);
+        std::vector<float> px(width), py(width), values(width);
+        std::vector<float> lx, ly, dx, dy;
+        if (!sine) { lx.resize(width); ly.resize(width); dx.resize(width); dy.resize(width); }
+
+        for (int Y = y0; Y < y1; Y++) {
+            // frame coordinates of the row's pixels [x0, x0 + n): the grid, or the ring's polar points
+            int x0 = 0;
+            int n = width;
+            const float* cx = xs.data();
+            if (polar) { n = ring.Row(Y, width, us.data(), ys.data(), x0); cx = us.data(); }
+            else { std::fill(ys.begin(), ys.end(), 2.f * Y / (height - 1) - 1.f); }
+
+            for (int g = 0; g < count; g++) {
+                if (leader[g] != g) continue;
+                const Parameters& s = variants[g];
+                const float* rowX = px.data();
+                const float* rowY = py.data();
+                if (s.noise_scale == 0.f) {
+                    // undistorted, the frame coordinates as they are
+                    rowX = cx;
+                    rowY = ys.data();
+                }
+                else if (sine && !polar) {
+                    rowX = sineXs[g].data();
+                    std::fill(py.begin(), py.end(), ys[0] + s.noise_scale * std::sin(DXM::Pi * s.noise_freq_y * (ys[0] + 2.f * ft)));
+                }
+                else if (sine) {
+                    for (int i = 0; i < n; i++) {
+                        px[i] = cx[i] + s.noise_scale * std::sin(DXM::Pi * s.noise_freq_x * (cx[i] + 2.f * ft));
+                        py[i] = ys[i] + s.noise_scale * std::sin(DXM::Pi * s.noise_freq_y * (ys[i] + 2.f * ft));
+                    }
+                }
+                else {
+                    for (int i = 0; i < n; i++) { lx[i] = s.noise_freq_x * cx[i]; ly[i] = s.noise_freq_y * ys[i]; }
+                    Noise::Evaluate(*noise[g], lx.data(), ly.data(), dx.data(), n);
+                    for (int i = 0; i < n; i++) { lx[i] += 31.7f; ly[i] += 47.3f; }
+                    Noise::Evaluate(*noise[g], lx.data(), ly.data(), dy.data(), n);
+                    for (int i = 0; i < n; i++) {
+                        px[i] = cx[i] + s.noise_scale * dx[i];
+                        py[i] = ys[i] + s.noise_scale * dy[i];
+                    }
+                }
 
-        if (s.circular) { Draw::RectangleToRing(texture); }
-   
+                for (int v = g; v < count; v++) {
+                    if (leader[v] != g) continue;
+                    capsuleRows[v](capsules[v], rowX, rowY, values.data(), n);
+                    emit(v, Y, x0, n, values.data());
+                }
+            }
+        }
     }
 };
 
@@ -522,17 +1195,68 @@ public:
         float noise_scale_y = 0.325f;
         float noise_freq_x = 24.f;
         float noise_freq_y = 48.f;
+        Noise::Field noise;
 
         float brightness = 2.f;
         float bias = 0.01f;
         bool inverted = false;
         bool circular = false;
     } S;
+    // noise octaves for the frames being rendered, shared by all their tiles
+    Noise::PreparedCache NoiseCache;
 
     const char* GetName() const override { return "Lightning Beam"; }
     bool IsLooping() override { return true; }
-    void Generate(DXE::Texture* tex, double t) override {
-        LightningBeam(tex, t, S);
+    std::unique_ptr<IFrameGenerator> Clone() const override { return std::make_unique<LightningBeamGenerator>(*this); }
+    bool HasSimdKernel() const override { return true; }
+    bool HasSequenceKernel() const override { return true; }
+
+    void GenerateTile(const Draw::ImageView& target, double t, int y0, int y1, KernelVariant variant) override {
+        if (variant == KernelVariant::Simd) { LightningBeamRowsSimd(target, t, S, y0, y1); }
+        else { LightningBeam(target, t, S, y0, y1); }
+    }
+    // moving lattice noise changes every frame, nothing left to share
+    void GenerateSequenceTile(const std::vector<Draw::ImageView>& targets, const std::vector<double>& times, int y0, int y1, KernelVariant variant) override {
+        bool still = S.noise.type == Noise::Type::Sine || S.noise.speed == 0.f;
+        if (variant == KernelVariant::Simd && still) { LightningBeamSequenceRows(targets, times, S, y0, y1); }
+        else { IFrameGenerator::GenerateSequenceTile(targets, times, y0, y1, variant); }
+    }
+    bool VisitState(StateVisitor& visitor) override {
+        visitor.Visit("speed", S.speed);
+        visitor.Visit("freq", S.freq);
+        visitor.Visit("amps", S.amps);
+        visitor.Visit("offset", S.offset);
+        visitor.Visit("angle", S.angle);
+        visitor.Visit("height", S.height);
+        visitor.Visit("noise_scale_x", S.noise_scale_x);
+        visitor.Visit("noise_scale_y", S.noise_scale_y);
+        visitor.Visit("noise_freq_x", S.noise_freq_x);
+        visitor.Visit("noise_freq_y", S.noise_freq_y);
+        visitor.Visit("noise", S.noise);
+        visitor.Visit("brightness", S.brightness);
+        visitor.Visit("bias", S.bias);
+        visitor.Visit("inverted", S.inverted);
+        visitor.Visit("circular", S.circular);
+        return true;
+    }
+    // the field is the beam before bias and brightness
+    bool HasFieldKernel() const override { return true; }
+    void GenerateFieldTile(float* field, int width, int height, double t, int y0, int y1, KernelVariant variant) override {
+        LightningBeamRowValues<true>(width, height, t, { S }, y0, y1, [&](int, int Y, int x0, int n, const float* values) {
+            Draw::WriteFieldRow(field + (size_t)(Y - y0) * width, width, x0, n, values, 1.f);
+        });
+    }
+    MaskOutput FieldMask() const override {
+        MaskOutput mask;
+        mask.Bias = S.bias;
+        mask.Brightness = S.brightness;
+        return mask;
+    }
+    // time only moves the triangle wave, by a whole number of periods a loop; moving lattice
+    // noise is only known to loop once
+    int Repeats() const override {
+        if (S.noise.type != Noise::Type::Sine && S.noise.speed != 0.f) return 1;
+        return std::abs(S.speed);
     }
 
     bool DrawImGui() override {
@@ -550,6 +1274,7 @@ public:
 
         changing |= ImGui::SliderFloat("Noise Scale Y", &S.noise_scale_y, -1.f, 1.f);
         changing |= ImGui::SliderFloat("Noise Frequency Y", &S.noise_freq_y, 0.f, 100.f);
+        changing |= Noise::DrawImGui(S.noise);
 
         changing |= ImGui::SliderFloat("Height", &S.height, 0.f, 1.f);
         changing |= ImGui::SliderFloat("Bias", &S.bias, 0.f, 1.f);
@@ -561,7 +1286,40 @@ public:
 
     }
 
-    void LightningBeam(DXE::Texture* texture, double time, Parameters s) {
+    static constexpr SweepField<Parameters> Fields[] = {
+        { "Speed", nullptr, &Parameters::speed }, { "Frequency", &Parameters::freq }, { "Amps", &Parameters::amps },
+        { "Offset", &Parameters::offset }, { "Angle", &Parameters::angle }, { "Height", &Parameters::height },
+        { "Noise Scale X", &Parameters::noise_scale_x }, { "Noise Scale Y", &Parameters::noise_scale_y },
+        { "Noise Frequency X", &Parameters::noise_freq_x }, { "Noise Frequency Y", &Parameters::noise_freq_y },
+        { "Brightness", &Parameters::brightness }, { "Bias", &Parameters::bias },
+    };
+    std::vector<const char*> SweepFields() const override {
+        std::vector<const char*> names;
+        for (auto& f : Fields) names.push_back(f.Name);
+        return names;
+    }
+    float GetSweepField(int field) const override { return Fields[field].Get(S); }
+    void SetSweepField(int field, float value) override { Fields[field].Set(S, value); }
+
+    void GenerateVariantsTile(const std::vector<Draw::ImageView>& targets, const SweepBatch& batch, double t, int y0, int y1, KernelVariant variant) override {
+        if (variant != KernelVariant::Simd) { IFrameGenerator::GenerateVariantsTile(targets, batch, t, y0, y1, variant); return; }
+        std::vector<Parameters> variants(batch.Count(), S);
+        for (int v = 0; v < batch.Count(); v++) {
+            for (int f = 0; f < (int)batch.Fields.size(); f++) Fields[batch.Fields[f]].Set(variants[v], batch.Value(v, f));
+        }
+        LightningBeamSweepRows(targets, t, variants, y0, y1);
+    }
+
+    // Picks the scalar kernel for what holds over the whole call: the ring mapping, the
+    // polarity, whether there is any distortion and whether it is sines or lattice noise.
+    void LightningBeam(const Draw::ImageView& target, double time, const Parameters& s, int y0, int y1) {
+        WithFlags([&](auto circular, auto inverted, auto distorted, auto sine) {
+            LightningBeamRows<decltype(circular)::value, decltype(inverted)::value, decltype(distorted)::value, decltype(sine)::value>(target, time, s, y0, y1);
+        }, s.circular, s.inverted, s.noise_scale_x != 0.f || s.noise_scale_y != 0.f, s.noise.type == Noise::Type::Sine);
+    }
+
+    template<bool Circular, bool Inverted, bool Distorted, bool Sine>
+    void LightningBeamRows(const Draw::ImageView& target, double time, const Parameters& s, int y0, int y1) {
 
         auto triangleWave = [](float x) { 
             float X = x - std::floor(x);
@@ -575,24 +1333,31 @@ public:
             return DXM::Vector2(x*cos-y*sin,x*sin+y*cos);
             };
 
-        int width = texture->Width();
-        int height = texture->Height();
-        int channels = texture->Channels();
-        auto& pixels = texture->Pixels();
+        int width = target.Width;
+        int height = target.Height;
+        int channels = target.Channels;
+        std::shared_ptr<const Noise::Prepared> noise;
+        if constexpr (Distorted && !Sine) { noise = NoiseCache.Get(s.noise, (float)time, true, NoiseCellPixels(s, width)); }
+        Draw::RingMap ring(width, height);
+        const float polarity = Inverted ? -1.f : 1.f;
 
-        for (int Y = 0; Y < height; Y++) {
+        for (int Y = y0; Y < y1; Y++) {
+            uint8_t* row = target.Row(Y);
             for (int X = 0; X < width; X++) {
                 //access rgba components
-                int pixelIndex = (Y * width + X) * channels;
-                auto& pixel = pixels[pixelIndex];
-                unsigned char& r = pixels[pixelIndex + 0];
-                unsigned char& g = pixels[pixelIndex + 1];
-                unsigned char& b = pixels[pixelIndex + 2];
-                unsigned char& a = pixels[pixelIndex + 3];
+                uint8_t* pixel = row + (size_t)X * channels;
+                unsigned char& r = pixel[0];
+                unsigned char& g = pixel[1];
+                unsigned char& b = pixel[2];
+                unsigned char& a = pixel[3];
 
                 // scale coords to -1 <= 0 <= 1
                 DXM::Vector2 p = { (float)X / (width - 1), (float)Y / (height - 1) };
                 p = 2.f * p - DXM::Vector2(1.f, 1.f);
+                if (Circular && !ring.Map(X, Y, p.x, p.y)) {
+                    r = g = b = a = 0;
+                    continue;
+                }
 
 
 
@@ -600,20 +1365,28 @@ public:
                 DXM::Vector2 p_rot = rotateXY(p.x, p.y, s.angle);
                 p_rot.y += s.offset;
 
-                float noise_x = 1 + s.noise_scale_x * sin(s.noise_freq_x * (p_rot.x));
-                float noise_y = 1.f/(1 - s.noise_scale_y * cos(s.noise_freq_y * (p_rot.y)));
+                float noise_x = 1.f, noise_y = 1.f;
+                if constexpr (Distorted && Sine) {
+                    noise_x = 1 + s.noise_scale_x * sin(s.noise_freq_x * (p_rot.x));
+                    noise_y = 1.f/(1 - s.noise_scale_y * cos(s.noise_freq_y * (p_rot.y)));
+                }
+                else if constexpr (Distorted) {
+                    // one lattice cell per half wave of the sine it replaces, looped over the animation
+                    float lx = s.noise_freq_x * p_rot.x / DXM::Pi;
+                    float ly = s.noise_freq_y * p_rot.y / DXM::Pi;
+                    noise_x = 1 + s.noise_scale_x * Noise::Sample(*noise, lx, 0.f);
+                    noise_y = 1.f / (1 - s.noise_scale_y * Noise::Sample(*noise, 53.9f, ly));
+                }
 
                 float pos_x = triangleWave(s.freq * p_rot.x * noise_x + s.speed * time);
                 float pos_y = (2.f / s.amps) * p_rot.y * noise_y;
 
                 float env = std::max(0.f, circleEnvelope(p.x, p.y, s.height));
 
-                float polarity = (s.inverted) ? -1.f : 1.f;
-
                 float value = polarity*lineSlope(pos_x,pos_y,s.height)*env - s.bias;
-                // brighten
-                if (value > 0) { value = std::clamp(s.brightness * value, 0.f, 1.f); }
-                uint8_t col = std::clamp((int)(255 * value), 0, 255);
+                // brighten, what was at or below zero stays black
+                value = std::clamp(s.brightness * std::max(value, 0.f), 0.f, 1.f);
+                uint8_t col = (uint8_t)(int)(255 * value);
 
                 r = col;
                 g = col;
@@ -622,8 +1395,198 @@ public:
 
             }
         }
+    }
+
+    // Pixels across a first octave lattice cell: the rotated coordinates span 2 over width - 1
+    // pixels and the noise has noise_freq / pi cells per unit of them. Octaves finer than a
+    // couple of pixels are dropped.
+    static float NoiseCellPixels(const Parameters& s, int width) {
+        float frequency = std::max(std::fabs(s.noise_freq_x), std::fabs(s.noise_freq_y));
+        return frequency > 0.f ? (width - 1) * DXM::Pi / (2.f * frequency) : 0.f;
+    }
 
-        if (s.circular) { Draw::RectangleToRing(texture); }
+    // Same beam as LightningBeam written as straight float loops over a row so the
+    // compiler can vectorize them (MSVC maps sinf/cosf onto its SVML routines).
+    void LightningBeamRowsSimd(const Draw::ImageView& target, double time, const Parameters& s, int y0, int y1) {
+        LightningBeamSweepRows({ target }, time, { s }, y0, y1);
+    }
+
+    // Rows [y0, y1) of several parameter variants at once, one target each.
+    void LightningBeamSweepRows(const std::vector<Draw::ImageView>& targets, double time, const std::vector<Parameters>& variants, int y0, int y1) {
+        int width = targets[0].Width;
+        int channels = targets[0].Channels;
+        LightningBeamRowValues<false>(width, targets[0].Height, time, variants, y0, y1, [&](int v, int Y, int x0, int n, const float* mask) {
+            Draw::WriteMaskRow(targets[v].Row(Y), width, channels, x0, n, mask);
+        });
+    }
 
+    // The beam of every variant over rows [y0, y1), handed to emit(variant, row, x0, n, values)
+    // a row at a time: the field before bias and brightness with Field set, the mask otherwise.
+    // The rotated coordinates and the distortion waves (a sine and a cosine, or two noise
+    // lookups per pixel) only depend on angle, offset and the noise frequencies; variants that
+    // agree on those share them and each pays only for the beam itself.
+    template<bool Field, typename Emit>
+    void LightningBeamRowValues(int width, int height, double time, const std::vector<Parameters>& variants, int y0, int y1, Emit&& emit) {
+        int count = (int)variants.size();
+
+        std::vector<int> leader = SweepGroups(variants, [](const Parameters& a, const Parameters& b) {
+            return a.angle == b.angle && a.offset == b.offset && a.noise_freq_x == b.noise_freq_x && a.noise_freq_y == b.noise_freq_y;
+        });
+
+        bool sine = variants[0].noise.type == Noise::Type::Sine;
+        bool polar = variants[0].circular;
+        std::vector<std::shared_ptr<const Noise::Prepared>> noise(count);
+        for (int g = 0; g < count && !sine; g++) {
+            if (leader[g] == g) noise[g] = NoiseCache.Get(variants[g].noise, (float)time, true, NoiseCellPixels(variants[g], width));
+        }
+        Draw::RingMap ring(width, height);
+        std::vector<float> xs(width), ys(width), us(polar ? width : 0);
+        std::vector<float> rx(width), ry(width), waveX(width), waveY(width), values(width);
+        std::vector<float> lx, ly, lz;
+        if (!sine) { lx.resize(width); ly.resize(width); lz.resize(width); }
+        for (int X = 0; X < width; X++) { xs[X] = 2.f * X / (width - 1) - 1.f; }
+
+        for (int Y = y0; Y < y1; Y++) {
+            // frame coordinates of the row's pixels [x0, x0 + n): the grid, or the ring's polar points
+            int x0 = 0;
+            int n = width;
+            const float* cx = xs.data();
+            if (polar) { n = ring.Row(Y, width, us.data(), ys.data(), x0); cx = us.data(); }
+            else { std::fill(ys.begin(), ys.end(), 2.f * Y / (height - 1) - 1.f); }
+
+            for (int g = 0; g < count; g++) {
+                if (leader[g] != g) continue;
+                const Parameters& s = variants[g];
+                float cos_a = std::cos(s.angle);
+                float sin_a = std::sin(s.angle);
+                for (int X = 0; X < n; X++) {
+                    rx[X] = cx[X] * cos_a - ys[X] * sin_a;
+                    ry[X] = cx[X] * sin_a + ys[X] * cos_a + s.offset;
+                }
+                if (sine) {
+                    for (int X = 0; X < n; X++) {
+                        waveX[X] = std::sin(s.noise_freq_x * rx[X]);
+                        waveY[X] = std::cos(s.noise_freq_y * ry[X]);
+                    }
+                }
+                else {
+                    for (int X = 0; X < n; X++) {
+                        lx[X] = s.noise_freq_x * rx[X] / DXM::Pi;
+                        ly[X] = s.noise_freq_y * ry[X] / DXM::Pi;
+                    }
+                    std::fill(lz.begin(), lz.end(), 0.f);
+                    Noise::Evaluate(*noise[g], lx.data(), lz.data(), waveX.data(), n);
+                    std::fill(lz.begin(), lz.end(), 53.9f);
+                    Noise::Evaluate(*noise[g], lz.data(), ly.data(), waveY.data(), n);
+                }
+
+                for (int v = g; v < count; v++) {
+                    if (leader[v] != g) continue;
+                    const Parameters& p = variants[v];
+                    float phase = (float)(p.speed * time);
+                    float polarity = (p.inverted) ? -1.f : 1.f;
+                    float amp_scale = 2.f / p.amps;
+
+                    for (int X = 0; X < n; X++) {
+                        float x = cx[X];
+                        float y = ys[X];
+                        float noise_x = 1.f + p.noise_scale_x * waveX[X];
+                        float noise_y = 1.f / (1.f - p.noise_scale_y * waveY[X]);
+
+                        float w = p.freq * rx[X] * noise_x + phase;
+                        float pos_x = std::fabs(4.f * (w - std::floor(w)) - 2.f) - 1.f;
+                        float pos_y = amp_scale * ry[X] * noise_y;
+
+                        float env = std::max(0.f, p.height - (x * x + y * y));
+                        float slope = (p.height - 1.f) + (2.f / (1.f + std::fabs(pos_x + pos_y)) - 1.f);
+
+                        float field = polarity * slope * env;
+                        if constexpr (Field) { values[X] = field; }
+                        else { values[X] = std::clamp(p.brightness * (field - p.bias), 0.f, 1.f); }
+                    }
+                    emit(v, Y, x0, n, values.data());
+                }
+            }
+        }
+    }
+
+    // Rows [y0, y1) of several frames at once, for sine or still noise distortion. Only the
+    // triangle wave's phase moves with time: the rotated coordinates, the envelope, the distorted
+    // wave argument and the beam offset are built once per row and reused by every frame.
+    void LightningBeamSequenceRows(const std::vector<Draw::ImageView>& targets, const std::vector<double>& times, const Parameters& s, int y0, int y1) {
+        int frames = (int)targets.size();
+        int width = targets[0].Width;
+        int height = targets[0].Height;
+        int channels = targets[0].Channels;
+
+        bool sine = s.noise.type == Noise::Type::Sine;
+        std::shared_ptr<const Noise::Prepared> noise;
+        if (!sine) { noise = NoiseCache.Get(s.noise, (float)times[0], true, NoiseCellPixels(s, width)); }
+        Draw::RingMap ring(width, height);
+
+        std::vector<float> xs(width), ys(width), us(s.circular ? width : 0);
+        std::vector<float> rx(width), ry(width), env(width), waveX(width), waveY(width);
+        std::vector<float> argX(width), posY(width), values(width);
+        std::vector<float> lx, ly, lz;
+        if (!sine) { lx.resize(width); ly.resize(width); lz.resize(width); }
+        for (int X = 0; X < width; X++) { xs[X] = 2.f * X / (width - 1) - 1.f; }
+
+        float cos_a = std::cos(s.angle);
+        float sin_a = std::sin(s.angle);
+        float polarity = (s.inverted) ? -1.f : 1.f;
+        float amp_scale = 2.f / s.amps;
+
+        for (int Y = y0; Y < y1; Y++) {
+            int x0 = 0;
+            int n = width;
+            const float* cx = xs.data();
+            if (s.circular) { n = ring.Row(Y, width, us.data(), ys.data(), x0); cx = us.data(); }
+            else { std::fill(ys.begin(), ys.end(), 2.f * Y / (height - 1) - 1.f); }
+
+            for (int X = 0; X < n; X++) {
+                float x = cx[X];
+                float y = ys[X];
+                rx[X] = x * cos_a - y * sin_a;
+                ry[X] = x * sin_a + y * cos_a + s.offset;
+                env[X] = std::max(0.f, s.height - (x * x + y * y));
+            }
+
+            // the wave argument before the phase, and the beam's vertical position
+            if (sine) {
+                for (int X = 0; X < n; X++) {
+                    waveX[X] = std::sin(s.noise_freq_x * rx[X]);
+                    waveY[X] = std::cos(s.noise_freq_y * ry[X]);
+                }
+            }
+            else {
+                for (int X = 0; X < n; X++) {
+                    lx[X] = s.noise_freq_x * rx[X] / DXM::Pi;
+                    ly[X] = s.noise_freq_y * ry[X] / DXM::Pi;
+                }
+                std::fill(lz.begin(), lz.end(), 0.f);
+                Noise::Evaluate(*noise, lx.data(), lz.data(), waveX.data(), n);
+                std::fill(lz.begin(), lz.end(), 53.9f);
+                Noise::Evaluate(*noise, lz.data(), ly.data(), waveY.data(), n);
+            }
+            for (int X = 0; X < n; X++) {
+                float noise_x = 1.f + s.noise_scale_x * waveX[X];
+                float noise_y = 1.f / (1.f - s.noise_scale_y * waveY[X]);
+                argX[X] = s.freq * rx[X] * noise_x;
+                posY[X] = amp_scale * ry[X] * noise_y;
+            }
+
+            for (int f = 0; f < frames; f++) {
+                float phase = (float)(s.speed * times[f]);
+                for (int X = 0; X < n; X++) {
+                    float w = argX[X] + phase;
+                    float pos_x = std::fabs(4.f * (w - std::floor(w)) - 2.f) - 1.f;
+                    float slope = (s.height - 1.f) + (2.f / (1.f + std::fabs(pos_x + posY[X])) - 1.f);
+
+                    float value = polarity * slope * env[X] - s.bias;
+                    values[X] = std::clamp(s.brightness * value, 0.f, 1.f);
+                }
+                Draw::WriteMaskRow(targets[f].Row(Y), width, channels, x0, n, values.data());
+            }
+        }
     }
 };
\ No newline at end of file
@@ -0,0 +1,651 @@
+#pragma once
+#include <deque>
+#include <unordered_map>
+#include <string_view>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include "RenderJob.h"
+#include "FrameStore.h"
+#include "Png.h"
+#include "BlockCompress.h"
+#include "Animation.h"
+#include "Atlas.h"
+
+enum class ExportFormat { PngSequence, PngStrip, DdsSequence, Ktx2Sequence, Apng, Gif, Atlas };
+
+inline const char* ExportFormatName(ExportFormat format) {
+    switch (format) {
+    case ExportFormat::PngStrip: return "PNG Strip";
+    case ExportFormat::DdsSequence: return "DDS Sequence";
+    case ExportFormat::Ktx2Sequence: return "KTX2 Sequence";
+    case ExportFormat::Apng: return "APNG";
+    case ExportFormat::Gif: return "GIF";
+    case ExportFormat::Atlas: return "Atlas";
+    default: return "PNG Sequence";
+    }
+}
+
+struct ExportSettings {
+    ExportFormat Format = ExportFormat::PngSequence;
+    std::filesystem::path Folder = "Export";
+    std::string Name = "frame";     // file name prefix
+    int EncodeThreads = 0;          // 0: half the cores
+    int InFlight = 0;               // frames (or strip bands) alive between the stages, 0: encoders + 2
+    // DDS and KTX2 only
+    Bc::Format Block = Bc::Format::BC4;
+    Bc::Quality Quality = Bc::Quality::Fast;
+    bool Mips = true;               // the full chain down to 1x1
+    // APNG and GIF: repeat forever, otherwise play once and stay on the last frame
+    bool Loop = true;
+    // Atlas: largest page side, and clear pixels between sprites
+    int AtlasPage = 4096;
+    int AtlasPadding = 1;
+
+    bool IsSequence() const { return Format == ExportFormat::PngSequence || IsBlockCompressed(); }
+    bool IsBlockCompressed() const { return Format == ExportFormat::DdsSequence || Format == ExportFormat::Ktx2Sequence; }
+    bool IsAnimation() const { return Format == ExportFormat::Apng || Format == ExportFormat::Gif; }
+
+    int ResolveEncodeThreads() const {
+        return EncodeThreads > 0 ? EncodeThreads : std::max(1, (int)std::thread::hardware_concurrency() / 2);
+    }
+    int ResolveInFlight() const { return InFlight > 0 ? InFlight : ResolveEncodeThreads() + 2; }
+};
+
+// Export as three overlapped stages: the render job's workers generate into this sink, a pool
+// of encoders filters and deflates (or block compresses), and one writer thread does the file I/O.
+//
+// A sequence holds at most InFlight frames between the stages: the scheduler starts no frame
+// while CanAcquire says they're all taken (Acquire blocks only a worker that got past that),
+// so memory stays a few frames whatever the frame count and the slowest stage sets the pace. A strip can't write its first row before every frame is rendered, so
+// frames are kept zero-run coded as they finish and the strip is then encoded in row bands,
+// each an independent deflate piece, written in order as one zlib stream.
+//
+// An animation is packed the same way, with a color histogram taken on the way in. Once every
+// frame is in, the palette is built and each frame is coded against the one before it,
+// independently, so encoders work on several frames at once and the writer appends them.
+//
+// An atlas keeps each frame trimmed to its alpha bounds, one copy per distinct sprite. Once
+// every frame is in, the sprites are packed into pages, which encode as PNGs in parallel, and
+// the metadata follows the last page.
+//
+// Block compression splits a frame's block rows among encoders with nothing of their own to
+// encode, so a frame finishes sooner at the end of an export without adding threads to the
+// encoders and the render pool.
+class ExportPipeline : public FrameSink {
+public:
+    struct Stats {
+        int Generated = 0;
+        int Aliased = 0;            // frames the generator repeats, never rendered or encoded again
+        int Encoded = 0;            // frames, or strip bands
+        int Written = 0;
+        int Total = 0;              // items the writer expects
+        int PeakInFlight = 0;
+        uint64_t BytesWritten = 0;
+        double EncodeSeconds = 0;   // summed over encoders
+        double WriteSeconds = 0;
+        double ElapsedSeconds = 0;
+    };
+
+    ExportPipeline(int size, int frameCount, ExportSettings settings)
+        : size(size), frameCount(frameCount), Settings(std::move(settings)), InFlight(Settings.ResolveInFlight()),
+        Start(std::chrono::steady_clock::now())
+    {
+        if (Settings.Format == ExportFormat::PngStrip) {
+            // bands of about one frame's bytes, no more than 64 rows
+            BandRows = std::clamp(size / std::max(1, frameCount), 1, 64);
+            BandCount = (size + BandRows - 1) / BandRows;
+            Packed.resize(frameCount);
+            stats.Total = BandCount;
+        }
+        else if (Settings.IsAnimation()) {
+            BandRows = size;
+            BandCount = 1;
+            Packed.resize(frameCount);
+            stats.Total = frameCount;
+        }
+        else if (Settings.Format == ExportFormat::Atlas) {
+            FrameSprites.resize(frameCount);
+            FrameBounds.resize(frameCount);
+            stats.Total = frameCount;   // until packed: the pages and the metadata
+        }
+        else {
+            stats.Total = frameCount;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(Settings.Folder, ec);
+        for (int i = 0; i < Settings.ResolveEncodeThreads(); i++) { Encoders.emplace_back(&ExportPipeline::EncodeLoop, this, i); }
+        Writer = std::thread(&ExportPipeline::WriteLoop, this);
+    }
+
+    ~ExportPipeline() {
+        Cancel();
+        for (auto& encoder : Encoders) encoder.join();
+        if (Writer.joinable()) Writer.join();
+    }
+
+    int MaxHeld() const override { return InFlight; }
+    bool CanAcquire(int count) const override {
+        std::lock_guard<std::mutex> lock(Lock);
+        return Cancelled || Alive + count <= InFlight;
+    }
+
+    // generation stage, on render workers
+    Draw::ImageView Acquire(int frame) override {
+        PROFILE_SCOPE_FRAME("Export Wait", frame);
+        std::unique_lock<std::mutex> lock(Lock);
+        Changed.wait(lock, [&]() { return Cancelled || Alive < InFlight; });
+        // a cancelled job still drains its claimed tiles, they get a buffer that goes nowhere
+        auto pixels = std::make_shared<std::vector<uint8_t>>((size_t)size * size * 4);
+        if (!Cancelled) {
+            Alive++;
+            stats.PeakInFlight = std::max(stats.PeakInFlight, Alive);
+        }
+        Buffers[frame] = pixels;
+        return { pixels->data(), size, size, 4 };
+    }
+
+    // A repeated frame takes its source's encoded bytes in a sequence, its packed pixels in a
+    // strip or animation and its sprite in an atlas.
+    bool Alias(int frame, int source) override {
+        std::lock_guard<std::mutex> lock(Lock);
+        if (Cancelled) return true;
+        Copies[source].push_back(frame);
+        stats.Aliased++;
+        return true;
+    }
+
+    void Complete(int frame) override {
+        std::shared_ptr<std::vector<uint8_t>> pixels;
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            if (Cancelled) { Buffers.erase(frame); return; }
+            stats.Generated++;
+            if (Settings.IsSequence()) {
+                Pending.push_back(frame);
+                Changed.notify_all();
+                return;
+            }
+            pixels = std::move(Buffers[frame]);
+            Buffers.erase(frame);
+        }
+        if (Settings.Format == ExportFormat::Atlas) {
+            AddSprite(frame, { pixels->data(), size, size, 4 });
+            Changed.notify_all();
+            return;
+        }
+
+        // strip and animation: pack the frame now so the raw buffer can go
+        {
+            PROFILE_SCOPE_FRAME("Pack", frame);
+            std::vector<std::vector<uint8_t>> bands(BandCount);
+            for (int b = 0; b < BandCount; b++) {
+                size_t offset = (size_t)b * BandRows * size * 4;
+                size_t count = (size_t)std::min(BandRows, size - b * BandRows) * size;
+                Rle::Encode(pixels->data() + offset, nullptr, count, bands[b]);
+                bands[b].shrink_to_fit();
+            }
+            Anim::Histogram histogram;
+            if (Settings.IsAnimation()) histogram.Add(pixels->data(), (size_t)size * size);
+            pixels.reset();
+            std::lock_guard<std::mutex> lock(Lock);
+            Packed[frame] = std::make_shared<const std::vector<std::vector<uint8_t>>>(std::move(bands));
+            Alive--;
+            PackedFrames++;
+            if (Settings.IsAnimation()) ColorCounts.Merge(histogram);
+            // aliases count towards the palette as the frames they stand for
+            for (int alias : Copies[frame]) {
+                Packed[alias] = Packed[frame];
+                PackedFrames++;
+                if (Settings.IsAnimation()) ColorCounts.Merge(histogram);
+            }
+            if (PackedFrames == frameCount) {
+                if (Settings.IsAnimation()) FramePalette = Anim::BuildPalette(ColorCounts);
+                int items = Settings.IsAnimation() ? frameCount : BandCount;
+                for (int i = 0; i < items; i++) Pending.push_back(i);
+            }
+        }
+        Changed.notify_all();
+    }
+
+    void Cancel() {
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            Cancelled = true;
+        }
+        Changed.notify_all();
+    }
+
+    bool IsCancelled() const { std::lock_guard<std::mutex> lock(Lock); return Cancelled; }
+    bool IsDone() const { return Done.load(); }
+    void Wait() const { Done.wait(false); }
+    bool Failed() const { return HasFailed.load(); }
+    float Progress() const {
+        std::lock_guard<std::mutex> lock(Lock);
+        return stats.Total ? (float)stats.Written / stats.Total : 1.f;
+    }
+    Stats GetStats() const {
+        std::lock_guard<std::mutex> lock(Lock);
+        Stats s = stats;
+        s.ElapsedSeconds = std::chrono::duration<double>((Done ? Finish : std::chrono::steady_clock::now()) - Start).count();
+        return s;
+    }
+    const ExportSettings& GetSettings() const { return Settings; }
+
+    std::filesystem::path FramePath(int frame) const {
+        const char* extension = Settings.Format == ExportFormat::DdsSequence ? "dds" : Settings.Format == ExportFormat::Ktx2Sequence ? "ktx2" : "png";
+        char number[32];
+        std::snprintf(number, sizeof(number), "_%04d.%s", frame, extension);
+        return Settings.Folder / (Settings.Name + number);
+    }
+    std::filesystem::path StripPath() const { return Settings.Folder / (Settings.Name + "_strip.png"); }
+    // atlas pages, and after them the metadata
+    std::filesystem::path AtlasPath(int item) const {
+        if (item == (int)AtlasPages.size()) return Settings.Folder / (Settings.Name + "_atlas.json");
+        return Settings.Folder / (Settings.Name + "_atlas_" + std::to_string(item) + ".png");
+    }
+    std::filesystem::path AnimationPath() const { return Settings.Folder / (Settings.Name + (Settings.Format == ExportFormat::Gif ? ".gif" : ".png")); }
+    // strips and animations are written here and renamed once complete
+    static std::filesystem::path PartialPath(std::filesystem::path path) { return path += ".tmp"; }
+
+private:
+    // block rows of one image being compressed, lock held
+    struct Split {
+        const std::function<void(int, int)>* Body;
+        int Count;
+        int Chunk;
+        int Next;       // first row not yet taken
+        int Left;       // chunks not yet finished
+    };
+    static constexpr int MinSplitRows = 8;
+
+    struct Encoded {
+        int Index;
+        std::vector<uint8_t> Bytes;
+        uint32_t Adler = 1;     // strip bands: of the filtered bytes, for the stream trailer
+        size_t RawSize = 0;
+    };
+
+    void EncodeLoop(int index) {
+        PROFILE_THREAD_NAME("Encoder " + std::to_string(index));
+        while (true) {
+            int item;
+            std::shared_ptr<std::vector<uint8_t>> pixels;
+            {
+                std::unique_lock<std::mutex> lock(Lock);
+                // strip bands and animation frames are claimed in order and only InFlight ahead of the writer, so the
+                // band the writer waits for is always in an encoder already
+                // every item claimed, an encoder stays to help the others' frames until they're done
+                Changed.wait(lock, [&]() {
+                    if (Cancelled || !Splits.empty()) return true;
+                    if (Claimed + Reused == stats.Total) return Busy == 0;
+                    if (Pending.empty()) return false;
+                    return Settings.IsSequence() || Pending.front() - stats.Written < InFlight;
+                });
+                if (!Splits.empty()) {
+                    RunSlice(lock, Splits.front());
+                    continue;
+                }
+                if (Cancelled || Claimed + Reused == stats.Total) return;
+                item = Pending.front();
+                Pending.pop_front();
+                Claimed++;
+                Busy++;
+                if (Settings.IsSequence()) {
+                    pixels = Buffers[item];
+                    Reused += (int)Copies[item].size();
+                }
+            }
+
+            auto begin = std::chrono::steady_clock::now();
+            Encoded encoded = { item };
+            if (pixels) {
+                PROFILE_SCOPE_FRAME("Encode", item);
+                encoded.Bytes = EncodeFrame({ pixels->data(), size, size, 4 });
+                pixels.reset();
+            }
+            else if (Settings.IsAnimation()) {
+                EncodeAnimationFrame(item, encoded);
+            }
+            else if (Settings.Format == ExportFormat::Atlas) {
+                EncodeAtlasItem(item, encoded);
+            }
+            else {
+                EncodeBand(item, encoded);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            {
+                std::lock_guard<std::mutex> lock(Lock);
+                if (Settings.IsSequence()) Buffers.erase(item);
+                Busy--;
+                stats.Encoded++;
+                stats.EncodeSeconds += seconds;
+                ToWrite.push_back(std::move(encoded));
+            }
+            Changed.notify_all();
+        }
+    }
+
+    std::vector<uint8_t> EncodeFrame(const Draw::ImageView& frame) {
+        if (!Settings.IsBlockCompressed()) return Png::Encode(frame);
+        auto split = [this](int count, const std::function<void(int, int)>& body) { SplitRows(count, body); };
+        auto levels = Bc::Compress(frame, Settings.Block, Settings.Quality, Settings.Mips, split);
+        return Settings.Format == ExportFormat::DdsSequence ? Bc::WriteDds(levels, Settings.Block) : Bc::WriteKtx2(levels, Settings.Block);
+    }
+
+    // Bc::RowSplitter over the encoders: the rows go out in chunks that idle encoders take from
+    // Splits, the calling encoder works through them too and waits for the last one. Small
+    // mip levels stay on the calling encoder.
+    void SplitRows(int count, const std::function<void(int, int)>& body) {
+        int encoders = Settings.ResolveEncodeThreads();
+        if (encoders == 1 || count < 2 * MinSplitRows) { body(0, count); return; }
+        int chunk = std::max(MinSplitRows, count / (2 * encoders));
+        auto split = std::make_shared<Split>(Split{ &body, count, chunk, 0, (count + chunk - 1) / chunk });
+
+        std::unique_lock<std::mutex> lock(Lock);
+        Splits.push_back(split);
+        Changed.notify_all();
+        while (split->Next < split->Count) RunSlice(lock, split);
+        Changed.wait(lock, [&]() { return split->Left == 0; });
+    }
+
+    // lock held, runs the next chunk of split without it
+    void RunSlice(std::unique_lock<std::mutex>& lock, std::shared_ptr<Split> split) {
+        int begin = split->Next;
+        int end = std::min(split->Count, begin + split->Chunk);
+        split->Next = end;
+        if (end == split->Count) Splits.erase(std::find(Splits.begin(), Splits.end(), split));
+        lock.unlock();
+        (*split->Body)(begin, end);
+        lock.lock();
+        if (--split->Left == 0) Changed.notify_all();
+    }
+
+    // Decodes the band's rows of every frame side by side, plus the strip row above it for the
+    // filters, and deflates it as a piece of the strip's zlib stream.
+    void EncodeBand(int band, Encoded& encoded) {
+        PROFILE_SCOPE_FRAME("Encode Band", band);
+        int y0 = band * BandRows;
+        int rows = std::min(BandRows, size - y0);
+        int above = band > 0 ? 1 : 0;
+        int width = size * frameCount;
+
+        std::vector<uint8_t> strip((size_t)(rows + above) * width * 4);
+        std::vector<uint8_t> frameRows((size_t)BandRows * size * 4);
+        for (int f = 0; f < frameCount; f++) {
+            for (int part = 0; part <= above; part++) {
+                // part 1 is the previous band, of which only its last row is needed
+                int b = part ? band - 1 : band;
+                int first = part ? BandRows - 1 : 0;
+                int count = part ? 1 : rows;
+                int dst = part ? 0 : above;
+                Rle::Decode((*Packed[f])[b].data(), frameRows.data(), (size_t)std::min(BandRows, size - b * BandRows) * size, false);
+                for (int r = 0; r < count; r++) {
+                    std::memcpy(strip.data() + ((size_t)(dst + r) * width + (size_t)f * size) * 4,
+                        frameRows.data() + (size_t)(first + r) * size * 4, (size_t)size * 4);
+                }
+            }
+        }
+
+        Draw::ImageView view = { strip.data(), width, rows + above, 4 };
+        std::vector<uint8_t> filtered;
+        filtered.reserve((size_t)rows * (width * 4 + 1));
+        Png::FilterRows(view, above, rows + above, filtered);
+        encoded.Adler = Png::Adler32(filtered.data(), filtered.size());
+        encoded.RawSize = filtered.size();
+
+        std::vector<uint8_t> piece;
+        if (band == 0) piece.assign(Png::ZlibHeader, Png::ZlibHeader + 2);
+        Png::Deflate(filtered.data(), filtered.size(), band == BandCount - 1, piece);
+        Png::WriteChunk(encoded.Bytes, "IDAT", piece.data(), piece.size());
+    }
+
+    // Maps the frame and the one before it to the palette and codes the rectangle that changed.
+    // The first frame carries the file header and the last the trailer.
+    void EncodeAnimationFrame(int frame, Encoded& encoded) {
+        PROFILE_SCOPE_FRAME("Encode Frame", frame);
+        size_t count = (size_t)size * size;
+        std::vector<uint8_t> pixels(count * 4), indices(count), previous;
+        auto map = [&](int f, std::vector<uint8_t>& out) {
+            Rle::Decode((*Packed[f])[0].data(), pixels.data(), count, false);
+            FramePalette.Map(pixels.data(), count, out.data());
+        };
+        map(frame, indices);
+        Anim::Rect rect = { 0, 0, size, size };
+        if (frame > 0) {
+            previous.resize(count);
+            map(frame - 1, previous);
+            rect = Anim::ChangedRect(previous.data(), indices.data(), size, size);
+        }
+        std::vector<uint8_t> cropped = Anim::Crop(indices.data(), size, rect);
+
+        // the loop lasts one second, as in the preview
+        if (Settings.Format == ExportFormat::Gif) {
+            if (frame == 0) encoded.Bytes = Anim::Gif::Header(size, size, Settings.Loop ? 0 : -1, FramePalette);
+            // hundredths don't divide evenly, the rounding is spread over the frames
+            int delay = (100 * (frame + 1) + frameCount / 2) / frameCount - (100 * frame + frameCount / 2) / frameCount;
+            Anim::Gif::Frame(encoded.Bytes, rect, cropped.data(), std::max(2, delay));
+            if (frame == frameCount - 1) Anim::Gif::Trailer(encoded.Bytes);
+        }
+        else {
+            if (frame == 0) encoded.Bytes = Anim::Apng::Header(size, size, frameCount, Settings.Loop ? 0 : 1, FramePalette);
+            Anim::Apng::Frame(encoded.Bytes, frame, rect, cropped.data(), 1, frameCount);
+            if (frame == frameCount - 1) Anim::Apng::Trailer(encoded.Bytes);
+        }
+    }
+
+    // Trims the frame and keeps the sprite zero-run coded, once per distinct sprite.
+    void AddSprite(int frame, const Draw::ImageView& pixels) {
+        PROFILE_SCOPE_FRAME("Trim", frame);
+        Atlas::Rect bounds = Atlas::AlphaBounds(pixels);
+        std::vector<uint8_t> sprite((size_t)bounds.Width * bounds.Height * 4), packed;
+        for (int y = 0; y < bounds.Height; y++) {
+            std::memcpy(sprite.data() + (size_t)y * bounds.Width * 4, pixels.Row(bounds.Y + y) + (size_t)bounds.X * 4, (size_t)bounds.Width * 4);
+        }
+        Rle::Encode(sprite.data(), nullptr, (size_t)bounds.Width * bounds.Height, packed);
+        size_t hash = std::hash<std::string_view>()(std::string_view((const char*)packed.data(), packed.size())) ^ ((size_t)bounds.Width << 16 | bounds.Height);
+
+        std::lock_guard<std::mutex> lock(Lock);
+        FrameBounds[frame] = bounds;
+        int index = -1;
+        for (auto [it, end] = SpriteIndex.equal_range(hash); it != end && index < 0; ++it) {
+            const Atlas::Rect& other = Sprites[it->second];
+            if (other.Width == bounds.Width && other.Height == bounds.Height && SpriteData[it->second] == packed) index = it->second;
+        }
+        if (index < 0) {
+            index = (int)Sprites.size();
+            Sprites.push_back({ 0, 0, bounds.Width, bounds.Height });
+            SpriteData.push_back(std::move(packed));
+            SpriteIndex.emplace(hash, index);
+        }
+        FrameSprites[frame] = index;
+        Alive--;
+        PackedFrames++;
+        for (int alias : Copies[frame]) {
+            FrameBounds[alias] = bounds;
+            FrameSprites[alias] = index;
+            PackedFrames++;
+        }
+        if (PackedFrames == frameCount) {
+            AtlasPages = Atlas::Pack(Sprites, Settings.AtlasPage, Settings.AtlasPadding, Placements);
+            stats.Total = (int)AtlasPages.size() + 1;
+            for (int i = 0; i < stats.Total; i++) Pending.push_back(i);
+        }
+    }
+
+    void EncodeAtlasItem(int item, Encoded& encoded) {
+        if (item == (int)AtlasPages.size()) {
+            std::vector<std::string> files;
+            for (int p = 0; p < (int)AtlasPages.size(); p++) files.push_back(AtlasPath(p).filename().string());
+            std::string metadata = Atlas::Metadata(size, files, Placements, Sprites, FrameSprites, FrameBounds);
+            encoded.Bytes.assign(metadata.begin(), metadata.end());
+            return;
+        }
+
+        PROFILE_SCOPE_FRAME("Encode Page", item);
+        const Atlas::Page& page = AtlasPages[item];
+        std::vector<uint8_t> pixels((size_t)page.Width * page.Height * 4), sprite;
+        for (size_t s = 0; s < Sprites.size(); s++) {
+            const Atlas::Placement& at = Placements[s];
+            if (at.Page != item) continue;
+            const Atlas::Rect& r = Sprites[s];
+            sprite.resize((size_t)r.Width * r.Height * 4);
+            Rle::Decode(SpriteData[s].data(), sprite.data(), (size_t)r.Width * r.Height, false);
+            for (int y = 0; y < r.Height; y++) {
+                std::memcpy(pixels.data() + ((size_t)(at.Y + y) * page.Width + at.X) * 4, sprite.data() + (size_t)y * r.Width * 4, (size_t)r.Width * 4);
+            }
+        }
+        encoded.Bytes = Png::Encode({ pixels.data(), page.Width, page.Height, 4 });
+    }
+
+    void WriteLoop() {
+        PROFILE_THREAD_NAME("Export Writer");
+        std::ofstream strip;
+        std::filesystem::path stripPath;
+        uint32_t adler = 1;
+        if (Settings.Format == ExportFormat::PngStrip) {
+            stripPath = StripPath();
+            strip.open(PartialPath(stripPath), std::ios::binary);
+            std::vector<uint8_t> header = Png::FileHeader(size * frameCount, size);
+            strip.write((const char*)header.data(), header.size());
+            if (!strip) Fail(stripPath);
+        }
+        else if (Settings.IsAnimation()) {
+            stripPath = AnimationPath();
+            strip.open(PartialPath(stripPath), std::ios::binary);
+            if (!strip) Fail(stripPath);
+        }
+
+        bool complete = false;
+
+        while (true) {
+            Encoded encoded;
+            std::vector<int> copies;   // sequence frames written with the same bytes
+            {
+                std::unique_lock<std::mutex> lock(Lock);
+                // a strip is written band by band in order, sequence frames as they come
+                auto next = [&]() {
+                    if (Settings.IsSequence()) return ToWrite.begin();
+                    return std::find_if(ToWrite.begin(), ToWrite.end(), [&](const Encoded& e) { return e.Index == stats.Written; });
+                };
+                Changed.wait(lock, [&]() { return Cancelled || stats.Written == stats.Total || next() != ToWrite.end(); });
+                complete = stats.Written == stats.Total && !HasFailed;
+                if (Cancelled || complete) break;
+                auto it = next();
+                encoded = std::move(*it);
+                ToWrite.erase(it);
+                if (Settings.IsSequence()) copies = Copies[encoded.Index];
+            }
+
+            auto begin = std::chrono::steady_clock::now();
+            if (Settings.IsSequence() || Settings.Format == ExportFormat::Atlas) {
+                PROFILE_SCOPE_FRAME("Write", encoded.Index);
+                std::filesystem::path path = Settings.IsSequence() ? FramePath(encoded.Index) : AtlasPath(encoded.Index);
+                std::ofstream out(path, std::ios::binary);
+                out.write((const char*)encoded.Bytes.data(), encoded.Bytes.size());
+                if (!out) Fail(path);
+                for (int copy : copies) {
+                    std::ofstream again(FramePath(copy), std::ios::binary);
+                    again.write((const char*)encoded.Bytes.data(), encoded.Bytes.size());
+                    if (!again) Fail(FramePath(copy));
+                }
+            }
+            else if (Settings.IsAnimation()) {
+                PROFILE_SCOPE_FRAME("Write Frame", encoded.Index);
+                strip.write((const char*)encoded.Bytes.data(), encoded.Bytes.size());
+                if (encoded.Index == frameCount - 1) strip.flush();
+                if (!strip) Fail(stripPath);
+            }
+            else {
+                PROFILE_SCOPE_FRAME("Write Band", encoded.Index);
+                adler = encoded.Index == 0 ? encoded.Adler : Png::Adler32Combine(adler, encoded.Adler, encoded.RawSize);
+                strip.write((const char*)encoded.Bytes.data(), encoded.Bytes.size());
+                if (encoded.Index == BandCount - 1) {
+                    // the stream's Adler-32 trailer in its own IDAT, then IEND
+                    std::vector<uint8_t> trailer, tail;
+                    Png::PutBigEndian(trailer, adler);
+                    Png::WriteChunk(tail, "IDAT", trailer.data(), trailer.size());
+                    Png::WriteEnd(tail);
+                    strip.write((const char*)tail.data(), tail.size());
+                    strip.flush();
+                }
+                if (!strip) Fail(stripPath);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            {
+                std::lock_guard<std::mutex> lock(Lock);
+                if (Settings.IsSequence()) Alive--;
+                stats.Written += 1 + (int)copies.size();
+                stats.BytesWritten += encoded.Bytes.size() * (1 + copies.size());
+                stats.WriteSeconds += seconds;
+            }
+            Changed.notify_all();
+        }
+
+        // a cancelled or failed strip leaves nothing behind rather than a truncated file
+        if (!stripPath.empty()) {
+            strip.close();
+            std::error_code ec;
+            if (complete) {
+                std::filesystem::rename(PartialPath(stripPath), stripPath, ec);
+                if (ec) Fail(stripPath);
+            }
+            if (!complete || ec) std::filesystem::remove(PartialPath(stripPath), ec);
+        }
+
+        Finish = std::chrono::steady_clock::now();
+        Done = true;
+        Done.notify_all();
+    }
+
+    void Fail(const std::filesystem::path& path) {
+        DXE_LOG("Export failed writing ", path.string());
+        HasFailed = true;
+        Cancel();
+    }
+
+    const int size;
+    const int frameCount;
+    const ExportSettings Settings;
+    const int InFlight;
+    int BandRows = 0;
+    int BandCount = 0;
+
+    mutable std::mutex Lock;
+    std::condition_variable Changed;
+    bool Cancelled = false;
+    int Alive = 0;      // frames holding a raw buffer or waiting to be written, lock held
+    int PackedFrames = 0;
+    int Claimed = 0;    // items taken by encoders
+    int Reused = 0;     // sequence frames that go out as another's bytes, as their source is claimed
+    int Busy = 0;       // encoders between claiming an item and handing it to the writer
+    std::deque<std::shared_ptr<Split>> Splits;
+    std::unordered_map<int, std::shared_ptr<std::vector<uint8_t>>> Buffers;
+    std::unordered_map<int, std::vector<int>> Copies;   // frame -> the frames aliasing it
+    // strip: [frame][band], animation: [frame][0]; aliases share their source's
+    std::vector<std::shared_ptr<const std::vector<std::vector<uint8_t>>>> Packed;
+    Anim::Histogram ColorCounts;    // animation: every frame packed so far
+    Anim::Palette FramePalette;     // animation: once every frame is packed
+    // atlas: distinct sprites (sizes only, placed once packed) and each frame's sprite and bounds
+    std::vector<Atlas::Rect> Sprites;
+    std::vector<std::vector<uint8_t>> SpriteData;
+    std::unordered_multimap<size_t, int> SpriteIndex;
+    std::vector<int> FrameSprites;
+    std::vector<Atlas::Rect> FrameBounds;
+    std::vector<Atlas::Placement> Placements;
+    std::vector<Atlas::Page> AtlasPages;
+    std::deque<int> Pending;        // frames or bands ready to encode
+    std::vector<Encoded> ToWrite;
+    Stats stats;
+
+    std::vector<std::thread> Encoders;
+    std::thread Writer;
+    std::atomic<bool> Done = false;
+    std::atomic<bool> HasFailed = false;
+    std::chrono::steady_clock::time_point Start;
+    std::chrono::steady_clock::time_point Finish;
+};
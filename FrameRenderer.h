@@ -0,0 +1,52 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <numeric>
+#include "DrawFunctions.h"
+#include "Profiler.h"
+
+// How a sequence is split across the CPU. Picked per generator by the autotuner.
+struct RenderSettings {
+    int Threads = 0;        // 0 = hardware_concurrency()
+    int TileRows = 0;       // rows per work item, 0 = whole frame
+    KernelVariant Variant = KernelVariant::Scalar;
+    int SequenceFrames = 8; // frames per call for generators with a sequence kernel, 1 = frame by frame
+    bool Periodic = true;   // render one period of a generator that repeats, alias the rest
+
+    int ResolveThreads() const {
+        if (Threads > 0) return Threads;
+        int hw = (int)std::thread::hardware_concurrency();
+        return hw > 0 ? hw : 4;
+    }
+};
+
+inline const char* KernelVariantName(KernelVariant variant) {
+    return variant == KernelVariant::Simd ? "simd" : "scalar";
+}
+
+namespace Render {
+
+    // no times for a count below 1, nothing renders
+    inline std::vector<double> FrameTimes(int frameCount, bool looping) {
+        if (frameCount <= 0) return {};
+        std::vector<double> times(frameCount);
+        int loop = (int)!looping;
+        for (int i = 0; i < frameCount; i++) {
+            times[i] = frameCount - loop > 0 ? (double)i / (frameCount - loop) : 0.0;
+        }
+        return times;
+    }
+
+    // Frames that have to be rendered: frame f shows what frame f % PeriodFrames shows. A looping
+    // generator that repeats k times over n frames comes round every n / gcd(n, k) frames, one
+    // that doesn't move needs a single frame. Only for the evenly spaced FrameTimes.
+    inline int PeriodFrames(IFrameGenerator& generator, const std::vector<double>& times) {
+        int n = (int)times.size();
+        int repeats = generator.Repeats();
+        bool looping = generator.IsLooping();
+        if (n == 0 || repeats == 1 || (repeats > 1 && !looping) || times != FrameTimes(n, looping)) return n;
+        return repeats == 0 ? 1 : n / std::gcd(n, repeats);
+    }
+}
@@ -0,0 +1,495 @@
+#pragma once
+#include <memory>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <cstdlib>
+#include "RenderJob.h"
+
+// Where AppLayer keeps preview frames: one texture each, or a FrameStore.
+enum class FrameStorage { Textures, Compressed, MappedFile };
+
+// A finished sequence kept somewhere other than one DXE texture per frame. It is the render
+// job's sink, so frames go straight in as workers finish them; the UI reads back the frame it
+// shows and uploads the 32px thumbnails made on the way in.
+class FrameStore : public FrameSink {
+public:
+    static constexpr int ThumbnailSize = TextureSink::ThumbnailSize;
+
+    FrameStore(int size, int frameCount)
+        : size(size), frameCount(frameCount), Thumbnails((size_t)frameCount * ThumbnailSize * ThumbnailSize * 4),
+        Finished(new std::atomic<bool>[frameCount]), Sources(new std::atomic<int>[frameCount]), Copies(frameCount) {
+        for (int i = 0; i < frameCount; i++) { Finished[i] = false; Sources[i] = -1; }
+    }
+
+    int Size() const { return size; }
+    int FrameCount() const { return frameCount; }
+    bool IsReady(int frame) const { return frame >= 0 && frame < frameCount && Finished[frame].load(); }
+    // the frame whose pixels a frame shows, itself unless it is an alias
+    int SourceOf(int frame) const { int source = Sources[frame].load(); return source >= 0 ? source : frame; }
+
+    // aliases keep no pixels of their own, they are ready when their source is
+    bool Alias(int frame, int source) override {
+        std::lock_guard<std::mutex> lock(ReadyLock);
+        Sources[frame] = source;
+        Copies[source].push_back(frame);
+        return true;
+    }
+
+    // Copies a ready frame into out. When out already holds frame `outHolds`, stores that
+    // decode incrementally may start from it.
+    virtual void Read(int frame, const Draw::ImageView& out, int outHolds = -1) = 0;
+    // zero-copy view of a ready frame, for stores that keep plain pixels
+    virtual bool View(int frame, Draw::ImageView& out) { return false; }
+    // bytes held for pixel data, compressed or not
+    virtual size_t StoredBytes() const = 0;
+    size_t RawBytes() const { return (size_t)size * size * 4 * frameCount; }
+
+    Draw::ImageView Thumbnail(int frame) {
+        return { Thumbnails.data() + (size_t)frame * ThumbnailSize * ThumbnailSize * 4, ThumbnailSize, ThumbnailSize, 4 };
+    }
+
+    // frames that became ready since the last call
+    std::vector<int> TakeReady() {
+        std::lock_guard<std::mutex> lock(ReadyLock);
+        return std::exchange(Ready, {});
+    }
+
+protected:
+    // called by the store once a frame's pixels are final and readable
+    void Publish(int frame, const Draw::ImageView& pixels) {
+        {
+            PROFILE_SCOPE("Thumbnail");
+            Draw::Downsample(pixels, Thumbnail(frame));
+        }
+        MarkReady(frame);
+    }
+    // for frames whose thumbnail the store filled in itself; its aliases become ready with it
+    void MarkReady(int frame) {
+        std::lock_guard<std::mutex> lock(ReadyLock);
+        for (int alias : Copies[frame]) {
+            std::memcpy(Thumbnail(alias).Pixels, Thumbnail(frame).Pixels, Thumbnail(frame).ByteSize());
+            Finished[alias] = true;
+            Ready.push_back(alias);
+        }
+        Finished[frame] = true;
+        Ready.push_back(frame);
+    }
+    // frames aliasing this one, every one of them is known by the time the frame completes
+    const std::vector<int>& AliasesOf(int frame) const { return Copies[frame]; }
+    // an alias read back from a file, marked ready on its own
+    void SetSource(int frame, int source) { Sources[frame] = source; }
+
+    const int size;
+    const int frameCount;
+
+private:
+    std::vector<uint8_t> Thumbnails;
+    std::unique_ptr<std::atomic<bool>[]> Finished;
+    std::unique_ptr<std::atomic<int>[]> Sources;
+    std::mutex ReadyLock;
+    std::vector<int> Ready;
+    std::vector<std::vector<int>> Copies;   // lock held
+};
+
+// Zero-run coding over 32-bit pixels: a stream of (zero run, literal run) pairs, each count a
+// LEB128 varint followed by the literal pixels. Our frames are mostly black, and a frame XORed
+// with the one before it is mostly zero, so this gets most of the ratio of an LZ coder at a
+// fraction of the cost.
+namespace Rle {
+
+    inline void PutCount(std::vector<uint8_t>& out, size_t n) {
+        while (n >= 0x80) { out.push_back((uint8_t)(n | 0x80)); n >>= 7; }
+        out.push_back((uint8_t)n);
+    }
+    inline size_t GetCount(const uint8_t*& in) {
+        size_t n = 0;
+        int shift = 0;
+        while (*in & 0x80) { n |= (size_t)(*in++ & 0x7f) << shift; shift += 7; }
+        n |= (size_t)(*in++) << shift;
+        return n;
+    }
+
+    inline uint32_t Load(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+    // pixels XORed with prev when it isn't null
+    inline void Encode(const uint8_t* pixels, const uint8_t* prev, size_t count, std::vector<uint8_t>& out) {
+        auto value = [&](size_t i) { return prev ? Load(pixels + i * 4) ^ Load(prev + i * 4) : Load(pixels + i * 4); };
+        size_t i = 0;
+        while (i < count) {
+            size_t zeros = i;
+            while (zeros < count && value(zeros) == 0) zeros++;
+            size_t literals = zeros;
+            // a single zero between literals is cheaper inline than as its own run
+            while (literals < count && (value(literals) != 0 || (literals + 1 < count && value(literals + 1) != 0))) literals++;
+
+            PutCount(out, zeros - i);
+            PutCount(out, literals - zeros);
+            for (size_t j = zeros; j < literals; j++) {
+                uint32_t v = value(j);
+                uint8_t bytes[4];
+                std::memcpy(bytes, &v, 4);
+                out.insert(out.end(), bytes, bytes + 4);
+            }
+            i = literals;
+        }
+    }
+
+    // delta: XOR the stream into pixels, otherwise overwrite them
+    inline void Decode(const uint8_t* data, uint8_t* pixels, size_t count, bool delta) {
+        const uint8_t* in = data;
+        size_t i = 0;
+        while (i < count) {
+            size_t zeros = GetCount(in);
+            if (!delta) std::memset(pixels + i * 4, 0, zeros * 4);
+            i += zeros;
+            size_t literals = GetCount(in);
+            if (delta) {
+                for (size_t j = 0; j < literals * 4; j++) pixels[i * 4 + j] ^= in[j];
+            }
+            else {
+                std::memcpy(pixels + i * 4, in, literals * 4);
+            }
+            in += literals * 4;
+            i += literals;
+        }
+    }
+}
+
+// Frames compressed in RAM. Every KeyInterval-th frame is coded on its own, the rest as the
+// XOR against the frame before, which is where the ratio comes from on slowly changing effects.
+// Each frame is cut into BandRows-row bands coded independently, so a read decodes all bands
+// in parallel. Raw buffers only live while a frame or its successor is still being rendered.
+class CompressedFrameStore : public FrameStore {
+public:
+    static constexpr int KeyInterval = 8;
+    static constexpr int BandRows = 64;
+
+    CompressedFrameStore(int size, int frameCount, int readThreads = 0)
+        : FrameStore(size, frameCount), Frames(frameCount),
+        ReadThreads(readThreads > 0 ? readThreads : std::max(1, (int)std::thread::hardware_concurrency())) {}
+
+    Draw::ImageView Acquire(int frame) override {
+        auto raw = std::make_shared<std::vector<uint8_t>>((size_t)size * size * 4);
+        std::lock_guard<std::mutex> lock(Lock);
+        Frames[frame].Raw = raw;
+        return View(raw->data());
+    }
+
+    void Complete(int frame) override {
+        // the buffers are held here so ReleaseRaw can drop the store's references at any time
+        struct Pending { int Frame; std::shared_ptr<std::vector<uint8_t>> Raw, Prev; };
+        std::vector<Pending> encodable;
+        std::shared_ptr<std::vector<uint8_t>> raw;
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            Frames[frame].Rendered = true;
+            raw = Frames[frame].Raw;
+            for (int f : { frame, frame + 1 }) {
+                if (!CanEncode(f)) continue;
+                Frames[f].Encoding = true;
+                encodable.push_back({ f, Frames[f].Raw, IsKey(f) ? nullptr : Frames[f - 1].Raw });
+            }
+        }
+        // published from the raw pixels right away, reads fall back to them until the frame is encoded
+        Publish(frame, View(raw->data()));
+
+        for (auto& pending : encodable) {
+            Encode(pending.Frame, pending.Raw->data(), pending.Prev ? pending.Prev->data() : nullptr);
+        }
+
+        std::lock_guard<std::mutex> lock(Lock);
+        ReleaseRaw();
+    }
+
+    void Read(int frame, const Draw::ImageView& out, int outHolds = -1) override {
+        PROFILE_SCOPE_FRAME("Decompress", frame);
+        if (!IsReady(frame)) return;
+        frame = SourceOf(frame);
+        if (outHolds >= 0) outHolds = SourceOf(outHolds);
+        std::shared_ptr<std::vector<uint8_t>> raw;
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            raw = Frames[frame].Raw;
+        }
+        if (raw) {
+            std::memcpy(out.Pixels, raw->data(), out.ByteSize());
+            return;
+        }
+
+        // key frame, or continue the chain from what out holds when playback steps forward
+        int key = frame - frame % KeyInterval;
+        int first = (outHolds >= key && outHolds < frame) ? outHolds + 1 : key;
+
+        int bands = (size + BandRows - 1) / BandRows;
+        Draw::ParallelFor(bands, ReadThreads, [&](int b0, int b1) {
+            for (int b = b0; b < b1; b++) {
+                int y0 = b * BandRows;
+                size_t count = (size_t)std::min(BandRows, size - y0) * size;
+                for (int f = first; f <= frame; f++) {
+                    Rle::Decode(Frames[f].Bands[b].data(), out.Row(y0), count, f != key);
+                }
+            }
+        });
+    }
+
+    size_t StoredBytes() const override {
+        std::lock_guard<std::mutex> lock(Lock);
+        size_t bytes = 0;
+        for (auto& frame : Frames) {
+            if (frame.Raw) bytes += frame.Raw->size();
+            for (auto& band : frame.Bands) bytes += band.size();
+        }
+        return bytes;
+    }
+
+private:
+    struct Frame {
+        std::shared_ptr<std::vector<uint8_t>> Raw;
+        std::vector<std::vector<uint8_t>> Bands;
+        bool Rendered = false;
+        bool Encoding = false;
+        bool Encoded = false;
+    };
+
+    Draw::ImageView View(uint8_t* pixels) const { return { pixels, size, size, 4 }; }
+    bool IsKey(int frame) const { return frame % KeyInterval == 0; }
+
+    // lock held
+    bool CanEncode(int frame) const {
+        if (frame >= frameCount) return false;
+        const Frame& f = Frames[frame];
+        return f.Rendered && !f.Encoding && (IsKey(frame) || Frames[frame - 1].Rendered);
+    }
+
+    // worker thread, no lock held
+    void Encode(int frame, const uint8_t* pixels, const uint8_t* prev) {
+        PROFILE_SCOPE_FRAME("Compress", frame);
+
+        int bands = (size + BandRows - 1) / BandRows;
+        std::vector<std::vector<uint8_t>> encoded(bands);
+        for (int b = 0; b < bands; b++) {
+            size_t offset = (size_t)b * BandRows * size * 4;
+            size_t count = (size_t)std::min(BandRows, size - b * BandRows) * size;
+            Rle::Encode(pixels + offset, prev ? prev + offset : nullptr, count, encoded[b]);
+            encoded[b].shrink_to_fit();
+        }
+
+        std::lock_guard<std::mutex> lock(Lock);
+        Frames[frame].Bands = std::move(encoded);
+        Frames[frame].Encoded = true;
+    }
+
+    // lock held. A raw frame can go once it is encoded, every frame before it back to the key
+    // is encoded (so a read can decode it), and its successor no longer needs it as a reference
+    // or is an alias, which is never coded against it.
+    void ReleaseRaw() {
+        for (int key = 0; key < frameCount; key += KeyInterval) {
+            bool chain = true;
+            for (int f = key; f < std::min(key + KeyInterval, frameCount); f++) {
+                chain = chain && Frames[f].Encoded;
+                if (!chain) break;
+                bool successorDone = f + 1 == frameCount || IsKey(f + 1) || Frames[f + 1].Encoded || SourceOf(f + 1) != f + 1;
+                if (successorDone) Frames[f].Raw.reset();
+            }
+        }
+    }
+
+    std::vector<Frame> Frames;
+    int ReadThreads;
+    mutable std::mutex Lock;
+};
+
+// Frames in a memory-mapped file, for sequences larger than RAM. Workers render straight into
+// the mapping and readers copy (or View) straight out of it, the OS page cache decides what
+// stays resident. The file keeps a fixed header, a ready flag and a one-page thumbnail per
+// frame, then page-aligned frames, so Open() on a previous session's file is instant. The
+// header also records what rendered the frames, so a reopen can put the generator back and
+// tell whether the frames still match it.
+class MappedFrameStore : public FrameStore {
+public:
+    static constexpr char Magic[8] = { 'S', 'G', 'F', 'R', 'A', 'M', 'E', 'S' };
+    static constexpr uint32_t Version = 3;
+    static constexpr size_t PageSize = 4096;
+    static constexpr int MaxFields = 32;
+
+    struct Header {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Size;
+        uint32_t FrameCount;
+        uint32_t Channels;
+        uint64_t FrameStride;       // page-aligned bytes per frame
+        uint64_t AliasOffset;       // FrameCount int32: 1 + the frame an alias shows, 0 otherwise
+        uint64_t ThumbnailOffset;   // one page per frame
+        uint64_t FrameOffset;
+        char Generator[64];
+        uint64_t StateHash;         // the render cache key of the job's frames, 0 when it has none
+        uint32_t FieldCount;        // the generator's SweepFields() values when it rendered
+        float Fields[MaxFields];
+        // followed by FrameCount ready bytes
+    };
+
+    static_assert(TextureSink::ThumbnailSize * TextureSink::ThumbnailSize * 4 <= PageSize, "thumbnail must fit its page");
+
+    static std::filesystem::path DefaultDirectory() {
+        const char* base = std::getenv("LOCALAPPDATA");
+        std::filesystem::path dir = base ? std::filesystem::path(base) / "SpriteGen" : std::filesystem::path(".");
+        return dir / "FrameCache";
+    }
+
+    static std::shared_ptr<MappedFrameStore> Create(const std::filesystem::path& path, int size, int frameCount,
+        const IFrameGenerator& generator, uint64_t stateHash)
+    {
+        size_t frameBytes = (size_t)size * size * 4;
+        Header header = {};
+        std::memcpy(header.Magic, Magic, sizeof(Magic));
+        header.Version = Version;
+        header.Size = size;
+        header.FrameCount = frameCount;
+        header.Channels = 4;
+        header.FrameStride = AlignPage(frameBytes);
+        header.AliasOffset = (sizeof(Header) + frameCount + 3) / 4 * 4;
+        header.ThumbnailOffset = AlignPage(header.AliasOffset + (uint64_t)frameCount * 4);
+        header.FrameOffset = header.ThumbnailOffset + (uint64_t)frameCount * PageSize;
+        std::strncpy(header.Generator, generator.GetName(), sizeof(header.Generator) - 1);
+        header.StateHash = stateHash;
+        header.FieldCount = (uint32_t)std::min((int)generator.SweepFields().size(), MaxFields);
+        for (int f = 0; f < (int)header.FieldCount; f++) header.Fields[f] = generator.GetSweepField(f);
+
+        uint64_t fileBytes = header.FrameOffset + header.FrameStride * frameCount;
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+        auto store = std::shared_ptr<MappedFrameStore>(new MappedFrameStore(path, header));
+        if (!store->Map(fileBytes, true)) {
+            // whatever CreateFile left behind goes with the store
+            store->Discard();
+            return nullptr;
+        }
+        std::memcpy(store->Base, &header, sizeof(Header));
+        return store;
+    }
+
+    // reopens a file written by Create, ready frames are available immediately
+    static std::shared_ptr<MappedFrameStore> Open(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        Header header = {};
+        if (!in.read((char*)&header, sizeof(Header)) || std::memcmp(header.Magic, Magic, sizeof(Magic)) != 0 ||
+            header.Version != Version || header.Channels != 4 || header.Size == 0 || header.FrameCount == 0 || header.FieldCount > MaxFields) {
+            DXE_LOG("Not a frame cache: ", path.string());
+            return nullptr;
+        }
+        in.close();
+        header.Generator[sizeof(header.Generator) - 1] = 0;
+
+        uint64_t fileBytes = header.FrameOffset + header.FrameStride * header.FrameCount;
+        std::error_code ec;
+        if (std::filesystem::file_size(path, ec) < fileBytes) {
+            DXE_LOG("Frame cache is truncated: ", path.string());
+            return nullptr;
+        }
+
+        auto store = std::shared_ptr<MappedFrameStore>(new MappedFrameStore(path, header));
+        if (!store->Map(fileBytes, false)) return nullptr;
+        for (int i = 0; i < store->frameCount; i++) {
+            if (!store->ReadyFlags()[i]) continue;
+            int source = (int)store->AliasTable()[i] - 1;
+            if (source >= 0 && source < store->frameCount) store->SetSource(i, source);
+            Draw::ImageView thumbnail = store->Thumbnail(i);
+            std::memcpy(thumbnail.Pixels, store->FileThumbnail(store->SourceOf(i)), thumbnail.ByteSize());
+            store->MarkReady(i);
+        }
+        return store;
+    }
+
+    ~MappedFrameStore() {
+        if (Base) UnmapViewOfFile(Base);
+        if (Mapping) CloseHandle(Mapping);
+        if (File != INVALID_HANDLE_VALUE) CloseHandle(File);
+        if (Discarded) {
+            std::error_code ec;
+            std::filesystem::remove(Path, ec);
+        }
+    }
+
+    const std::filesystem::path& FilePath() const { return Path; }
+    const char* Generator() const { return header.Generator; }
+    uint64_t StateHash() const { return header.StateHash; }
+    // the parameters the frames were rendered with, onto a fresh generator of the same name
+    void RestoreFields(IFrameGenerator& generator) const {
+        int count = std::min((int)header.FieldCount, (int)generator.SweepFields().size());
+        for (int f = 0; f < count; f++) generator.SetSweepField(f, header.Fields[f]);
+    }
+    // deletes the file once the last reference (e.g. a cancelled job) lets go
+    void Discard() { Discarded = true; }
+
+    Draw::ImageView Acquire(int frame) override { return FrameView(frame); }
+
+    // an alias's pages are never touched, the table says where to read it
+    bool Alias(int frame, int source) override {
+        FrameStore::Alias(frame, source);
+        AliasTable()[frame] = (uint32_t)source + 1;
+        return true;
+    }
+
+    void Complete(int frame) override {
+        Draw::ImageView pixels = FrameView(frame);
+        Publish(frame, pixels);
+        std::memcpy(FileThumbnail(frame), Thumbnail(frame).Pixels, Thumbnail(frame).ByteSize());
+        for (int alias : AliasesOf(frame)) ReadyFlags()[alias] = 1;
+        ReadyFlags()[frame] = 1;
+    }
+
+    void Read(int frame, const Draw::ImageView& out, int outHolds = -1) override {
+        PROFILE_SCOPE_FRAME("Read Mapped", frame);
+        if (!IsReady(frame)) return;
+        std::memcpy(out.Pixels, FrameView(SourceOf(frame)).Pixels, out.ByteSize());
+    }
+
+    bool View(int frame, Draw::ImageView& out) override {
+        if (!IsReady(frame)) return false;
+        out = FrameView(SourceOf(frame));
+        return true;
+    }
+
+    // address space, not RAM: residency is up to the page cache
+    size_t StoredBytes() const override { return (size_t)header.FrameStride * frameCount; }
+
+private:
+    MappedFrameStore(std::filesystem::path path, const Header& header)
+        : FrameStore((int)header.Size, (int)header.FrameCount), Path(std::move(path)), header(header) {}
+
+    static uint64_t AlignPage(uint64_t bytes) { return (bytes + PageSize - 1) / PageSize * PageSize; }
+
+    bool Map(uint64_t fileBytes, bool create) {
+        File = CreateFileW(Path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (File == INVALID_HANDLE_VALUE) {
+            DXE_LOG("Failed to open frame cache: ", Path.string());
+            return false;
+        }
+        // sizing the mapping grows a new file to fit
+        Mapping = CreateFileMappingW(File, nullptr, PAGE_READWRITE, (DWORD)(fileBytes >> 32), (DWORD)fileBytes, nullptr);
+        if (Mapping) Base = (uint8_t*)MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (!Base) {
+            DXE_LOG("Failed to map frame cache: ", Path.string());
+            return false;
+        }
+        return true;
+    }
+
+    uint8_t* ReadyFlags() const { return Base + sizeof(Header); }
+    uint32_t* AliasTable() const { return (uint32_t*)(Base + header.AliasOffset); }
+    uint8_t* FileThumbnail(int frame) const { return Base + header.ThumbnailOffset + (size_t)frame * PageSize; }
+    Draw::ImageView FrameView(int frame) const {
+        return { Base + header.FrameOffset + (size_t)frame * header.FrameStride, size, size, 4 };
+    }
+
+    std::filesystem::path Path;
+    Header header;
+    HANDLE File = INVALID_HANDLE_VALUE;
+    HANDLE Mapping = nullptr;
+    uint8_t* Base = nullptr;
+    std::atomic<bool> Discarded = false;
+};
@@ -0,0 +1,161 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include "DrawFunctions.h"
+#include "RenderJob.h"
+
+// Several masks from one evaluation of a generator: the wrapped generator's field kernel runs
+// once per tile and each output shapes it with its own bias, brightness and curve into its own
+// channel of the frame, a hard core in R and a soft glow in G, say. Channels no output claims
+// stay black, or opaque for alpha. MaskPlaneSink splits such frames into one gray plane each.
+class MaskGenerator : public IFrameGenerator {
+public:
+    static constexpr int MaxOutputs = 4;
+
+    static bool CanWrap(const IFrameGenerator& generator) { return generator.HasFieldKernel(); }
+
+    MaskGenerator(std::unique_ptr<IFrameGenerator> inner, std::vector<MaskOutput> outputs)
+        : Inner(std::move(inner)), Outputs(std::move(outputs))
+    {
+        if (Outputs.size() > MaxOutputs) Outputs.resize(MaxOutputs);
+        for (MaskOutput& output : Outputs) output.Channel = std::clamp(output.Channel, 0, 3);
+    }
+
+    const char* GetName() const override { return Inner->GetName(); }
+    bool IsLooping() override { return Inner->IsLooping(); }
+    int Repeats() const override { return Inner->Repeats(); }
+    bool DrawImGui() override { return Inner->DrawImGui(); }
+    std::unique_ptr<IFrameGenerator> Clone() const override { return std::make_unique<MaskGenerator>(Inner->Clone(), Outputs); }
+    bool HasSimdKernel() const override { return Inner->HasSimdKernel(); }
+    // names only label files, the pixels don't depend on them
+    bool HashState(StateKey& key) const override {
+        key.Add("Masks").Add(Outputs.size());
+        for (const MaskOutput& output : Outputs) key.Add(output.Bias).Add(output.Brightness).Add(output.Curve).Add(output.Exponent).Add(output.Channel);
+        return HashGenerator(*Inner, key);
+    }
+
+    std::vector<const char*> SweepFields() const override { return Inner->SweepFields(); }
+    float GetSweepField(int field) const override { return Inner->GetSweepField(field); }
+    void SetSweepField(int field, float value) override { Inner->SetSweepField(field, value); }
+
+    const std::vector<MaskOutput>& GetOutputs() const { return Outputs; }
+
+    void GenerateTile(const Draw::ImageView& target, double t, int y0, int y1, KernelVariant variant) override {
+        int width = target.Width;
+        std::vector<float> field((size_t)width * (y1 - y0));
+        Inner->GenerateFieldTile(field.data(), width, target.Height, t, y0, y1, variant);
+
+        bool claimed[4] = {};
+        for (const MaskOutput& output : Outputs) claimed[output.Channel] = true;
+        for (int Y = y0; Y < y1; Y++) {
+            uint8_t* row = target.Row(Y);
+            const float* values = field.data() + (size_t)(Y - y0) * width;
+            for (int c = 0; c < target.Channels; c++) {
+                if (c < 4 && claimed[c]) continue;
+                uint8_t fill = c == 3 ? 255 : 0;
+                for (int X = 0; X < width; X++) { row[(size_t)X * target.Channels + c] = fill; }
+            }
+            for (const MaskOutput& output : Outputs) {
+                if (output.Channel < target.Channels) output.ApplyRow(values, row + output.Channel, target.Channels, width);
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<IFrameGenerator> Inner;
+    std::vector<MaskOutput> Outputs;
+};
+
+// Takes a MaskGenerator's packed frames and hands each output to a sink of its own as an
+// ordinary gray frame, the same pixels a render with only that mask would give. Packed frames
+// are held only until every plane has its copy.
+class MaskPlaneSink : public FrameSink {
+public:
+    struct Plane {
+        int Channel = 0;
+        std::shared_ptr<FrameSink> Sink;
+    };
+
+    MaskPlaneSink(int size, std::vector<Plane> planes) : size(size), Planes(std::move(planes)) {}
+
+    Draw::ImageView Acquire(int frame) override {
+        std::lock_guard<std::mutex> lock(Lock);
+        std::vector<uint8_t>& pixels = Packed[frame];
+        if (!Spare.empty()) {
+            pixels = std::move(Spare.back());
+            Spare.pop_back();
+        }
+        pixels.resize((size_t)size * size * 4);
+        return { pixels.data(), size, size, 4 };
+    }
+
+    void Complete(int frame) override {
+        std::vector<uint8_t> pixels;
+        std::vector<bool> skip(Planes.size());
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            pixels = std::move(Packed[frame]);
+            Packed.erase(frame);
+            auto taken = Taken.find(frame);
+            if (taken != Taken.end()) {
+                skip = std::move(taken->second);
+                Taken.erase(taken);
+            }
+        }
+
+        Draw::ImageView packed = { pixels.data(), size, size, 4 };
+        for (size_t p = 0; p < Planes.size(); p++) {
+            if (skip[p]) continue;
+            int channel = Planes[p].Channel;
+            Draw::ImageView out = Planes[p].Sink->Acquire(frame);
+            for (int Y = 0; Y < size; Y++) {
+                const uint8_t* src = packed.Row(Y) + channel;
+                uint8_t* dst = out.Row(Y);
+                for (int X = 0; X < size; X++) {
+                    uint8_t v = src[(size_t)X * 4];
+                    for (int c = 0; c < out.Channels; c++) { dst[(size_t)X * out.Channels + c] = v; }
+                }
+            }
+            Planes[p].Sink->Complete(frame);
+        }
+
+        std::lock_guard<std::mutex> lock(Lock);
+        Spare.push_back(std::move(pixels));
+    }
+
+    int MaxHeld() const override {
+        int held = INT_MAX;
+        for (const Plane& plane : Planes) held = std::min(held, plane.Sink->MaxHeld());
+        return held;
+    }
+    bool CanAcquire(int count) const override {
+        for (const Plane& plane : Planes) { if (!plane.Sink->CanAcquire(count)) return false; }
+        return true;
+    }
+
+    // shared only when every plane shares it; the planes that did are skipped by the copy
+    bool Alias(int frame, int source) override {
+        std::vector<bool> taken(Planes.size());
+        bool all = true;
+        for (size_t p = 0; p < Planes.size(); p++) {
+            taken[p] = Planes[p].Sink->Alias(frame, source);
+            all = all && taken[p];
+        }
+        if (all) return true;
+        std::lock_guard<std::mutex> lock(Lock);
+        Taken[frame] = std::move(taken);
+        return false;
+    }
+
+private:
+    const int size;
+    const std::vector<Plane> Planes;
+
+    std::mutex Lock;
+    std::unordered_map<int, std::vector<uint8_t>> Packed;
+    std::vector<std::vector<uint8_t>> Spare;
+    std::unordered_map<int, std::vector<bool>> Taken;   // planes that accepted an alias
+};
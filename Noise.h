@@ -0,0 +1,386 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "imgui/imgui.h"
+#include "Maths/Maths.h"
+
+// Lattice noise for coordinate distortion: value, gradient (Perlin) and 2D simplex,
+// summed as fBm or ridged octaves. Evaluate() works on whole rows of lanes with the
+// octave loop outside the lane loop, so one octave's lattice lookups all hit the same
+// few KB of tables while they are hot in L1, and looks a cell's corners up once for the
+// run of lanes inside it.
+namespace Noise {
+
+    enum class Type { Sine, Value, Gradient, Simplex };
+
+    inline const char* TypeName(Type type) {
+        switch (type) {
+        case Type::Value: return "Value";
+        case Type::Gradient: return "Gradient";
+        case Type::Simplex: return "Simplex";
+        default: return "Sine";
+        }
+    }
+
+    // seeded permutation plus per-hash values and unit gradients
+    struct Table {
+        uint8_t Perm[512];
+        float Value[256];
+        float Gx[256], Gy[256], Gz[256];
+
+        explicit Table(uint32_t seed = 1) { Build(seed); }
+
+        void Build(uint32_t seed) {
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+
+            std::iota(Perm, Perm + 256, 0);
+            std::shuffle(Perm, Perm + 256, rng);
+            std::copy(Perm, Perm + 256, Perm + 256);
+
+            for (int i = 0; i < 256; i++) {
+                Value[i] = uniform(rng);
+                float x, y, z, len;
+                do {
+                    x = uniform(rng); y = uniform(rng); z = uniform(rng);
+                    len = x * x + y * y + z * z;
+                } while (len < 0.01f || len > 1.f);
+                len = 1.f / std::sqrt(len);
+                Gx[i] = x * len; Gy[i] = y * len; Gz[i] = z * len;
+            }
+        }
+
+        int Hash(int x, int y) const { return Perm[Perm[x & 255] + (y & 255)]; }
+        int Hash(int x, int y, int z) const { return Perm[Perm[Perm[x & 255] + (y & 255)] + (z & 255)]; }
+    };
+
+    // One table per seed, shared by every field with that seed and every copy of one.
+    inline std::shared_ptr<const Table> TableFor(int seed) {
+        static std::mutex lock;
+        static std::unordered_map<int, std::weak_ptr<const Table>> tables;
+        std::lock_guard<std::mutex> guard(lock);
+        std::weak_ptr<const Table>& slot = tables[seed];
+        std::shared_ptr<const Table> table = slot.lock();
+        if (!table) {
+            table = std::make_shared<const Table>((uint32_t)seed);
+            slot = table;
+        }
+        return table;
+    }
+
+    struct Field {
+        Type type = Type::Sine;
+        int octaves = 3;
+        float lacunarity = 2.f;
+        float gain = 0.5f;
+        bool ridged = false;
+        float speed = 2.f;      // lattice cells per unit of time
+        int seed = 1;
+        std::shared_ptr<const Table> table = TableFor(1);
+
+        void Reseed() { table = TableFor(seed); }
+    };
+
+    inline float Fade(float t) { return t * t * t * (t * (t * 6.f - 15.f) + 10.f); }
+    inline float Lerp(float a, float b, float t) { return a + t * (b - a); }
+    // std::floor is a libm call without SSE4.1
+    inline int FastFloor(float x) { int i = (int)x; return i - (x < (float)i); }
+
+    // Per-octave state for one point in time. The time axis is constant across a frame, so the
+    // z half of the 3D lattice is folded into 256-entry slices up front: every lane after that
+    // is a 2D lookup with four corners instead of eight.
+    struct Octave {
+        float frequency = 1.f;
+        float amplitude = 1.f;
+        float shift = 0.f;
+        float sx = 0.f, sy = 0.f;       // simplex domain offset standing in for time
+        float Sx[256], Sy[256], Sz[256];    // z-lerped gradient (or value) per 2D hash
+    };
+
+    struct Prepared {
+        std::shared_ptr<const Table> table;
+        Type type = Type::Sine;
+        bool ridged = false;
+        float norm = 1.f;
+        std::vector<Octave> octaves;
+    };
+
+    // With looping set, every octave's time lattice wraps so the whole sum repeats over time 0..1.
+    // cellPixels is how many pixels the first octave's lattice cell spans, when the caller knows:
+    // octaves whose cells come out under two pixels would only alias and are left out. They still
+    // count towards the normalization, so the octaves that are kept look the same at any size.
+    inline Prepared Prepare(const Field& f, float time, bool looping, float cellPixels = 0.f) {
+        const Table& T = *f.table;
+        Prepared prepared;
+        prepared.table = f.table;
+        prepared.type = f.type;
+        prepared.ridged = f.ridged;
+        if (f.type == Type::Sine) { return prepared; }
+
+        float frequency = 1.f;
+        float amplitude = 1.f;
+        float total = 0.f;
+        prepared.octaves.reserve(std::max(1, f.octaves));
+        for (int o = 0; o < std::max(1, f.octaves); o++) {
+            if (o > 0 && cellPixels > 0.f && cellPixels < 2.f * frequency) {
+                total += amplitude;
+                frequency *= f.lacunarity;
+                amplitude *= f.gain;
+                continue;
+            }
+            Octave& oct = prepared.octaves.emplace_back();
+            oct.frequency = frequency;
+            oct.amplitude = amplitude;
+            // shift each octave so their lattice points don't line up at the origin
+            oct.shift = 17.31f * o;
+
+            int period = looping ? (int)std::lround(f.speed * frequency) : 0;
+            float z = looping ? (time - std::floor(time)) * period : time * f.speed * frequency;
+
+            if (f.type == Type::Simplex) {
+                // simplex is 2D only: move the sample point round a circle to make it loop in time
+                float angle = 2.f * DXM::Pi * time;
+                float radius = f.speed * frequency / (2.f * DXM::Pi);
+                oct.sx = looping ? radius * std::cos(angle) : z;
+                oct.sy = looping ? radius * std::sin(angle) : 0.f;
+            }
+            else {
+                int z0 = FastFloor(z);
+                float dz = z - z0;
+                int z1 = z0 + 1;
+                if (period > 0) {
+                    z0 = ((z0 % period) + period) % period;
+                    z1 = z0 + 1 == period ? 0 : z0 + 1;
+                }
+                float w = Fade(dz);
+                for (int h = 0; h < 256; h++) {
+                    int a = T.Perm[h + (z0 & 255)];
+                    int b = T.Perm[h + (z1 & 255)];
+                    if (f.type == Type::Value) {
+                        oct.Sx[h] = Lerp(T.Value[a], T.Value[b], w);
+                    }
+                    else {
+                        oct.Sx[h] = Lerp(T.Gx[a], T.Gx[b], w);
+                        oct.Sy[h] = Lerp(T.Gy[a], T.Gy[b], w);
+                        oct.Sz[h] = Lerp(T.Gz[a] * dz, T.Gz[b] * (dz - 1.f), w);
+                    }
+                }
+            }
+            total += amplitude;
+            frequency *= f.lacunarity;
+            amplitude *= f.gain;
+        }
+        prepared.norm = 1.f / total;
+        return prepared;
+    }
+
+    // Lanes come in runs that share a lattice cell: a row of a few hundred pixels crosses only a
+    // handful of cells per octave. They go through in chunks, first the cell and the position in
+    // it for every lane, then each run of lanes in one cell looks its corners up once and the rest
+    // is arithmetic on them. Both loops vectorize, and each lane gets the same math as a lookup of
+    // its own would give it.
+    template<Type type, bool Ridged>
+    inline void AccumulateOctave(const Prepared& p, const Octave& o, const float* xs, const float* ys, float* out, int count) {
+        const Table& T = *p.table;
+        // locals, out could alias o as far as the compiler knows
+        const float frequency = o.frequency, shift = o.shift, amplitude = o.amplitude;
+        const float sx = o.sx, sy = o.sy;
+        const float F2 = 0.36602540378f;  // (sqrt(3) - 1) / 2
+        const float G2 = 0.21132486540f;  // (3 - sqrt(3)) / 6
+
+        constexpr int Chunk = 64;
+        float fx[Chunk], fy[Chunk];
+        int ci[Chunk], cj[Chunk];
+        for (int base = 0; base < count; base += Chunk) {
+            int n = std::min(Chunk, count - base);
+            const float* x = xs + base;
+            const float* y = ys + base;
+            float* dst = out + base;
+            auto finish = [&](int k, float v) {
+                if constexpr (Ridged) {
+                    v = 1.f - std::fabs(v);
+                    v = 2.f * v * v - 1.f;
+                }
+                dst[k] += amplitude * v;
+            };
+
+            for (int k = 0; k < n; k++) {
+                float X = x[k] * frequency + shift;
+                float Y = y[k] * frequency + shift;
+                if constexpr (type == Type::Simplex) {
+                    // the skewed cell; simplex is 2D only, time offsets the domain
+                    X += sx;
+                    Y += sy;
+                    float s = (X + Y) * F2;
+                    ci[k] = FastFloor(X + s);
+                    cj[k] = FastFloor(Y + s);
+                    fx[k] = X;
+                    fy[k] = Y;
+                }
+                else {
+                    ci[k] = FastFloor(X);
+                    cj[k] = FastFloor(Y);
+                    fx[k] = X - ci[k];
+                    fy[k] = Y - cj[k];
+                }
+            }
+
+            for (int start = 0; start < n;) {
+                int i = ci[start], j = cj[start];
+                int end = start + 1;
+                while (end < n && ci[end] == i && cj[end] == j) end++;
+
+                if constexpr (type == Type::Simplex) {
+                    // the middle corner is (i + 1, j) below the diagonal and (i, j + 1) above it
+                    int h0 = T.Hash(i, j), hA = T.Hash(i + 1, j), hB = T.Hash(i, j + 1), h2 = T.Hash(i + 1, j + 1);
+                    float g0x = T.Gx[h0], g0y = T.Gy[h0], gAx = T.Gx[hA], gAy = T.Gy[hA];
+                    float gBx = T.Gx[hB], gBy = T.Gy[hB], g2x = T.Gx[h2], g2y = T.Gy[h2];
+                    float t = (i + j) * G2;
+                    auto corner = [](float gx, float gy, float ox, float oy) {
+                        // max(a, 0) written so it stays a straight line of math and vectorizes
+                        float a = 0.5f - ox * ox - oy * oy;
+                        a = 0.5f * (a + std::fabs(a));
+                        a *= a;
+                        return a * a * (gx * ox + gy * oy);
+                    };
+                    for (int k = start; k < end; k++) {
+                        float x0 = fx[k] - (i - t), y0 = fy[k] - (j - t);
+                        bool lower = x0 > y0;
+                        float i1 = lower ? 1.f : 0.f;
+                        float g1x = lower ? gAx : gBx, g1y = lower ? gAy : gBy;
+                        float x1 = x0 - i1 + G2, y1 = y0 - (1.f - i1) + G2;
+                        float x2 = x0 - 1.f + 2.f * G2, y2 = y0 - 1.f + 2.f * G2;
+                        float v = corner(g0x, g0y, x0, y0) + corner(g1x, g1y, x1, y1) + corner(g2x, g2y, x2, y2);
+                        // the 3D gradient table projected to 2D is shorter than unit length on average
+                        finish(k, 90.f * v);
+                    }
+                }
+                else if constexpr (type == Type::Value) {
+                    float v00 = o.Sx[T.Hash(i, j)], v10 = o.Sx[T.Hash(i + 1, j)];
+                    float v01 = o.Sx[T.Hash(i, j + 1)], v11 = o.Sx[T.Hash(i + 1, j + 1)];
+                    for (int k = start; k < end; k++) {
+                        float u = Fade(fx[k]), v = Fade(fy[k]);
+                        finish(k, Lerp(Lerp(v00, v10, u), Lerp(v01, v11, u), v));
+                    }
+                }
+                else {
+                    // z-lerped gradient of each corner, dotted with the offset to that corner
+                    int h00 = T.Hash(i, j), h10 = T.Hash(i + 1, j), h01 = T.Hash(i, j + 1), h11 = T.Hash(i + 1, j + 1);
+                    float g00x = o.Sx[h00], g00y = o.Sy[h00], g00z = o.Sz[h00];
+                    float g10x = o.Sx[h10], g10y = o.Sy[h10], g10z = o.Sz[h10];
+                    float g01x = o.Sx[h01], g01y = o.Sy[h01], g01z = o.Sz[h01];
+                    float g11x = o.Sx[h11], g11y = o.Sy[h11], g11z = o.Sz[h11];
+                    for (int k = start; k < end; k++) {
+                        float dx = fx[k], dy = fy[k];
+                        float u = Fade(dx), v = Fade(dy);
+                        float c0 = Lerp(g00x * dx + g00y * dy + g00z, g10x * (dx - 1.f) + g10y * dy + g10z, u);
+                        float c1 = Lerp(g01x * dx + g01y * (dy - 1.f) + g01z, g11x * (dx - 1.f) + g11y * (dy - 1.f) + g11z, u);
+                        // unit gradients rarely get past +-0.6, stretch to roughly [-1, 1]
+                        finish(k, 1.6f * Lerp(c0, c1, v));
+                    }
+                }
+                start = end;
+            }
+        }
+    }
+
+    template<bool Ridged>
+    inline void AccumulateOctave(const Prepared& p, const Octave& o, const float* xs, const float* ys, float* out, int count) {
+        switch (p.type) {
+        case Type::Value: AccumulateOctave<Type::Value, Ridged>(p, o, xs, ys, out, count); break;
+        case Type::Simplex: AccumulateOctave<Type::Simplex, Ridged>(p, o, xs, ys, out, count); break;
+        default: AccumulateOctave<Type::Gradient, Ridged>(p, o, xs, ys, out, count); break;
+        }
+    }
+
+    // Fractal sum over count lanes: out[i] = noise(xs[i], ys[i]), roughly in [-1, 1].
+    inline void Evaluate(const Prepared& p, const float* xs, const float* ys, float* out, int count) {
+        std::fill(out, out + count, 0.f);
+        for (const Octave& o : p.octaves) {
+            if (p.ridged) { AccumulateOctave<true>(p, o, xs, ys, out, count); }
+            else { AccumulateOctave<false>(p, o, xs, ys, out, count); }
+        }
+        for (int i = 0; i < count; i++) { out[i] *= p.norm; }
+    }
+
+    inline float Sample(const Prepared& p, float x, float y) {
+        float out;
+        Evaluate(p, &x, &y, &out, 1);
+        return out;
+    }
+
+    // Prepare() results for the last few fields and times asked for. Every tile of a frame asks
+    // for the same one, so it is built once per frame rather than once per tile; a copy of the
+    // cache starts out empty, like the generator clone that owns it.
+    class PreparedCache {
+    public:
+        PreparedCache() = default;
+        PreparedCache(const PreparedCache&) {}
+        PreparedCache& operator=(const PreparedCache&) { return *this; }
+
+        std::shared_ptr<const Prepared> Get(const Field& f, float time, bool looping, float cellPixels = 0.f) {
+            Key key = { f.type, f.octaves, f.lacunarity, f.gain, f.ridged, f.speed, f.table.get(), time, looping, cellPixels };
+            std::lock_guard<std::mutex> guard(Lock);
+            for (Entry& entry : Entries) {
+                if (entry.prepared && entry.key == key) return entry.prepared;
+            }
+            // built under the lock, the other tiles of the frame would only wait for it anyway
+            Entry& entry = Entries[Next];
+            Next = (Next + 1) % Size;
+            entry.key = key;
+            entry.prepared = std::make_shared<const Prepared>(Prepare(f, time, looping, cellPixels));
+            return entry.prepared;
+        }
+
+    private:
+        // the prepared octaves keep their table alive, so its address can't be reused by another seed
+        struct Key {
+            Type type;
+            int octaves;
+            float lacunarity, gain;
+            bool ridged;
+            float speed;
+            const Table* table;
+            float time;
+            bool looping;
+            float cellPixels;
+            bool operator==(const Key&) const = default;
+        };
+        struct Entry {
+            Key key = {};
+            std::shared_ptr<const Prepared> prepared;
+        };
+        // a few frames of a sequence or an export can be in flight at once
+        static constexpr int Size = 8;
+
+        std::mutex Lock;
+        Entry Entries[Size];
+        int Next = 0;
+    };
+
+    inline bool DrawImGui(Field& f) {
+        bool changing = false;
+        int type = (int)f.type;
+        changing |= ImGui::Combo("Noise Type", &type, "Sine\0Value\0Gradient\0Simplex\0");
+        f.type = (Type)type;
+        if (f.type == Type::Sine) { return changing; }
+
+        changing |= ImGui::SliderInt("Octaves", &f.octaves, 1, 8);
+        changing |= ImGui::SliderFloat("Lacunarity", &f.lacunarity, 1.5f, 3.f);
+        changing |= ImGui::SliderFloat("Gain", &f.gain, 0.1f, 0.9f);
+        changing |= ImGui::Checkbox("Ridged", &f.ridged);
+        changing |= ImGui::SliderFloat("Noise Speed", &f.speed, 0.f, 8.f);
+        if (ImGui::InputInt("Seed", &f.seed)) {
+            f.Reseed();
+            changing = true;
+        }
+        return changing;
+    }
+}
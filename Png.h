@@ -0,0 +1,530 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <queue>
+#include <algorithm>
+#include "DrawFunctions.h"
+
+// PNG writing without a zlib dependency: CRC-32, Adler-32, per-row filters and a deflate
+// encoder (hash-chain LZ77, per block the cheapest of stored, fixed and dynamic Huffman).
+// Deflate output can end on a sync flush, so independently compressed pieces concatenate
+// into one zlib stream; that is what lets the exporter split one image across encoders.
+namespace Png {
+
+    inline const std::array<uint32_t, 256>& CrcTable() {
+        static const std::array<uint32_t, 256> table = []() {
+            std::array<uint32_t, 256> t = {};
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    inline uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+        const auto& table = CrcTable();
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    constexpr uint32_t AdlerBase = 65521;
+
+    inline uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler = 1) {
+        uint32_t a = adler & 0xffff, b = adler >> 16;
+        while (size > 0) {
+            // 5552 bytes is the most that can be summed before b overflows 32 bits
+            size_t n = std::min<size_t>(size, 5552);
+            size -= n;
+            while (n--) { a += *data++; b += a; }
+            a %= AdlerBase;
+            b %= AdlerBase;
+        }
+        return (b << 16) | a;
+    }
+
+    // Adler-32 of A followed by B, from the checksums of each and B's length
+    inline uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t sizeB) {
+        uint32_t rem = (uint32_t)(sizeB % AdlerBase);
+        uint32_t a = adlerA & 0xffff;
+        uint32_t b = (uint32_t)(((uint64_t)rem * a) % AdlerBase);
+        a += (adlerB & 0xffff) + AdlerBase - 1;
+        b += (adlerA >> 16) + (adlerB >> 16) + AdlerBase - rem;
+        if (a >= AdlerBase) a -= AdlerBase;
+        if (a >= AdlerBase) a -= AdlerBase;
+        if (b >= 2 * AdlerBase) b -= 2 * AdlerBase;
+        if (b >= AdlerBase) b -= AdlerBase;
+        return (b << 16) | a;
+    }
+
+    inline void PutBigEndian(std::vector<uint8_t>& out, uint32_t v) {
+        uint8_t bytes[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    // Deflate packs bits LSB first; Huffman codes go in reversed so they read MSB first.
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : Out(out) {}
+
+        void Put(uint32_t value, int count) {
+            Bits |= (uint64_t)value << Count;
+            Count += count;
+            while (Count >= 8) {
+                Out.push_back((uint8_t)Bits);
+                Bits >>= 8;
+                Count -= 8;
+            }
+        }
+        void PutCode(uint32_t code, int length) { Put(Reverse(code, length), length); }
+        void Align() { if (Count > 0) Put(0, 8 - Count); }
+
+        static uint32_t Reverse(uint32_t code, int length) {
+            uint32_t r = 0;
+            for (int i = 0; i < length; i++) { r = (r << 1) | (code & 1); code >>= 1; }
+            return r;
+        }
+
+    private:
+        std::vector<uint8_t>& Out;
+        uint64_t Bits = 0;
+        int Count = 0;
+    };
+
+    namespace Detail {
+
+        constexpr int WindowSize = 32768;
+        constexpr int MinMatch = 3;
+        constexpr int MaxMatch = 258;
+        constexpr int HashBits = 15;
+        constexpr int MaxChain = 48;
+        constexpr int NiceMatch = 128;
+        constexpr int MaxBits = 15;
+        constexpr int BlockTokens = 1 << 15;
+
+        constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        constexpr uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        constexpr uint16_t DistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        constexpr uint8_t DistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        constexpr uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        // a literal (Dist == 0) or a back reference
+        struct Token { uint16_t Length; uint16_t Dist; };
+
+        inline int LengthCode(int length) {
+            int code = 0;
+            while (code < 28 && LengthBase[code + 1] <= length) code++;
+            return code;
+        }
+        inline int DistCode(int dist) {
+            int code = 0;
+            while (code < 29 && DistBase[code + 1] <= dist) code++;
+            return code;
+        }
+
+        // Huffman code lengths for the frequencies, no longer than maxBits. Over-long trees
+        // are rebuilt from flattened counts, which costs little on our symbol distributions.
+        inline std::vector<uint8_t> CodeLengths(std::vector<uint32_t> freq, int maxBits) {
+            int n = (int)freq.size();
+            std::vector<uint8_t> lengths(n, 0);
+            // a complete code needs two symbols
+            int used = (int)std::count_if(freq.begin(), freq.end(), [](uint32_t f) { return f > 0; });
+            for (int i = 0; used < 2 && i < n; i++) {
+                if (freq[i] == 0) { freq[i] = 1; used++; }
+            }
+
+            while (true) {
+                struct Node { uint64_t Weight; int Index; };
+                auto heavier = [](const Node& a, const Node& b) { return a.Weight > b.Weight; };
+                std::priority_queue<Node, std::vector<Node>, decltype(heavier)> heap(heavier);
+                std::vector<int> parent;
+                for (int i = 0; i < n; i++) {
+                    if (freq[i] == 0) continue;
+                    heap.push({ freq[i], (int)parent.size() });
+                    parent.push_back(-1);
+                }
+                std::vector<int> leaves;
+                for (int i = 0; i < n; i++) if (freq[i]) leaves.push_back(i);
+
+                while (heap.size() > 1) {
+                    Node a = heap.top(); heap.pop();
+                    Node b = heap.top(); heap.pop();
+                    int joined = (int)parent.size();
+                    parent.push_back(-1);
+                    parent[a.Index] = joined;
+                    parent[b.Index] = joined;
+                    heap.push({ a.Weight + b.Weight, joined });
+                }
+
+                int longest = 0;
+                for (int l = 0; l < (int)leaves.size(); l++) {
+                    int depth = 0;
+                    for (int p = parent[l]; p >= 0; p = parent[p]) depth++;
+                    lengths[leaves[l]] = (uint8_t)depth;
+                    longest = std::max(longest, depth);
+                }
+                if (longest <= maxBits) return lengths;
+                for (auto& f : freq) if (f) f = (f + 1) / 2;
+            }
+        }
+
+        // canonical codes from lengths, as in RFC 1951 3.2.2
+        inline std::vector<uint16_t> CanonicalCodes(const std::vector<uint8_t>& lengths) {
+            uint16_t count[MaxBits + 1] = {};
+            for (uint8_t l : lengths) count[l]++;
+            count[0] = 0;
+            uint16_t next[MaxBits + 2] = {};
+            uint16_t code = 0;
+            for (int bits = 1; bits <= MaxBits; bits++) {
+                code = (code + count[bits - 1]) << 1;
+                next[bits] = code;
+            }
+            std::vector<uint16_t> codes(lengths.size(), 0);
+            for (size_t i = 0; i < lengths.size(); i++) {
+                if (lengths[i]) codes[i] = next[lengths[i]]++;
+            }
+            return codes;
+        }
+
+        struct Code {
+            std::vector<uint8_t> Lengths;
+            std::vector<uint16_t> Codes;
+        };
+
+        inline const Code& FixedLiteralCode() {
+            static const Code code = []() {
+                Code c;
+                c.Lengths.resize(288);
+                for (int i = 0; i < 288; i++) c.Lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+                c.Codes = CanonicalCodes(c.Lengths);
+                return c;
+            }();
+            return code;
+        }
+        inline const Code& FixedDistCode() {
+            static const Code code = []() {
+                Code c;
+                c.Lengths.assign(30, 5);
+                c.Codes = CanonicalCodes(c.Lengths);
+                return c;
+            }();
+            return code;
+        }
+
+        // run-length coded code lengths: 16 repeats the previous length 3-6 times,
+        // 17 and 18 are runs of 3-10 and 11-138 zeros
+        struct CodeLengthSymbol { uint8_t Symbol; uint8_t Extra; };
+
+        inline std::vector<CodeLengthSymbol> RunLengths(const std::vector<uint8_t>& lengths) {
+            std::vector<CodeLengthSymbol> out;
+            size_t i = 0;
+            while (i < lengths.size()) {
+                uint8_t l = lengths[i];
+                size_t run = 1;
+                while (i + run < lengths.size() && lengths[i + run] == l) run++;
+                size_t left = run;
+                if (l == 0) {
+                    while (left >= 11) { size_t n = std::min<size_t>(left, 138); out.push_back({ 18, (uint8_t)(n - 11) }); left -= n; }
+                    if (left >= 3) { out.push_back({ 17, (uint8_t)(left - 3) }); left = 0; }
+                }
+                else {
+                    out.push_back({ l, 0 });
+                    left--;
+                    while (left >= 3) { size_t n = std::min<size_t>(left, 6); out.push_back({ 16, (uint8_t)(n - 3) }); left -= n; }
+                }
+                while (left--) out.push_back({ l, 0 });
+                i += run;
+            }
+            return out;
+        }
+
+        inline int ExtraBits(const CodeLengthSymbol& s) { return s.Symbol == 16 ? 2 : s.Symbol == 17 ? 3 : s.Symbol == 18 ? 7 : 0; }
+
+        // bits for the block's symbols under the given codes, extra bits included
+        inline uint64_t SymbolBits(const std::vector<uint32_t>& litFreq, const std::vector<uint32_t>& distFreq, const Code& lit, const Code& dist) {
+            uint64_t bits = 0;
+            for (int i = 0; i < 286; i++) {
+                if (!litFreq[i]) continue;
+                bits += (uint64_t)litFreq[i] * (lit.Lengths[i] + (i > 256 ? LengthExtra[i - 257] : 0));
+            }
+            for (int i = 0; i < 30; i++) {
+                if (!distFreq[i]) continue;
+                bits += (uint64_t)distFreq[i] * (dist.Lengths[i] + DistExtra[i]);
+            }
+            return bits;
+        }
+
+        inline void WriteSymbols(BitWriter& bw, const Token* tokens, size_t count, const Code& lit, const Code& dist) {
+            for (size_t i = 0; i < count; i++) {
+                const Token& t = tokens[i];
+                if (t.Dist == 0) {
+                    bw.PutCode(lit.Codes[t.Length], lit.Lengths[t.Length]);
+                    continue;
+                }
+                int lc = LengthCode(t.Length);
+                bw.PutCode(lit.Codes[257 + lc], lit.Lengths[257 + lc]);
+                if (LengthExtra[lc]) bw.Put(t.Length - LengthBase[lc], LengthExtra[lc]);
+                int dc = DistCode(t.Dist);
+                bw.PutCode(dist.Codes[dc], dist.Lengths[dc]);
+                if (DistExtra[dc]) bw.Put(t.Dist - DistBase[dc], DistExtra[dc]);
+            }
+            bw.PutCode(lit.Codes[256], lit.Lengths[256]);
+        }
+
+        // one block over tokens that cover data[begin, end)
+        inline void WriteBlock(BitWriter& bw, const Token* tokens, size_t count, const uint8_t* data, size_t begin, size_t end, bool final) {
+            std::vector<uint32_t> litFreq(286, 0), distFreq(30, 0);
+            for (size_t i = 0; i < count; i++) {
+                if (tokens[i].Dist == 0) { litFreq[tokens[i].Length]++; continue; }
+                litFreq[257 + LengthCode(tokens[i].Length)]++;
+                distFreq[DistCode(tokens[i].Dist)]++;
+            }
+            litFreq[256] = 1;
+
+            Code lit, dist;
+            lit.Lengths = CodeLengths(litFreq, MaxBits);
+            dist.Lengths = CodeLengths(distFreq, MaxBits);
+            lit.Codes = CanonicalCodes(lit.Lengths);
+            dist.Codes = CanonicalCodes(dist.Lengths);
+
+            int litCount = 286, distCount = 30;
+            while (litCount > 257 && lit.Lengths[litCount - 1] == 0) litCount--;
+            while (distCount > 1 && dist.Lengths[distCount - 1] == 0) distCount--;
+            std::vector<uint8_t> all(lit.Lengths.begin(), lit.Lengths.begin() + litCount);
+            all.insert(all.end(), dist.Lengths.begin(), dist.Lengths.begin() + distCount);
+            std::vector<CodeLengthSymbol> runs = RunLengths(all);
+
+            std::vector<uint32_t> clFreq(19, 0);
+            for (auto& r : runs) clFreq[r.Symbol]++;
+            Code cl;
+            cl.Lengths = CodeLengths(clFreq, 7);
+            cl.Codes = CanonicalCodes(cl.Lengths);
+            int clCount = 19;
+            while (clCount > 4 && cl.Lengths[CodeLengthOrder[clCount - 1]] == 0) clCount--;
+
+            uint64_t dynamicBits = 14 + 3 * (uint64_t)clCount + SymbolBits(litFreq, distFreq, lit, dist);
+            for (auto& r : runs) dynamicBits += cl.Lengths[r.Symbol] + ExtraBits(r);
+            uint64_t fixedBits = SymbolBits(litFreq, distFreq, FixedLiteralCode(), FixedDistCode());
+            uint64_t storedBits = 8 * ((end - begin) + 5 * ((end - begin) / 65535 + 1)) + 7;
+
+            if (storedBits <= std::min(dynamicBits, fixedBits)) {
+                size_t at = begin;
+                do {
+                    size_t n = std::min<size_t>(end - at, 65535);
+                    bw.Put((final && at + n == end) ? 1 : 0, 1);
+                    bw.Put(0, 2);
+                    bw.Align();
+                    bw.Put((uint32_t)n, 16);
+                    bw.Put((uint32_t)(~n & 0xffff), 16);
+                    for (size_t i = 0; i < n; i++) bw.Put(data[at + i], 8);
+                    at += n;
+                } while (at < end);
+            }
+            else if (fixedBits <= dynamicBits) {
+                bw.Put(final ? 1 : 0, 1);
+                bw.Put(1, 2);
+                WriteSymbols(bw, tokens, count, FixedLiteralCode(), FixedDistCode());
+            }
+            else {
+                bw.Put(final ? 1 : 0, 1);
+                bw.Put(2, 2);
+                bw.Put(litCount - 257, 5);
+                bw.Put(distCount - 1, 5);
+                bw.Put(clCount - 4, 4);
+                for (int i = 0; i < clCount; i++) bw.Put(cl.Lengths[CodeLengthOrder[i]], 3);
+                for (auto& r : runs) {
+                    bw.PutCode(cl.Codes[r.Symbol], cl.Lengths[r.Symbol]);
+                    if (ExtraBits(r)) bw.Put(r.Extra, ExtraBits(r));
+                }
+                WriteSymbols(bw, tokens, count, lit, dist);
+            }
+        }
+    }
+
+    // Raw deflate of data onto out. With final unset the stream ends on an empty stored block
+    // (a sync flush), byte aligned, so another piece can follow it.
+    inline void Deflate(const uint8_t* data, size_t size, bool final, std::vector<uint8_t>& out) {
+        using namespace Detail;
+        BitWriter bw(out);
+        std::vector<int64_t> head((size_t)1 << HashBits, -1);
+        std::vector<int64_t> prev(WindowSize, -1);
+        auto hash = [&](size_t i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & ((1 << HashBits) - 1); };
+        auto insert = [&](size_t i) {
+            if (i + MinMatch > size) return;
+            int h = hash(i);
+            prev[i & (WindowSize - 1)] = head[h];
+            head[h] = (int64_t)i;
+        };
+        auto longest = [&](size_t i, int& bestDist) {
+            int best = 0;
+            if (i + MinMatch > size) return 0;
+            int limit = (int)std::min<size_t>(MaxMatch, size - i);
+            int64_t candidate = head[hash(i)];
+            for (int chain = 0; chain < MaxChain && candidate >= 0; chain++) {
+                int64_t dist = (int64_t)i - candidate;
+                if (dist <= 0 || dist > WindowSize) break;
+                const uint8_t* a = data + i;
+                const uint8_t* b = data + candidate;
+                // a match already as long as the input allows can't be beaten, and a[limit] is past it
+                if (best < limit && b[best] == a[best]) {
+                    int len = 0;
+                    while (len < limit && a[len] == b[len]) len++;
+                    if (len > best) {
+                        best = len;
+                        bestDist = (int)dist;
+                        if (len >= NiceMatch) break;
+                    }
+                }
+                int64_t next = prev[candidate & (WindowSize - 1)];
+                if (next >= candidate) break;
+                candidate = next;
+            }
+            return best >= MinMatch ? best : 0;
+        };
+
+        std::vector<Token> tokens;
+        tokens.reserve(BlockTokens);
+        size_t blockStart = 0;
+        size_t i = 0;
+        while (i < size) {
+            int dist = 0;
+            int len = longest(i, dist);
+            insert(i);
+            // lazy: a longer match one byte on is worth a literal first
+            if (len > 0 && len < NiceMatch && i + 1 < size) {
+                int nextDist = 0;
+                if (longest(i + 1, nextDist) > len) len = 0;
+            }
+
+            if (len > 0) {
+                tokens.push_back({ (uint16_t)len, (uint16_t)dist });
+                // long runs skip most inserts, the chains stay short on flat images
+                size_t end = i + len;
+                for (size_t j = i + 1; j < end && (len < 32 || j < i + 4); j++) insert(j);
+                i = end;
+            }
+            else {
+                tokens.push_back({ data[i], 0 });
+                i++;
+            }
+
+            if ((int)tokens.size() >= BlockTokens || i >= size) {
+                WriteBlock(bw, tokens.data(), tokens.size(), data, blockStart, i, final && i >= size);
+                tokens.clear();
+                blockStart = i;
+            }
+        }
+        if (size == 0 && final) {
+            WriteBlock(bw, nullptr, 0, data, 0, 0, true);
+        }
+        if (!final) {
+            bw.Put(0, 3);
+            bw.Align();
+            bw.Put(0, 16);
+            bw.Put(0xffff, 16);
+        }
+        bw.Align();
+    }
+
+    inline uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c) {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return a;
+        return pb <= pc ? b : c;
+    }
+
+    // Appends rows [y0, y1) of the image, each as a filter type byte and the filtered bytes.
+    // The filter per row is whichever gives the smallest sum of absolute signed bytes.
+    inline void FilterRows(const Draw::ImageView& image, int y0, int y1, std::vector<uint8_t>& out) {
+        int bpp = image.Channels;
+        size_t stride = (size_t)image.Width * bpp;
+        std::vector<uint8_t> zero(stride, 0);
+        std::vector<uint8_t> candidate[5];
+        for (auto& c : candidate) c.resize(stride);
+
+        for (int y = y0; y < y1; y++) {
+            const uint8_t* row = image.Row(y);
+            const uint8_t* up = y > 0 ? image.Row(y - 1) : zero.data();
+            uint64_t bestScore = UINT64_MAX;
+            int best = 0;
+            for (int type = 0; type < 5; type++) {
+                uint8_t* f = candidate[type].data();
+                uint64_t score = 0;
+                for (size_t i = 0; i < stride; i++) {
+                    uint8_t a = i >= (size_t)bpp ? row[i - bpp] : 0;
+                    uint8_t b = up[i];
+                    uint8_t c = i >= (size_t)bpp ? up[i - bpp] : 0;
+                    uint8_t predicted = 0;
+                    switch (type) {
+                    case 1: predicted = a; break;
+                    case 2: predicted = b; break;
+                    case 3: predicted = (uint8_t)((a + b) / 2); break;
+                    case 4: predicted = Paeth(a, b, c); break;
+                    }
+                    f[i] = (uint8_t)(row[i] - predicted);
+                    score += std::abs((int8_t)f[i]);
+                }
+                if (score < bestScore) { bestScore = score; best = type; }
+                // an all-zero row can't be beaten
+                if (score == 0) break;
+            }
+            out.push_back((uint8_t)best);
+            out.insert(out.end(), candidate[best].begin(), candidate[best].end());
+        }
+    }
+
+    inline void WriteChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+        PutBigEndian(out, (uint32_t)size);
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        if (size) out.insert(out.end(), data, data + size);
+        PutBigEndian(out, Crc32(out.data() + start, size + 4));
+    }
+
+    // signature and IHDR, 8 bits per sample: RGBA (color type 6) or palette indices (3)
+    inline std::vector<uint8_t> FileHeader(int width, int height, uint8_t colorType = 6) {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        std::vector<uint8_t> out(signature, signature + 8);
+        std::vector<uint8_t> ihdr;
+        PutBigEndian(ihdr, (uint32_t)width);
+        PutBigEndian(ihdr, (uint32_t)height);
+        const uint8_t rest[5] = { 8, colorType, 0, 0, 0 };
+        ihdr.insert(ihdr.end(), rest, rest + 5);
+        WriteChunk(out, "IHDR", ihdr.data(), ihdr.size());
+        return out;
+    }
+
+    inline void WriteEnd(std::vector<uint8_t>& out) { WriteChunk(out, "IEND", nullptr, 0); }
+
+    // zlib stream header: deflate, 32K window, no dictionary
+    constexpr uint8_t ZlibHeader[2] = { 0x78, 0x01 };
+
+    // zlib-wrapped image data (IDAT payload) for an RGBA view
+    inline std::vector<uint8_t> CompressImage(const Draw::ImageView& image) {
+        std::vector<uint8_t> filtered;
+        filtered.reserve(image.ByteSize() + image.Height);
+        FilterRows(image, 0, image.Height, filtered);
+
+        std::vector<uint8_t> out(ZlibHeader, ZlibHeader + 2);
+        Deflate(filtered.data(), filtered.size(), true, out);
+        PutBigEndian(out, Adler32(filtered.data(), filtered.size()));
+        return out;
+    }
+
+    // a complete .png file
+    inline std::vector<uint8_t> Encode(const Draw::ImageView& image) {
+        PROFILE_SCOPE("Encode PNG");
+        std::vector<uint8_t> out = FileHeader(image.Width, image.Height);
+        std::vector<uint8_t> idat = CompressImage(image);
+        WriteChunk(out, "IDAT", idat.data(), idat.size());
+        WriteEnd(out);
+        return out;
+    }
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <DXE.h>
+#include "imgui/imgui.h"
+
+// Lightweight scoped stage timers for the generation hot path.
+// Define SPRITEGEN_LITE to compile every PROFILE_* macro out.
+namespace Profiler {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Event {
+        const char* Name;   // must be a string literal
+        int64_t Start;      // microseconds since capture began
+        int64_t Duration;   // microseconds
+        int64_t Self;       // Duration minus nested scopes
+        int Frame;          // -1 when not tied to a frame
+        int Depth;          // nesting level on its thread
+    };
+
+    struct ThreadTrack {
+        std::string Name;
+        int Id = 0;
+        std::mutex Lock;    // only contended while the UI reads a live capture
+        std::vector<Event> Events;
+    };
+
+    class Capture {
+    public:
+        static Capture& Get() { static Capture instance; return instance; }
+
+        void Begin(const char* label) {
+            std::lock_guard<std::mutex> lock(Lock);
+            Tracks.clear();
+            Label = label;
+            Origin = Clock::now().time_since_epoch().count();
+            Epoch++;
+        }
+
+        int64_t Now() const {
+            Clock::time_point origin{ Clock::duration(Origin.load(std::memory_order_relaxed)) };
+            return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - origin).count();
+        }
+
+        // registers the calling thread with the current capture on first use
+        ThreadTrack* Track() {
+            thread_local std::shared_ptr<ThreadTrack> track;
+            thread_local uint32_t trackEpoch = 0;
+
+            uint32_t epoch = Epoch.load();
+            if (!track || trackEpoch != epoch) {
+                std::lock_guard<std::mutex> lock(Lock);
+                track = std::make_shared<ThreadTrack>();
+                Tracks.push_back(track);
+                track->Id = (int)Tracks.size();
+                track->Name = ThreadName().empty() ? "Thread " + std::to_string(track->Id) : ThreadName();
+                trackEpoch = epoch;
+            }
+            return track.get();
+        }
+
+        static std::string& ThreadName() { thread_local std::string name; return name; }
+        static int& CurrentFrame() { thread_local int frame = -1; return frame; }
+        static int& CurrentDepth() { thread_local int depth = 0; return depth; }
+        static int64_t* ChildTime() { thread_local int64_t time[MaxDepth + 1] = {}; return time; }
+
+        static constexpr int MaxDepth = 32;
+
+        std::mutex Lock;
+        std::vector<std::shared_ptr<ThreadTrack>> Tracks;
+        std::string Label;
+        // clock ticks, atomic: a capture may restart while workers are timing scopes
+        std::atomic<Clock::rep> Origin = Clock::now().time_since_epoch().count();
+        std::atomic<uint32_t> Epoch = 0;
+    };
+
+    inline void BeginCapture(const char* label) { Capture::Get().Begin(label); }
+    inline void SetThreadName(const std::string& name) { Capture::ThreadName() = name; }
+
+    class ScopedTimer {
+    public:
+        ScopedTimer(const char* name, int frame = -1) : name(name) {
+            int& current = Capture::CurrentFrame();
+            previousFrame = current;
+            if (frame >= 0) current = frame;
+            this->frame = current;
+            depth = std::min(Capture::CurrentDepth()++, Capture::MaxDepth - 1);
+            Capture::ChildTime()[depth + 1] = 0;
+            start = Capture::Get().Now();
+        }
+        ~ScopedTimer() {
+            int64_t duration = Capture::Get().Now() - start;
+            Capture::CurrentDepth()--;
+            Capture::CurrentFrame() = previousFrame;
+
+            int64_t* childTime = Capture::ChildTime();
+            int64_t self = duration - childTime[depth + 1];
+            childTime[depth] += duration;
+
+            ThreadTrack* track = Capture::Get().Track();
+            std::lock_guard<std::mutex> lock(track->Lock);
+            track->Events.push_back({ name, start, duration, self, frame, depth });
+        }
+    private:
+        const char* name;
+        int64_t start;
+        int frame;
+        int previousFrame;
+        int depth;
+    };
+
+    // a JSON string body; labels, thread names and file names carry generator and export names, which may hold anything
+    inline std::string JsonEscape(const std::string& text) {
+        std::string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') { out += '\\'; out += c; }
+            else if ((unsigned char)c < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+                out += code;
+            }
+            else out += c;
+        }
+        return out;
+    }
+
+    // Chrome / Perfetto "traceEvents" JSON, loadable in chrome://tracing or ui.perfetto.dev
+    inline bool ExportChromeTrace(const std::string& path) {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) return false;
+
+        Capture& capture = Capture::Get();
+        std::lock_guard<std::mutex> lock(capture.Lock);
+
+        std::string category = JsonEscape(capture.Label);
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        auto separator = [&]() { if (!first) out << ",\n"; first = false; };
+
+        for (auto& track : capture.Tracks) {
+            std::lock_guard<std::mutex> trackLock(track->Lock);
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track->Id
+                << ",\"args\":{\"name\":\"" << JsonEscape(track->Name) << "\"}}";
+            for (const Event& e : track->Events) {
+                separator();
+                out << "{\"name\":\"" << JsonEscape(e.Name) << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track->Id
+                    << ",\"ts\":" << e.Start << ",\"dur\":" << e.Duration;
+                if (e.Frame >= 0) out << ",\"args\":{\"frame\":" << e.Frame << "}";
+                out << "}";
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return true;
+    }
+
+    inline void DrawWindow() {
+        ImGui::Begin("Profiler");
+
+        Capture& capture = Capture::Get();
+
+        struct Stage { const char* Name; int Count = 0; int64_t Total = 0; int64_t Self = 0; int64_t Max = 0; };
+        struct Lane { std::string Name; std::vector<Event> Events; int64_t Busy = 0; int64_t First = 0; int64_t Last = 0; };
+        std::vector<Stage> stages;
+        std::vector<Lane> lanes;
+        int64_t captureEnd = 0;
+        std::string label;
+
+        {
+            std::lock_guard<std::mutex> lock(capture.Lock);
+            label = capture.Label;
+            for (auto& track : capture.Tracks) {
+                std::lock_guard<std::mutex> trackLock(track->Lock);
+                if (track->Events.empty()) continue;
+
+                Lane lane;
+                lane.Name = track->Name;
+                lane.Events = track->Events;
+                lane.First = INT64_MAX;
+                for (const Event& e : lane.Events) {
+                    if (e.Depth == 0) lane.Busy += e.Duration;
+                    lane.First = std::min(lane.First, e.Start);
+                    lane.Last = std::max(lane.Last, e.Start + e.Duration);
+
+                    auto it = std::find_if(stages.begin(), stages.end(), [&](const Stage& s) { return std::strcmp(s.Name, e.Name) == 0; });
+                    if (it == stages.end()) { stages.push_back({ e.Name }); it = stages.end() - 1; }
+                    it->Count++;
+                    it->Total += e.Duration;
+                    it->Self += e.Self;
+                    it->Max = std::max(it->Max, e.Duration);
+                }
+                captureEnd = std::max(captureEnd, lane.Last);
+                lanes.push_back(std::move(lane));
+            }
+        }
+
+#ifdef SPRITEGEN_LITE
+        ImGui::TextDisabled("Profiling compiled out (SPRITEGEN_LITE)");
+#endif
+        ImGui::Text("%s: %.2f ms", label.empty() ? "No capture" : label.c_str(), captureEnd / 1000.0);
+
+        if (ImGui::Button("Export Chrome Trace")) {
+            if (ExportChromeTrace("spritegen_trace.json")) { DXE_INFO("Wrote spritegen_trace.json"); }
+            else { DXE_LOG("Failed to write spritegen_trace.json"); }
+        }
+
+        if (ImGui::BeginTable("Stages", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("Total ms");
+            ImGui::TableSetupColumn("Self ms");
+            ImGui::TableSetupColumn("Max ms");
+            ImGui::TableHeadersRow();
+            for (const Stage& s : stages) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(s.Name);
+                ImGui::TableNextColumn(); ImGui::Text("%d", s.Count);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", s.Total / 1000.0);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", s.Self / 1000.0);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", s.Max / 1000.0);
+            }
+            ImGui::EndTable();
+        }
+
+        ImGui::SeparatorText("Threads");
+        if (captureEnd <= 0) { ImGui::End(); return; }
+
+        // one lane per thread, idle time is whatever the top-level scopes don't cover
+        const float laneHeight = 14.f;
+        const float labelWidth = 150.f;
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        float width = std::max(50.f, ImGui::GetContentRegionAvail().x - labelWidth);
+        float scale = width / (float)captureEnd;
+
+        for (const Lane& lane : lanes) {
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            double idle = (captureEnd - lane.Busy) / 1000.0;
+            ImGui::Text("%s  idle %.1f ms", lane.Name.c_str(), idle);
+            if (lane.Last == captureEnd && lanes.size() > 1) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("(last)");
+            }
+
+            ImVec2 bar = { origin.x + labelWidth, origin.y };
+            draw_list->AddRectFilled(bar, { bar.x + width, bar.y + laneHeight }, IM_COL32(30, 30, 30, 255));
+            for (const Event& e : lane.Events) {
+                float x0 = bar.x + e.Start * scale;
+                float x1 = std::max(x0 + 1.f, bar.x + (e.Start + e.Duration) * scale);
+                float inset = std::min(e.Depth * 3.f, laneHeight * 0.5f - 1.f);
+                ImU32 col = e.Depth == 0 ? IM_COL32(70, 140, 220, 255) : IM_COL32(230, 160, 50, 255);
+                draw_list->AddRectFilled({ x0, bar.y + inset }, { x1, bar.y + laneHeight - inset }, col);
+            }
+            ImGui::SetCursorScreenPos({ origin.x, origin.y + std::max(laneHeight, ImGui::GetTextLineHeight()) + 4.f });
+        }
+
+        ImGui::End();
+    }
+}
+
+#ifndef SPRITEGEN_LITE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) Profiler::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_SCOPE_FRAME(name, frame) Profiler::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name, frame)
+#define PROFILE_BEGIN_CAPTURE(label) Profiler::BeginCapture(label)
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_FRAME(name, frame) ((void)0)
+#define PROFILE_BEGIN_CAPTURE(label) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,337 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include "FrameStore.h"
+
+// The trimming both on-disk caches share, RenderCache's entries and the render service's
+// folders: whatever went unused for maxAge goes, then the least recently used until the rest
+// fits in maxBytes. Each cache scans its own folder and removes what this picks.
+namespace CacheEviction {
+    // a write that never finished and is older than this was left by a writer that died
+    static constexpr std::chrono::hours LeftoverAge{ 1 };
+
+    struct Entry { std::filesystem::path Path; uint64_t Bytes; std::filesystem::file_time_type Time; };
+
+    // Sorts entries oldest first and returns how many of the front ones go; kept is what the
+    // rest add up to. A zero maxAge is no age limit.
+    inline size_t Expired(std::vector<Entry>& entries, uint64_t maxBytes, std::chrono::hours maxAge, uint64_t& kept) {
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.Time < b.Time; });
+        auto now = std::filesystem::file_time_type::clock::now();
+        kept = 0;
+        for (auto& entry : entries) kept += entry.Bytes;
+        size_t count = 0;
+        for (; count < entries.size(); count++) {
+            bool unused = maxAge.count() > 0 && now - entries[count].Time > maxAge;
+            if (!unused && kept <= maxBytes) break;
+            kept -= entries[count].Bytes;
+        }
+        return count;
+    }
+}
+
+// Finished sequences on disk, named by a hash of everything that decides their pixels, so a
+// preset rendered once, in an earlier session or on another machine sharing the folder, loads
+// instead of rendering again. The folder may be a network share or a CI cache: entries appear
+// whole through a rename, are only used once their full key matches, and the least recently
+// used ones go when the folder outgrows its limit. Everything that touches the folder can run
+// on the cache's own thread, one task after another, so a slow share never stalls the UI.
+class RenderCache {
+public:
+    static constexpr char Magic[8] = { 'S', 'G', 'C', 'A', 'C', 'H', 'E', 'S' };
+    static constexpr uint32_t Version = 1;
+    static constexpr uint64_t DefaultMaxBytes = 2ull << 30;
+
+    struct Header {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Size;
+        uint32_t FrameCount;
+        uint32_t KeyBytes;
+        uint64_t DataBytes;
+        uint64_t Checksum;      // FNV-1a of the frame data
+        // followed by the key, FrameCount uint64 stream ends and the streams: frame 0 on its
+        // own, every later frame XORed with the one before, all Rle coded
+    };
+
+    struct Stats {
+        int Hits = 0;
+        int Misses = 0;
+        int Stored = 0;
+        int Entries = 0;        // as of the last eviction pass
+        uint64_t Bytes = 0;
+    };
+
+    // SPRITEGEN_RENDER_CACHE points a team's machines or a CI job at one shared folder
+    static std::filesystem::path DefaultDirectory() {
+        if (const char* shared = std::getenv("SPRITEGEN_RENDER_CACHE")) return shared;
+        const char* base = std::getenv("LOCALAPPDATA");
+        std::filesystem::path dir = base ? std::filesystem::path(base) / "SpriteGen" : std::filesystem::path(".");
+        return dir / "RenderCache";
+    }
+
+    explicit RenderCache(std::filesystem::path folder = DefaultDirectory(), uint64_t maxBytes = DefaultMaxBytes)
+        : Folder(std::move(folder)), MaxBytes(maxBytes), Worker(&RenderCache::TaskLoop, this) {}
+    // what is queued still runs, a finished preview is worth keeping
+    ~RenderCache() {
+        {
+            std::lock_guard<std::mutex> lock(TaskLock);
+            Stopping = true;
+        }
+        TaskReady.notify_all();
+        Worker.join();
+    }
+
+    // The key of a job's frames: the generator chain it renders plus everything the job
+    // decides. false when something in the chain can't be cached.
+    static bool Key(IFrameGenerator& generator, int size, int frameCount, KernelVariant variant, StateKey& key) {
+        key.Add(Version).Add(size).Add(frameCount).Add(generator.IsLooping()).Add(variant);
+        return IFrameGenerator::HashGenerator(generator, key);
+    }
+
+    const std::filesystem::path& Directory() const { return Folder; }
+    uint64_t MaxSize() const { return MaxBytes; }
+    void SetMaxSize(uint64_t bytes) { MaxBytes = bytes; }
+    Stats GetStats() const { std::lock_guard<std::mutex> lock(Lock); return stats; }
+
+    // Load on the cache thread; done(hit) is called there once the sink has every frame or
+    // the entry missed. The sink is let go of before done, so a caller that keeps it until then
+    // also destroys it on its own thread.
+    void LoadAsync(StateKey key, int size, int frameCount, std::shared_ptr<FrameSink> sink, std::function<void(bool)> done) {
+        Post([this, key = std::move(key), size, frameCount, sink = std::move(sink), done = std::move(done)]() mutable {
+            bool hit = Load(key, size, frameCount, *sink);
+            sink.reset();
+            done(hit);
+        });
+    }
+
+    // blocks until everything posted so far has run; for shutdown, never from a frame
+    void Flush() {
+        std::promise<void> flushed;
+        std::future<void> done = flushed.get_future();
+        Post([&]() { flushed.set_value(); });
+        done.wait();
+    }
+
+    // Store on the cache thread, with each frame from frame(f, pixels) there: a view of
+    // pixels it keeps elsewhere, or of the buffer it was handed and filled. Whatever it reads
+    // from has to be kept alive by its captures.
+    using FrameSource = std::function<Draw::ImageView(int, std::vector<uint8_t>&)>;
+    void StoreAsync(StateKey key, int frameCount, FrameSource frame) {
+        Post([this, key = std::move(key), frameCount, frame = std::move(frame)]() {
+            std::vector<std::vector<uint8_t>> copies(frameCount);
+            std::vector<Draw::ImageView> frames;
+            for (int f = 0; f < frameCount; f++) frames.push_back(frame(f, copies[f]));
+            Store(key, frames);
+        });
+    }
+
+    // Hands the cached frames to sink in order. Nothing reaches the sink unless the whole
+    // entry checks out, a miss leaves it untouched.
+    bool Load(const StateKey& key, int size, int frameCount, FrameSink& sink) {
+        PROFILE_SCOPE("Render Cache Load");
+        std::vector<uint64_t> ends(frameCount);
+        std::vector<uint8_t> data;
+        std::filesystem::path path = EntryPath(key);
+        if (!ReadEntry(path, key, size, frameCount, ends, data)) {
+            std::lock_guard<std::mutex> lock(Lock);
+            stats.Misses++;
+            return false;
+        }
+
+        size_t pixelCount = (size_t)size * size;
+        std::vector<uint8_t> pixels(pixelCount * 4);
+        Draw::ImageView frame = { pixels.data(), size, size, 4 };
+        for (int f = 0; f < frameCount; f++) {
+            Rle::Decode(data.data() + (f ? ends[f - 1] : 0), pixels.data(), pixelCount, f > 0);
+            Draw::ImageView out = sink.Acquire(f);
+            for (int y = 0; y < size; y++) std::memcpy(out.Row(y), frame.Row(y), frame.RowBytes());
+            sink.Complete(f);
+        }
+
+        // the write time is the recency eviction goes by; a read-only share just doesn't get it
+        std::error_code ec;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+        std::lock_guard<std::mutex> lock(Lock);
+        stats.Hits++;
+        return true;
+    }
+
+    // Encodes packed size x size frames, a frame per worker, writes the entry and evicts.
+    // Blocks on the folder, which may be across a network; the UI goes through StoreAsync.
+    void Store(const StateKey& key, const std::vector<Draw::ImageView>& frames) {
+        if (frames.empty()) return;
+        PROFILE_SCOPE("Render Cache Encode");
+        size_t pixelCount = (size_t)frames[0].Width * frames[0].Height;
+        std::vector<std::vector<uint8_t>> streams(frames.size());
+        Draw::ParallelFor((int)frames.size(), (int)std::thread::hardware_concurrency(), [&](int b, int e) {
+            for (int f = b; f < e; f++) Rle::Encode(frames[f].Pixels, f ? frames[f - 1].Pixels : nullptr, pixelCount, streams[f]);
+        });
+
+        Header header = {};
+        std::memcpy(header.Magic, Magic, sizeof(Magic));
+        header.Version = Version;
+        header.Size = (uint32_t)frames[0].Width;
+        header.FrameCount = (uint32_t)frames.size();
+        header.KeyBytes = (uint32_t)key.Bytes.size();
+        std::vector<uint64_t> ends;
+        for (auto& stream : streams) ends.push_back(header.DataBytes += stream.size());
+
+        std::vector<uint8_t> entry(sizeof(Header) + key.Bytes.size() + ends.size() * sizeof(uint64_t));
+        entry.reserve(entry.size() + header.DataBytes);
+        for (auto& stream : streams) entry.insert(entry.end(), stream.begin(), stream.end());
+        header.Checksum = Checksum(entry.data() + entry.size() - header.DataBytes, header.DataBytes);
+        size_t keyOffset = sizeof(Header), endsOffset = keyOffset + key.Bytes.size();
+        std::memcpy(entry.data(), &header, sizeof(Header));
+        std::memcpy(entry.data() + keyOffset, key.Bytes.data(), key.Bytes.size());
+        std::memcpy(entry.data() + endsOffset, ends.data(), ends.size() * sizeof(uint64_t));
+
+        bool written = WriteEntry(EntryPath(key), entry);
+        Evict();
+        if (!written) return;
+        std::lock_guard<std::mutex> lock(Lock);
+        stats.Stored++;
+    }
+
+private:
+    void Post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(TaskLock);
+            Tasks.push_back(std::move(task));
+        }
+        TaskReady.notify_one();
+    }
+
+    void TaskLoop() {
+        PROFILE_THREAD_NAME("Render Cache");
+        std::unique_lock<std::mutex> lock(TaskLock);
+        while (true) {
+            TaskReady.wait(lock, [&]() { return Stopping || !Tasks.empty(); });
+            if (Tasks.empty()) return;
+            std::function<void()> task = std::move(Tasks.front());
+            Tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    static constexpr const char* Extension = ".sgc";
+
+    static uint64_t Checksum(const uint8_t* data, size_t size) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) { h = (h ^ data[i]) * 1099511628211ull; }
+        return h;
+    }
+
+    std::filesystem::path EntryPath(const StateKey& key) const {
+        char name[24];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key.Hash());
+        return Folder / (std::string(name) + Extension);
+    }
+
+    // the key is compared in full, keys whose hashes collide don't share frames
+    static bool ReadEntry(const std::filesystem::path& path, const StateKey& key, int size, int frameCount,
+        std::vector<uint64_t>& ends, std::vector<uint8_t>& data)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in || ends.empty()) return false;
+        Header header = {};
+        std::string stored(key.Bytes.size(), '\0');
+        if (!in.read((char*)&header, sizeof(Header)) || std::memcmp(header.Magic, Magic, sizeof(Magic)) != 0 ||
+            header.Version != Version || header.Size != (uint32_t)size || header.FrameCount != (uint32_t)frameCount ||
+            header.KeyBytes != key.Bytes.size() || !in.read(stored.data(), stored.size()) || stored != key.Bytes) {
+            return false;
+        }
+        if (!in.read((char*)ends.data(), ends.size() * sizeof(uint64_t)) || ends.back() != header.DataBytes) return false;
+        for (int f = 1; f < frameCount; f++) {
+            if (ends[f] < ends[f - 1]) return false;
+        }
+        data.resize(header.DataBytes);
+        if (!in.read((char*)data.data(), data.size()) || Checksum(data.data(), data.size()) != header.Checksum) {
+            DXE_LOG("Render cache entry is damaged: ", path.string());
+            return false;
+        }
+        return true;
+    }
+
+    // Written under a name of its own and renamed into place, so readers anywhere on the share
+    // see the whole entry or none. Two writers of one key write the same bytes, either rename
+    // may win.
+    static bool WriteEntry(const std::filesystem::path& path, const std::vector<uint8_t>& entry) {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        std::filesystem::path temp = path;
+        temp += "." + std::to_string(std::random_device()()) + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary);
+            if (!out.write((const char*)entry.data(), entry.size()) || !out.flush()) {
+                out.close();
+                std::filesystem::remove(temp, ec);
+                DXE_LOG("Failed to write render cache entry: ", temp.string());
+                return false;
+            }
+        }
+        std::filesystem::rename(temp, path, ec);
+        if (ec) {
+            std::filesystem::remove(temp, ec);
+            // another process holding the entry open still means the entry is there
+            return std::filesystem::exists(path, ec);
+        }
+        return true;
+    }
+
+    // oldest first until the folder fits; leftovers of writers that died go after an hour
+    void Evict() {
+        std::vector<CacheEviction::Entry> entries;
+        std::error_code ec;
+        auto now = std::filesystem::file_time_type::clock::now();
+        for (auto& item : std::filesystem::directory_iterator(Folder, ec)) {
+            std::error_code e;
+            auto time = item.last_write_time(e);
+            if (e) continue;
+            if (item.path().extension() == ".tmp") {
+                if (now - time > CacheEviction::LeftoverAge) std::filesystem::remove(item.path(), e);
+                continue;
+            }
+            if (item.path().extension() != Extension) continue;
+            uint64_t bytes = item.file_size(e);
+            if (e) continue;
+            entries.push_back({ item.path(), bytes, time });
+        }
+
+        uint64_t total = 0;
+        size_t removed = CacheEviction::Expired(entries, MaxBytes, std::chrono::hours(0), total);
+        for (size_t i = 0; i < removed; i++) std::filesystem::remove(entries[i].Path, ec);
+
+        std::lock_guard<std::mutex> lock(Lock);
+        stats.Entries = (int)(entries.size() - removed);
+        stats.Bytes = total;
+    }
+
+    const std::filesystem::path Folder;
+    std::atomic<uint64_t> MaxBytes;
+
+    mutable std::mutex Lock;
+    Stats stats;
+
+    std::mutex TaskLock;
+    std::condition_variable TaskReady;
+    std::deque<std::function<void()>> Tasks;
+    bool Stopping = false;
+    std::thread Worker;     // last, starts once everything above exists
+};
@@ -0,0 +1,421 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+#include <climits>
+#include <cstring>
+#include <chrono>
+#include "FrameRenderer.h"
+
+// Receives a job's frames. Acquire runs on a worker before the first tile of a frame,
+// Complete once the frame's FinishFrame pass is done.
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+    virtual Draw::ImageView Acquire(int frame) = 0;
+    virtual void Complete(int frame) {}
+    // frames a job may hold at once before Acquire blocks
+    virtual int MaxHeld() const { return INT_MAX; }
+    // Whether `count` more frames would be acquired without blocking. The scheduler asks before
+    // a job starts a new group and leaves the job alone while it's no, so workers serve other
+    // jobs instead of waiting in Acquire for a sink that is behind.
+    virtual bool CanAcquire(int count) const { return true; }
+    // Frame `frame` shows the same pixels as `source`, which completes right after. A sink that
+    // can share source's storage records it and returns true, the frame is then ready along with
+    // source; otherwise the job copies the pixels in through Acquire and Complete.
+    virtual bool Alias(int frame, int source) { return false; }
+};
+
+// Frames land in DXE textures allocated on the UI thread, which takes them back with Take().
+// Finished frames are queued so the UI can upload and show them before the whole job is done,
+// and can get a small thumbnail made by the worker that finished them.
+class TextureSink : public FrameSink {
+public:
+    static constexpr int ThumbnailSize = 32;
+
+    TextureSink(int size, int frameCount, bool thumbnails = false) {
+        PROFILE_SCOPE("Allocate Textures");
+        for (int i = 0; i < frameCount; i++) { Textures.push_back(new DXE::Texture(size, size, 4)); }
+        for (auto* tex : Textures) { Views.push_back(Draw::ImageView::Of(tex)); }
+        if (thumbnails) {
+            for (int i = 0; i < frameCount; i++) { Thumbnails.push_back(new DXE::Texture(ThumbnailSize, ThumbnailSize, 4)); }
+        }
+    }
+    ~TextureSink() {
+        for (auto* tex : Textures) { delete tex; }
+        for (auto* tex : Thumbnails) { delete tex; }
+    }
+
+    Draw::ImageView Acquire(int frame) override { return Views[frame]; }
+    void Complete(int frame) override {
+        if (!Thumbnails.empty()) {
+            PROFILE_SCOPE("Thumbnail");
+            Draw::Downsample(Views[frame], Draw::ImageView::Of(Thumbnails[frame]));
+        }
+        std::lock_guard<std::mutex> lock(ReadyLock);
+        Ready.push_back(frame);
+    }
+
+    // frames finished since the last call, their pixels are no longer written
+    std::vector<int> TakeReady() {
+        std::lock_guard<std::mutex> lock(ReadyLock);
+        return std::exchange(Ready, {});
+    }
+    DXE::Texture* Texture(int frame) const { return Textures[frame]; }
+    DXE::Texture* Thumbnail(int frame) const { return Thumbnails.empty() ? nullptr : Thumbnails[frame]; }
+    std::vector<DXE::Texture*> Take() { Views.clear(); return std::exchange(Textures, {}); }
+    std::vector<DXE::Texture*> TakeThumbnails() { return std::exchange(Thumbnails, {}); }
+
+private:
+    std::vector<DXE::Texture*> Textures;
+    std::vector<DXE::Texture*> Thumbnails;
+    std::vector<Draw::ImageView> Views;
+    std::mutex ReadyLock;
+    std::vector<int> Ready;
+};
+
+// Frames land in caller-owned buffers.
+class ViewSink : public FrameSink {
+public:
+    explicit ViewSink(std::vector<Draw::ImageView> views) : Views(std::move(views)) {}
+    Draw::ImageView Acquire(int frame) override { return Views[frame]; }
+private:
+    std::vector<Draw::ImageView> Views;
+};
+
+// Earlier entries are served first when jobs compete for workers.
+enum class JobPriority { Preview, Compare, Export };
+
+// Everything one render needs, captured at submit time: a private copy of the generator
+// with its parameters, the frame size and times, the settings and the output sink.
+// Workers only ever see the job, never AppLayer state.
+class RenderJob {
+public:
+    RenderJob(const IFrameGenerator& generator, int size, std::vector<double> times, RenderSettings settings,
+        JobPriority priority, std::shared_ptr<FrameSink> sink)
+        : Name(generator.GetName()), Size(size), Times(std::move(times)), Settings(settings), Priority(priority),
+        Generator(generator.Clone()), Sink(std::move(sink))
+    {
+        TileRows = (Settings.TileRows > 0) ? std::min(Settings.TileRows, Size) : Size;
+        TilesPerFrame = (Size + TileRows - 1) / TileRows;
+        Variant = Generator->HasSimdKernel() ? Settings.Variant : KernelVariant::Scalar;
+        ThreadCap = Settings.ResolveThreads();
+        Looping = Generator->IsLooping();
+        // a generator that repeats within the sequence only renders its first period
+        Period = Settings.Periodic ? Render::PeriodFrames(*Generator, Times) : FrameCount();
+
+        // Sequence kernels take runs of frames per call. Every worker may be starting a run at
+        // once, so runs stay small enough that the sink never has to block inside one.
+        int run = 1;
+        if (Generator->HasSequenceKernel() && Settings.SequenceFrames > 1) {
+            run = std::clamp(Sink->MaxHeld() / ThreadCap, 1, Settings.SequenceFrames);
+        }
+        Groups = std::vector<GroupState>((Period + run - 1) / run);
+        for (int g = 0; g < (int)Groups.size(); g++) {
+            GroupState& group = Groups[g];
+            group.First = g * run;
+            group.Times.assign(Times.begin() + group.First, Times.begin() + std::min(group.First + run, Period));
+            group.Views.resize(group.Times.size());
+            group.TilesLeft = TilesPerFrame;
+        }
+        TotalItems = (int)Groups.size() * TilesPerFrame;
+    }
+
+    const std::string Name;
+    const int Size;
+    const std::vector<double> Times;
+    const RenderSettings Settings;
+    const JobPriority Priority;
+
+    int FrameCount() const { return (int)Times.size(); }
+    // frames actually rendered, the rest are aliases of these
+    int UniqueFrames() const { return Period; }
+    int FramesDone() const { return CompletedFrames.load(); }
+    float Progress() const { return FrameCount() ? (float)FramesDone() / FrameCount() : 1.f; }
+
+    // Viewer hint for the frame order: the focused frame first, then its playback neighbours,
+    // then frames visible in the timeline, then the rest. Safe to call from the UI at any time.
+    void SetFocus(int frame, int firstVisible, int lastVisible) {
+        if (frame == FocusFrame && firstVisible == VisibleFirst && lastVisible == VisibleLast) return;
+        FocusFrame = frame;
+        VisibleFirst = firstVisible;
+        VisibleLast = lastVisible;
+        FocusVersion++;
+    }
+
+    bool IsCancelled() const { return Cancelled.load(); }
+    bool IsFinished() const { return Finished.load(); }
+    void Cancel() { Cancelled = true; }
+    void Wait() const { Finished.wait(false); }
+
+    template<typename T> T* SinkAs() const { return dynamic_cast<T*>(Sink.get()); }
+
+private:
+    friend class RenderScheduler;
+
+    // consecutive frames rendered by the same calls, a single frame unless the generator has a sequence kernel
+    struct GroupState {
+        int First = 0;
+        std::vector<double> Times;
+        std::vector<Draw::ImageView> Views;
+        int NextTile = 0;   // scheduler lock
+        std::atomic<bool> Ready = false;
+        std::atomic<int> TilesLeft = 0;
+    };
+    struct Item { int Group; int Tile; };
+
+    static constexpr int NeighbourWindow = 4;
+
+    // lower renders sooner
+    int Rank(int frame) const {
+        int focus = FocusFrame.load();
+        if (focus < 0) return frame;
+
+        // only the first period is rendered, a focus past it wants the frame it aliases
+        int n = Period;
+        focus %= n;
+        int ahead = frame - focus;
+        int behind = focus - frame;
+        if (Looping) { ahead = (ahead + n) % n; behind = (behind + n) % n; }
+
+        if (frame == focus) return 0;
+        if (ahead > 0 && ahead <= NeighbourWindow) return ahead;
+        if (behind > 0 && behind <= NeighbourWindow) return NeighbourWindow + behind;
+
+        int distance = std::abs(frame - focus);
+        if (frame >= VisibleFirst.load() && frame <= VisibleLast.load()) return 2 * NeighbourWindow + 1 + distance;
+        return 2 * NeighbourWindow + 1 + n + distance;
+    }
+
+    // a group ranks as its most wanted frame
+    int PickGroup() const {
+        int best = -1;
+        int bestRank = INT_MAX;
+        for (int g = 0; g < (int)Groups.size(); g++) {
+            if (Groups[g].NextTile >= TilesPerFrame) continue;
+            for (int f = Groups[g].First; f < Groups[g].First + (int)Groups[g].Times.size(); f++) {
+                int rank = Rank(f);
+                if (rank < bestRank) { bestRank = rank; best = g; }
+            }
+        }
+        return best;
+    }
+
+    // scheduler lock held
+    bool HasWork() {
+        SinkFull = false;
+        if (IsCancelled() || NextItem >= TotalItems || ActiveWorkers >= ThreadCap) return false;
+        // keep splitting the current group across workers until its tiles run out or the viewer moves,
+        // so one rescan over the frames happens per group rather than per tile
+        uint32_t version = FocusVersion.load();
+        if (CurrentGroup < 0 || Groups[CurrentGroup].NextTile >= TilesPerFrame || version != SeenFocusVersion) {
+            SeenFocusVersion = version;
+            CurrentGroup = PickGroup();
+        }
+        // a new group's buffers also count the ones claimed groups are still acquiring
+        const GroupState& group = Groups[CurrentGroup];
+        if (group.NextTile == 0 && !Sink->CanAcquire(Acquiring.load() + (int)group.Times.size())) SinkFull = true;
+        return !SinkFull;
+    }
+    bool Drained() const { return ActiveWorkers == 0 && (IsCancelled() || CompletedTiles.load() == TotalItems); }
+    // right after HasWork returned true
+    Item Claim() {
+        GroupState& group = Groups[CurrentGroup];
+        if (group.NextTile == 0) Acquiring += (int)group.Times.size();
+        NextItem++;
+        return { CurrentGroup, group.NextTile++ };
+    }
+
+    // worker thread, no lock held
+    void Run(const Item& item) {
+        GroupState& group = Groups[item.Group];
+        int count = (int)group.Views.size();
+
+        // tile 0 of a group is always claimed first, later tiles wait for its buffers
+        if (item.Tile == 0) {
+            for (int i = 0; i < count; i++) group.Views[i] = Sink->Acquire(group.First + i);
+            Acquiring -= count;
+            group.Ready = true;
+            group.Ready.notify_all();
+        }
+        else {
+            group.Ready.wait(false);
+        }
+
+        int y0 = item.Tile * TileRows;
+        int y1 = std::min(y0 + TileRows, Size);
+        {
+            PROFILE_SCOPE_FRAME("Generate", group.First);
+            if (count == 1) { Generator->GenerateTile(group.Views[0], group.Times[0], y0, y1, Variant); }
+            else { Generator->GenerateSequenceTile(group.Views, group.Times, y0, y1, Variant); }
+            if (--group.TilesLeft == 0) {
+                for (int i = 0; i < count; i++) {
+                    int frame = group.First + i;
+                    Generator->FinishFrame(group.Views[i], group.Times[i]);
+                    // the same frame in every later period, shared by the sink or copied in
+                    for (int alias = frame + Period; alias < FrameCount(); alias += Period) {
+                        if (!Sink->Alias(alias, frame)) {
+                            Draw::ImageView copy = Sink->Acquire(alias);
+                            for (int y = 0; y < Size; y++) std::memcpy(copy.Row(y), group.Views[i].Row(y), copy.RowBytes());
+                            Sink->Complete(alias);
+                        }
+                        CompletedFrames++;
+                    }
+                    Sink->Complete(frame);
+                    CompletedFrames++;
+                }
+            }
+        }
+        CompletedTiles++;
+    }
+
+    void MarkFinished() {
+        Finished = true;
+        Finished.notify_all();
+    }
+
+    std::unique_ptr<IFrameGenerator> Generator;
+    std::shared_ptr<FrameSink> Sink;
+    std::vector<GroupState> Groups;
+
+    int TileRows = 0;
+    int TilesPerFrame = 1;
+    int TotalItems = 0;
+    int ThreadCap = 1;
+    bool Looping = false;
+    int Period = 0;         // frames rendered, FrameCount() when nothing repeats
+    KernelVariant Variant = KernelVariant::Scalar;
+
+    int NextItem = 0;       // scheduler lock
+    int ActiveWorkers = 0;  // scheduler lock
+    int CurrentGroup = -1;  // scheduler lock
+    uint32_t SeenFocusVersion = 0;  // scheduler lock
+    bool SinkFull = false;  // scheduler lock, HasWork turned the job away until the sink catches up
+
+    std::atomic<int> FocusFrame = -1;
+    std::atomic<int> VisibleFirst = 0;
+    std::atomic<int> VisibleLast = -1;
+    std::atomic<uint32_t> FocusVersion = 0;
+    std::atomic<int> Acquiring = 0;     // frames of claimed groups whose Acquire hasn't returned
+    std::atomic<int> CompletedTiles = 0;
+    std::atomic<int> CompletedFrames = 0;
+    std::atomic<bool> Cancelled = false;
+    std::atomic<bool> Finished = false;
+};
+
+// One worker pool shared by every job. Workers take tiles from the highest priority job that
+// still has work and is under its own thread cap (RenderSettings::Threads), so a preview can
+// run alongside an export without either touching the other's state. A job whose sink is full
+// gets no new frames started, its workers move on rather than block.
+class RenderScheduler {
+public:
+    explicit RenderScheduler(int threads = 0) {
+        int count = RenderSettings{ threads }.ResolveThreads();
+        for (int i = 0; i < count; i++) { Workers.emplace_back(&RenderScheduler::WorkerLoop, this, i); }
+    }
+    ~RenderScheduler() { Shutdown(); }
+
+    int ThreadCount() const { return (int)Workers.size(); }
+
+    void Submit(const std::shared_ptr<RenderJob>& job) {
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            Jobs.push_back(job);
+            std::stable_sort(Jobs.begin(), Jobs.end(), [](auto& a, auto& b) { return a->Priority < b->Priority; });
+        }
+        WorkAvailable.notify_all();
+    }
+
+    // jobs that completed or were cancelled and drained since the last call, for the UI thread
+    std::vector<std::shared_ptr<RenderJob>> Collect() {
+        std::lock_guard<std::mutex> lock(Lock);
+        for (auto it = Jobs.begin(); it != Jobs.end();) {
+            if ((*it)->Drained()) { Retire(*it); it = Jobs.erase(it); }
+            else ++it;
+        }
+        return std::exchange(Done, {});
+    }
+
+    void Shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            if (Stopping) return;
+            Stopping = true;
+            for (auto& job : Jobs) job->Cancel();
+        }
+        WorkAvailable.notify_all();
+        for (auto& worker : Workers) worker.join();
+        for (auto& job : Jobs) job->MarkFinished();
+        Jobs.clear();
+        Done.clear();
+    }
+
+private:
+    void Retire(const std::shared_ptr<RenderJob>& job) {
+        job->MarkFinished();
+        Done.push_back(job);
+    }
+
+    void WorkerLoop(int index) {
+        PROFILE_THREAD_NAME("Worker " + std::to_string(index));
+
+        std::unique_lock<std::mutex> lock(Lock);
+        while (true) {
+            RenderJob* job = nullptr;
+            bool sinkFull = false;
+            auto ready = [&]() {
+                if (Stopping) return true;
+                sinkFull = false;
+                for (auto& candidate : Jobs) {
+                    if (candidate->HasWork()) { job = candidate.get(); return true; }
+                    sinkFull = sinkFull || candidate->SinkFull;
+                }
+                return false;
+            };
+            while (!ready()) {
+                // sinks drain on threads of their own that don't signal the pool, a job held back by one is looked at again shortly
+                if (sinkFull) WorkAvailable.wait_for(lock, SinkRetry);
+                else WorkAvailable.wait(lock);
+            }
+            if (Stopping) return;
+
+            RenderJob::Item item = job->Claim();
+            job->ActiveWorkers++;
+            lock.unlock();
+
+            job->Run(item);
+
+            lock.lock();
+            job->ActiveWorkers--;
+            if (job->Drained()) {
+                auto it = std::find_if(Jobs.begin(), Jobs.end(), [&](auto& j) { return j.get() == job; });
+                if (it != Jobs.end()) { Retire(*it); Jobs.erase(it); }
+            }
+            // a freed slot under a job's thread cap may let a waiting worker in
+            WorkAvailable.notify_one();
+        }
+    }
+
+    static constexpr std::chrono::milliseconds SinkRetry{ 2 };
+
+    std::mutex Lock;
+    std::condition_variable WorkAvailable;
+    std::vector<std::shared_ptr<RenderJob>> Jobs;
+    std::vector<std::shared_ptr<RenderJob>> Done;
+    std::vector<std::thread> Workers;
+    bool Stopping = false;
+};
+
+namespace Render {
+
+    // Blocking helper: renders into caller-owned buffers on the shared pool.
+    inline void RenderFrames(RenderScheduler& scheduler, const IFrameGenerator& generator,
+        const std::vector<Draw::ImageView>& targets, const std::vector<double>& times, const RenderSettings& settings,
+        JobPriority priority = JobPriority::Preview)
+    {
+        if (targets.empty()) return;
+        auto job = std::make_shared<RenderJob>(generator, targets[0].Height, times, settings, priority, std::make_shared<ViewSink>(targets));
+        scheduler.Submit(job);
+        job->Wait();
+    }
+}
@@ -0,0 +1,132 @@
+// The service's socket side. Kept out of the headers: winsock2.h has to come before windows.h.
+#include <winsock2.h>
+#include <afunix.h>
+#include <DXE.h>
+#include "RenderService.h"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+bool RenderService::Start() {
+	if (Running) return true;
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		DXE_LOG("Render service: WSAStartup failed");
+		return false;
+	}
+
+	SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	std::string path = Socket.string();
+	if (listener == INVALID_SOCKET || path.size() >= sizeof(address.sun_path)) {
+		DXE_LOG("Render service: can't create a socket at ", path);
+		if (listener != INVALID_SOCKET) closesocket(listener);
+		WSACleanup();
+		return false;
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	// a socket file left by a previous run would fail the bind
+	std::error_code ec;
+	std::filesystem::remove(Socket, ec);
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR || listen(listener, SOMAXCONN) == SOCKET_ERROR) {
+		DXE_LOG("Render service: can't listen on ", path, " (", WSAGetLastError(), ")");
+		closesocket(listener);
+		WSACleanup();
+		return false;
+	}
+
+	Listener = (uintptr_t)listener;
+	Running = true;
+	Acceptor = std::thread(&RenderService::AcceptLoop, this);
+	DXE_INFO("Render service listening on ", path);
+	return true;
+}
+
+void RenderService::Stop() {
+	if (!Running.exchange(false)) return;
+
+	// closing the sockets wakes the threads blocked on them; cancelled renders release the
+	// clients waiting on a result
+	closesocket((SOCKET)Listener);
+	if (Acceptor.joinable()) Acceptor.join();
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		for (Client& client : Clients) {
+			if (!client.Finished) shutdown((SOCKET)client.Socket, SD_BOTH);
+		}
+		for (auto& [key, render] : InFlight) {
+			render->Exporter->Cancel();
+			render->Job->Cancel();
+		}
+	}
+	// the client threads only take the lock to finish
+	for (Client& client : Clients) client.Thread.join();
+	Clients.clear();
+
+	std::error_code ec;
+	std::filesystem::remove(Socket, ec);
+	WSACleanup();
+	DXE_INFO("Render service stopped");
+}
+
+void RenderService::AcceptLoop() {
+	PROFILE_THREAD_NAME("Service Accept");
+	// what earlier runs left over the limits; connections queue meanwhile
+	Evict();
+	while (Running) {
+		SOCKET socket = accept((SOCKET)Listener, nullptr, nullptr);
+		if (socket == INVALID_SOCKET) break;
+
+		std::lock_guard<std::mutex> lock(Lock);
+		if (!Running) { closesocket(socket); break; }
+		// connections are short-lived, their threads are joined as new ones come in
+		for (auto it = Clients.begin(); it != Clients.end();) {
+			if (it->Finished) { it->Thread.join(); it = Clients.erase(it); }
+			else ++it;
+		}
+		Clients.push_back({ (uintptr_t)socket });
+		Clients.back().Thread = std::thread(&RenderService::ServeClient, this, (uintptr_t)socket);
+		stats.Clients++;
+	}
+}
+
+static bool SendAll(SOCKET socket, const std::string& data) {
+	for (size_t sent = 0; sent < data.size();) {
+		int n = send(socket, data.data() + sent, (int)(data.size() - sent), 0);
+		if (n <= 0) return false;
+		sent += n;
+	}
+	return true;
+}
+
+// requests on one connection are answered in order, a client wanting several renders at
+// once opens several connections
+void RenderService::ServeClient(uintptr_t client) {
+	PROFILE_THREAD_NAME("Service Client");
+	SOCKET socket = (SOCKET)client;
+	std::string pending;
+	char buffer[4096];
+	bool open = true;
+	while (open && Running) {
+		int received = recv(socket, buffer, sizeof(buffer), 0);
+		if (received <= 0) break;
+		pending.append(buffer, received);
+
+		size_t end;
+		while (open && (end = pending.find('\n')) != std::string::npos) {
+			std::string line = pending.substr(0, end);
+			pending.erase(0, end + 1);
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty()) open = SendAll(socket, Handle(line));
+			// trimming after a render is paid by the client that rendered, once it has its answer
+			if (EvictPending.exchange(false)) Evict();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(Lock);
+	closesocket(socket);
+	for (Client& c : Clients) {
+		if (c.Socket == client) c.Finished = true;
+	}
+}
@@ -0,0 +1,346 @@
+#pragma once
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <filesystem>
+#include <fstream>
+#include "RenderJob.h"
+#include "FrameRenderer.h"
+#include "Export.h"
+#include "RenderCache.h"
+
+// One render as tools ask for it: a line of tab-separated key=value fields,
+//   generator=Lightning Beam<TAB>size=256<TAB>frames=16<TAB>circular=1<TAB>noise.type=2
+// Keys other than generator, size and frames are the generator's parameters by name: its sweep
+// fields, or anything its state walk names (bools as 0/1, ints rounded).
+struct RenderRequest {
+    std::string Generator;
+    int Size = 256;
+    int Frames = 16;
+    std::map<std::string, float> Parameters;    // sorted, so parameters apply in one order
+
+    static bool Parse(const std::string& line, RenderRequest& out, std::string& error) {
+        out = {};
+        std::istringstream fields(line);
+        std::string field;
+        while (std::getline(fields, field, '\t')) {
+            if (field.empty()) continue;
+            size_t eq = field.find('=');
+            if (eq == std::string::npos) { error = "field without a value: " + field; return false; }
+            std::string key = field.substr(0, eq), value = field.substr(eq + 1);
+            try {
+                if (key == "generator") out.Generator = value;
+                else if (key == "size") out.Size = std::stoi(value);
+                else if (key == "frames") out.Frames = std::stoi(value);
+                else out.Parameters[key] = std::stof(value);
+            }
+            catch (const std::exception&) { error = "bad number for " + key; return false; }
+        }
+        if (out.Generator.empty()) { error = "no generator"; return false; }
+        if (out.Size < 1 || out.Size > 8192 || out.Frames < 1 || out.Frames > 4096) { error = "size or frames out of range"; return false; }
+        return true;
+    }
+
+    // canonical form for the log; the cache goes by the generator's own key, see Resolve
+    std::string Key() const {
+        std::string key = Generator + "\tsize=" + std::to_string(Size) + "\tframes=" + std::to_string(Frames);
+        char value[32];
+        for (auto& [name, v] : Parameters) {
+            std::snprintf(value, sizeof(value), "%.9g", v);
+            key += "\t" + name + "=" + value;
+        }
+        return key;
+    }
+};
+
+// Renders for other processes (the level editor, build scripts) from the running app, so they
+// don't pay for a start-up per sprite. Requests come in over a Unix domain socket, one per line,
+// and are answered with the paths of the rendered PNG frames:
+//   ok<TAB>count<TAB>path<TAB>path...    or    error<TAB>message
+// Renders go through the app's own scheduler with the settings tuned for their generator, and
+// land in a folder per RenderCache key that outlives the app, so a kernel change that raises a
+// generator's Version renders afresh. The folder is trimmed by RenderCache's rule plus an age
+// limit, away from the requests. A request that is already rendering for another client waits
+// on that render instead of starting its own.
+class RenderService {
+public:
+    using Factory = std::function<std::unique_ptr<IFrameGenerator>()>;
+    using SettingsLookup = std::function<RenderSettings(const std::string&)>;
+
+    struct Stats {
+        int Requests = 0;
+        int CacheHits = 0;
+        int Coalesced = 0;      // joined a render already in flight
+        int Rendered = 0;
+        int Failed = 0;
+        int Clients = 0;
+    };
+
+    static constexpr uint64_t DefaultMaxBytes = 1ull << 30;
+    static constexpr std::chrono::hours MaxAge{ 24 * 7 };
+
+    RenderService(RenderScheduler& scheduler, std::unordered_map<std::string, Factory> generators, SettingsLookup settings,
+        std::filesystem::path socketPath, std::filesystem::path cacheFolder, uint64_t maxBytes = DefaultMaxBytes)
+        : Scheduler(scheduler), Generators(std::move(generators)), Settings(std::move(settings)), Socket(std::move(socketPath)),
+        CacheFolder(std::move(cacheFolder)), MaxBytes(maxBytes) {}
+    ~RenderService() { Stop(); }
+
+    // socket side, RenderService.cpp
+    bool Start();
+    void Stop();
+
+    bool IsRunning() const { return Running.load(); }
+    const std::filesystem::path& SocketPath() const { return Socket; }
+    Stats GetStats() const { std::lock_guard<std::mutex> lock(Lock); return stats; }
+
+    // Blocks until the request's frames are on disk; renders them unless they are cached or
+    // another client's identical request is rendering them.
+    bool Resolve(const RenderRequest& request, std::vector<std::filesystem::path>& files, std::string& error) {
+        // built outside the lock, the settings lookup takes the app's own
+        RenderSettings settings = Settings(request.Generator);
+        StateKey key;
+        std::unique_ptr<IFrameGenerator> generator = Build(request, error);
+        if (generator && !RenderCache::Key(*generator, request.Size, request.Frames, settings.Variant, key)) {
+            error = request.Generator + " has no cache key, it can't be served";
+            generator.reset();
+        }
+        std::filesystem::path folder = CacheFolder / Hex(key.Hash());
+        files.clear();
+        for (int f = 0; f < request.Frames; f++) files.push_back(FramePath(folder, f));
+
+        std::shared_ptr<PendingRender> render;
+        bool owner = false;
+        {
+            std::lock_guard<std::mutex> lock(Lock);
+            stats.Requests++;
+            if (!generator) { stats.Failed++; return false; }
+            if (IsCached(folder, key.Bytes, files)) {
+                // a hit counts as a use, eviction goes by the marker's time
+                std::error_code ec;
+                std::filesystem::last_write_time(folder / MarkerName, std::filesystem::file_time_type::clock::now(), ec);
+                stats.CacheHits++;
+                return true;
+            }
+
+            auto it = InFlight.find(key.Bytes);
+            if (it != InFlight.end()) {
+                stats.Coalesced++;
+                render = it->second;
+            }
+            else {
+                render = Submit(*generator, request, settings, folder);
+                InFlight[key.Bytes] = render;
+                owner = true;
+            }
+        }
+
+        render->Exporter->Wait();
+        bool ok = !render->Exporter->Failed() && !render->Exporter->IsCancelled();
+
+        std::lock_guard<std::mutex> lock(Lock);
+        if (owner) {
+            // the marker goes last, a folder without it is an unfinished render
+            if (ok) { std::ofstream(folder / MarkerName, std::ios::binary) << key.Bytes; }
+            InFlight.erase(key.Bytes);
+            ok ? stats.Rendered++ : stats.Failed++;
+            if (ok) EvictPending = true;
+        }
+        if (!ok) error = "render failed or was cancelled";
+        return ok;
+    }
+
+    // The response line for a request line. "list" answers with the generators, each as
+    // name=parameter,parameter...
+    std::string Handle(const std::string& line) {
+        if (line == "list") {
+            std::string out = "ok\t" + std::to_string(Generators.size());
+            for (auto& [name, factory] : Generators) {
+                out += "\t" + name + "=";
+                std::vector<std::string> names = ParameterNames(*factory());
+                for (size_t i = 0; i < names.size(); i++) out += (i ? "," : "") + names[i];
+            }
+            return out + "\n";
+        }
+        RenderRequest request;
+        std::string error;
+        std::vector<std::filesystem::path> files;
+        if (!RenderRequest::Parse(line, request, error) || !Resolve(request, files, error)) return "error\t" + error + "\n";
+        std::string out = "ok\t" + std::to_string(files.size());
+        for (auto& file : files) out += "\t" + file.string();
+        return out + "\n";
+    }
+
+private:
+    static constexpr const char* MarkerName = "request.key";
+    static constexpr const char* Aside = ".evicted";
+
+    struct PendingRender {
+        std::filesystem::path Folder;
+        std::shared_ptr<ExportPipeline> Exporter;
+        std::shared_ptr<RenderJob> Job;
+    };
+
+    static std::string Hex(uint64_t v) {
+        char text[24];
+        std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)v);
+        return text;
+    }
+    static std::filesystem::path FramePath(const std::filesystem::path& folder, int frame) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%04d.png", frame);
+        return folder / name;
+    }
+
+    // what a request may set: the state walk's names, or the sweep fields of a generator
+    // without one
+    static std::vector<std::string> ParameterNames(IFrameGenerator& generator) {
+        StateNames names;
+        if (generator.VisitState(names)) return names.Names;
+        std::vector<std::string> fields;
+        for (const char* field : generator.SweepFields()) fields.push_back(field);
+        return fields;
+    }
+
+    // The request's generator with its parameters set. A name is looked up among the sweep
+    // fields first, as the service always took them, then through the state walk, which is
+    // also what the cache key hashes.
+    std::unique_ptr<IFrameGenerator> Build(const RenderRequest& request, std::string& error) const {
+        auto factory = Generators.find(request.Generator);
+        if (factory == Generators.end()) { error = "unknown generator " + request.Generator; return nullptr; }
+        std::unique_ptr<IFrameGenerator> generator = factory->second();
+        std::vector<const char*> fields = generator->SweepFields();
+        for (auto& [name, value] : request.Parameters) {
+            auto it = std::find_if(fields.begin(), fields.end(), [&](const char* f) { return name == f; });
+            if (it != fields.end()) {
+                generator->SetSweepField((int)(it - fields.begin()), value);
+                continue;
+            }
+            StateSetter setter(name, value);
+            if (!generator->VisitState(setter) || !setter.Found) { error = "unknown parameter " + name; return nullptr; }
+        }
+        return generator;
+    }
+
+    // the marker holds the full key, two requests whose keys hash alike don't share frames
+    bool IsCached(const std::filesystem::path& folder, const std::string& key, const std::vector<std::filesystem::path>& files) const {
+        std::ifstream marker(folder / MarkerName, std::ios::binary);
+        if (!marker) return false;
+        std::string stored((std::istreambuf_iterator<char>(marker)), std::istreambuf_iterator<char>());
+        if (stored != key) return false;
+        std::error_code ec;
+        for (auto& file : files) {
+            if (!std::filesystem::exists(file, ec)) return false;
+        }
+        return true;
+    }
+
+    // Trims the folder by CacheEviction's rule with MaxAge, without holding up requests: it
+    // runs on the acceptor at start and on a client thread once its answer is sent. The scan
+    // sees the folder as it was, so each folder it picks is claimed under the lock, by renaming
+    // it aside, only if nothing renders into it and it wasn't used since; the removal is
+    // unlocked. A folder without a marker that isn't rendering is left from a render that
+    // never finished.
+    void Evict() {
+        std::lock_guard<std::mutex> pass(EvictLock);
+        std::vector<CacheEviction::Entry> entries, unfinished;
+        std::vector<std::filesystem::path> aside;
+        std::error_code ec;
+        auto now = std::filesystem::file_time_type::clock::now();
+        for (auto& item : std::filesystem::directory_iterator(CacheFolder, ec)) {
+            std::error_code e;
+            if (!item.is_directory(e)) continue;
+            if (item.path().extension() == Aside) { aside.push_back(item.path()); continue; }
+            auto time = std::filesystem::last_write_time(item.path() / MarkerName, e);
+            if (e) {
+                time = item.last_write_time(e);
+                if (!e && now - time > CacheEviction::LeftoverAge) unfinished.push_back({ item.path(), 0, time });
+                continue;
+            }
+            uint64_t bytes = 0;
+            for (auto& file : std::filesystem::directory_iterator(item.path(), e)) {
+                std::error_code size;
+                uint64_t fileBytes = file.file_size(size);
+                if (!size) bytes += fileBytes;
+            }
+            entries.push_back({ item.path(), bytes, time });
+        }
+
+        uint64_t kept = 0;
+        size_t expired = CacheEviction::Expired(entries, MaxBytes, MaxAge, kept);
+        auto claim = [&](const CacheEviction::Entry& entry, bool marked) {
+            std::lock_guard<std::mutex> lock(Lock);
+            for (auto& [key, render] : InFlight) {
+                if (render->Folder == entry.Path) return;
+            }
+            std::error_code e;
+            auto time = std::filesystem::last_write_time(entry.Path / MarkerName, e);
+            if (marked ? (e || time != entry.Time) : !e) return;
+            std::filesystem::path to = entry.Path;
+            to += Aside;
+            std::filesystem::rename(entry.Path, to, e);
+            if (!e) aside.push_back(to);
+        };
+        for (auto& entry : unfinished) claim(entry, false);
+        for (size_t i = 0; i < expired; i++) claim(entries[i], true);
+
+        // Stop waits on this pass, what is left goes next time
+        for (auto& path : aside) {
+            if (!Running) return;
+            std::filesystem::remove_all(path, ec);
+        }
+    }
+
+    // lock held; a stale unfinished folder is overwritten
+    std::shared_ptr<PendingRender> Submit(IFrameGenerator& generator, const RenderRequest& request,
+        const RenderSettings& renderSettings, const std::filesystem::path& folder)
+    {
+        std::error_code ec;
+        std::filesystem::remove(folder / MarkerName, ec);
+        ExportSettings settings;
+        settings.Folder = folder;
+        settings.Name = "frame";
+
+        auto render = std::make_shared<PendingRender>();
+        render->Folder = folder;
+        render->Exporter = std::make_shared<ExportPipeline>(request.Size, request.Frames, settings);
+        render->Job = std::make_shared<RenderJob>(generator, request.Size, Render::FrameTimes(request.Frames, generator.IsLooping()),
+            renderSettings, JobPriority::Export, render->Exporter);
+        Scheduler.Submit(render->Job);
+        DXE_INFO("Service rendering ", request.Key(), ", variant ", KernelVariantName(renderSettings.Variant));
+        return render;
+    }
+
+    void AcceptLoop();
+    void ServeClient(uintptr_t client);
+
+    RenderScheduler& Scheduler;
+    const std::unordered_map<std::string, Factory> Generators;
+    const SettingsLookup Settings;
+    const std::filesystem::path Socket;
+    const std::filesystem::path CacheFolder;
+    const uint64_t MaxBytes;
+
+    mutable std::mutex Lock;
+    std::unordered_map<std::string, std::shared_ptr<PendingRender>> InFlight;     // by key bytes
+    Stats stats;
+
+    std::mutex EvictLock;                       // one pass at a time
+    std::atomic<bool> EvictPending = false;     // a render finished since the last pass
+
+    std::atomic<bool> Running = false;
+    uintptr_t Listener = 0;
+    std::thread Acceptor;
+    struct Client {
+        uintptr_t Socket;
+        std::thread Thread;
+        bool Finished = false;  // socket closed, the thread is returning
+    };
+    std::list<Client> Clients;  // lock held
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include "DrawFunctions.h"
+
+// One axis of a parameter sweep: Steps values of a SweepFields() entry, Min to Max inclusive.
+struct SweepAxis {
+    int Field = -1;     // -1: axis unused
+    float Min = 0.f;
+    float Max = 1.f;
+    int Steps = 3;
+
+    bool Active() const { return Field >= 0 && Steps > 0; }
+    int Count() const { return Active() ? Steps : 1; }
+    float Value(int i) const { return Steps > 1 ? Min + (Max - Min) * i / (Steps - 1) : Min; }
+};
+
+// Renders a grid of variants of the wrapped generator into each frame, X across, Y down.
+// The whole grid is one SweepBatch for the generator's batched kernel, so cells share
+// whatever the varied fields don't touch. The preview, the frame stores and the exporters
+// see an ordinary frame.
+class SweepGenerator : public IFrameGenerator {
+public:
+    SweepGenerator(std::unique_ptr<IFrameGenerator> inner, SweepAxis x, SweepAxis y)
+        : Inner(std::move(inner)), X(x), Y(y)
+    {
+        int fields = (int)Inner->SweepFields().size();
+        if (X.Field >= fields) X.Field = -1;
+        if (Y.Field >= fields) Y.Field = -1;
+
+        if (X.Active()) Batch.Fields.push_back(X.Field);
+        if (Y.Active()) Batch.Fields.push_back(Y.Field);
+        for (int r = 0; r < Y.Count(); r++) {
+            for (int c = 0; c < X.Count(); c++) {
+                if (X.Active()) Batch.Values.push_back(X.Value(c));
+                if (Y.Active()) Batch.Values.push_back(Y.Value(r));
+            }
+        }
+    }
+
+    const char* GetName() const override { return Inner->GetName(); }
+    bool IsLooping() override { return Inner->IsLooping(); }
+    bool DrawImGui() override { return Inner->DrawImGui(); }
+    std::unique_ptr<IFrameGenerator> Clone() const override { return std::make_unique<SweepGenerator>(Inner->Clone(), X, Y); }
+    bool HasSimdKernel() const override { return Inner->HasSimdKernel(); }
+    bool HasFinishPass() const override { return Inner->HasFinishPass(); }
+    bool HashState(StateKey& key) const override {
+        key.Add("Sweep");
+        for (const SweepAxis& axis : { X, Y }) key.Add(axis.Field).Add(axis.Min).Add(axis.Max).Add(axis.Steps);
+        return HashGenerator(*Inner, key);
+    }
+    // the grid repeats when every cell does, and a sweep may vary what sets the period
+    int Repeats() const override {
+        if (Batch.Fields.empty()) return Inner->Repeats();
+        int repeats = 0;
+        for (int v = 0; v < Batch.Count(); v++) {
+            auto copy = Inner->Clone();
+            for (int f = 0; f < (int)Batch.Fields.size(); f++) copy->SetSweepField(Batch.Fields[f], Batch.Value(v, f));
+            repeats = std::gcd(repeats, copy->Repeats());
+        }
+        return repeats;
+    }
+
+    int Columns() const { return X.Count(); }
+    int GridRows() const { return Y.Count(); }
+    int VariantCount() const { return Columns() * GridRows(); }
+    // square cells, as large as fit the frame
+    int CellSize(int frameSize) const { return frameSize / std::max(Columns(), GridRows()); }
+
+    // A tile's share of the frame rows maps to the same share of every cell's rows, so each
+    // tile hands the kernel all variants at once. Tiles still cover disjoint pixels.
+    void GenerateTile(const Draw::ImageView& target, double t, int y0, int y1, KernelVariant variant) override {
+        int cell = CellSize(target.Width);
+        int used = cell * Columns();
+
+        // margins the grid doesn't cover stay black
+        for (int y = y0; y < y1; y++) {
+            uint8_t* row = target.Row(y);
+            if (cell == 0 || y >= cell * GridRows()) { std::memset(row, 0, target.RowBytes()); continue; }
+            std::memset(row + (size_t)used * target.Channels, 0, (size_t)(target.Width - used) * target.Channels);
+        }
+        if (cell == 0) return;
+
+        int cy0 = (int)((int64_t)y0 * cell / target.Height);
+        int cy1 = (int)((int64_t)y1 * cell / target.Height);
+        if (cy0 >= cy1) return;
+
+        std::vector<Draw::ImageView> cells;
+        for (int r = 0; r < GridRows(); r++) {
+            for (int c = 0; c < Columns(); c++) { cells.push_back(target.Sub(c * cell, r * cell, cell, cell)); }
+        }
+        if (Batch.Fields.empty()) { Inner->GenerateTile(cells[0], t, cy0, cy1, variant); }
+        else { Inner->GenerateVariantsTile(cells, Batch, t, cy0, cy1, variant); }
+    }
+
+    // Whole-frame passes run per cell on a packed copy. A single cell is packed already and
+    // runs in place, on the pixels its tiles went to, which is how a finish pass finds the state
+    // its tiles left.
+    void FinishFrame(const Draw::ImageView& target, double t) override {
+        int cell = CellSize(target.Width);
+        if (cell == 0) return;
+        if (VariantCount() == 1 && target.RowBytes() == (size_t)cell * target.Channels) {
+            Inner->FinishFrame({ target.Pixels, cell, cell, target.Channels }, t);
+            return;
+        }
+        std::vector<uint8_t> pixels((size_t)cell * cell * target.Channels);
+        Draw::ImageView packed = { pixels.data(), cell, cell, target.Channels };
+        for (int r = 0; r < GridRows(); r++) {
+            for (int c = 0; c < Columns(); c++) {
+                Draw::ImageView view = target.Sub(c * cell, r * cell, cell, cell);
+                for (int y = 0; y < cell; y++) std::memcpy(packed.Row(y), view.Row(y), packed.RowBytes());
+                Inner->FinishFrame(packed, t);
+                for (int y = 0; y < cell; y++) std::memcpy(view.Row(y), packed.Row(y), packed.RowBytes());
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<IFrameGenerator> Inner;
+    SweepAxis X;
+    SweepAxis Y;
+    SweepBatch Batch;   // every cell, row by row
+};
@@ -3,8 +3,73 @@
 #include "imgui/imgui_impl_dx11.h"
 #include "imgui/imgui_impl_win32.h"
 #include <algorithm>
+#include <functional>
 #include "Maths/Maths.h"
 namespace Widgets {
+
+    // one filled rect per tile
+    inline void CheckerboardTiles(ImDrawList* draw_list, ImVec2 pos, ImVec2 size, float tile_size, ImU32 col1, ImU32 col2)
+    {
+        int tiles_x = (int)(size.x / tile_size) + 1;
+        int tiles_y = (int)(size.y / tile_size) + 1;
+
+        for (int y = 0; y < tiles_y; ++y) {
+            for (int x = 0; x < tiles_x; ++x) {
+                bool isEven = (x + y) % 2 == 0;
+                ImVec2 tile_min = ImVec2(pos.x + x * tile_size, pos.y + y * tile_size);
+                ImVec2 tile_max = ImVec2(tile_min.x + tile_size, tile_min.y + tile_size);
+                draw_list->AddRectFilled(tile_min, tile_max, isEven ? col1 : col2);
+            }
+        }
+    }
+
+    // One quad over a 2x2 texel pattern texture. UVs run past 1 so the pattern repeats, which
+    // needs a wrapping point sampler: bindSampler is queued as a draw callback in front of the
+    // quad and the backend's default state is restored right after it.
+    inline void CheckerboardQuad(ImDrawList* draw_list, ImTextureID pattern, ImVec2 pos, ImVec2 size, float tile_size,
+        ImDrawCallback bindSampler = nullptr, void* samplerData = nullptr)
+    {
+        ImVec2 uv_max = { size.x / (2.f * tile_size), size.y / (2.f * tile_size) };
+        if (bindSampler) draw_list->AddCallback(bindSampler, samplerData);
+        draw_list->AddImage(pattern, pos, { pos.x + size.x, pos.y + size.y }, { 0.f, 0.f }, uv_max);
+        if (bindSampler) draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    }
+
+    struct DrawCost { int Vertices = 0; int Indices = 0; };
+
+    // Runs `draw` inside one full-screen window of a throwaway ImGui context with no platform or
+    // renderer backend attached, and returns what it added to the draw list. CreateContext keeps
+    // the app's context current, the throwaway one is made current by hand so nothing below
+    // touches the app's IO or windows.
+    inline DrawCost MeasureDrawCost(ImVec2 displaySize, const std::function<void(ImDrawList*, ImVec2, ImVec2)>& draw)
+    {
+        ImGuiContext* previous = ImGui::GetCurrentContext();
+        ImGuiContext* context = ImGui::CreateContext();
+        ImGui::SetCurrentContext(context);
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = displaySize;
+        io.DeltaTime = 1.f / 60.f;
+        io.IniFilename = nullptr;
+        unsigned char* fontPixels = nullptr;
+        int fontWidth = 0, fontHeight = 0;
+        io.Fonts->GetTexDataAsRGBA32(&fontPixels, &fontWidth, &fontHeight);
+
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos({ 0.f, 0.f });
+        ImGui::SetNextWindowSize(displaySize);
+        ImGui::Begin("Measure", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoBackground);
+
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        DrawCost before = { draw_list->VtxBuffer.Size, draw_list->IdxBuffer.Size };
+        draw(draw_list, ImGui::GetCursorScreenPos(), ImGui::GetContentRegionAvail());
+        DrawCost cost = { draw_list->VtxBuffer.Size - before.Vertices, draw_list->IdxBuffer.Size - before.Indices };
+
+        ImGui::End();
+        ImGui::Render();
+        ImGui::DestroyContext(context);
+        ImGui::SetCurrentContext(previous);
+        return cost;
+    }
     inline bool XYPad(const char* label, DXM::Vector2& value, float minX, float maxX, float minY, float maxY, ImVec2 size = { 200,200 })
     {
         ImDrawList* draw_list = ImGui::GetWindowDrawList();